@@ -0,0 +1,336 @@
+#include "process_memory.h"
+#include "root_image_generator.h"
+#include "bit_mask.h"
+#include "component_labeler.h"
+#include "image_strip_source.h"
+#include "neighborhood_code.h"
+#include "ocv_utilities.h"
+#include "parallel_for.h"
+#include "quick_look.h"
+#include "root_system.h"
+#include "root_system_statistics.h"
+#include "run_length_mask.h"
+#include "skeleton_graph.h"
+#include "skeleton_method.h"
+#include "skeletonizer.h"
+#include "strip_pipeline.h"
+#include "thresh_method.h"
+#include "thresholder.h"
+#include "trait_table.h"
+#include "workspace.h"
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace benchmark;
+using namespace cv;
+using namespace morph;
+using namespace segment;
+using namespace std;
+using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// BenchmarkOptions
+//
+// The options the benchmark was started with.
+//////////////////////////////////////////////////////////////////////////////////
+struct BenchmarkOptions
+{
+	BenchmarkOptions()
+		: megapixels(1, 1.0), density(9), thickness(9), repetitions(3), seed(1)
+	{
+	}
+
+	vector<double> megapixels;
+	double density;	// Primary roots per thousand columns.
+	double thickness;
+	int repetitions;
+	unsigned int seed;
+};
+
+//////////////////////////////////////////////////////////////////////////////////
+// timeStage()
+//
+// Runs the stage the specified number of times and returns the fastest run, in
+// seconds. The fastest run is the one least disturbed by the rest of the system.
+//////////////////////////////////////////////////////////////////////////////////
+static double timeStage(const function<void()>& stage, const int repetitions)
+{
+	double fastest = 0;
+
+	for (int repetition = 0; repetition < repetitions; ++repetition)
+	{
+		const int64 start = getTickCount();
+		stage();
+		const double elapsed = (getTickCount() - start) / getTickFrequency();
+
+		if (repetition == 0 || elapsed < fastest)
+			fastest = elapsed;
+	}
+
+	return fastest;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// report()
+//
+// Prints the time a stage took and its throughput in megapixels per second.
+//////////////////////////////////////////////////////////////////////////////////
+static void report(const string& stage, const double seconds, const double megapixels)
+{
+	cout << "  " << left << setw(44) << stage << right
+		<< setw(12) << fixed << setprecision(3) << seconds * 1000 << " ms"
+		<< setw(12) << setprecision(1) << (seconds > 0 ? megapixels / seconds : 0) << " MP/s" << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// reportValue()
+//
+// Prints the value of a trait with every significant digit, so that the output
+// of two builds only matches if they compute bit-identical traits.
+//////////////////////////////////////////////////////////////////////////////////
+static void reportValue(const string& trait, const double value)
+{
+	cout.unsetf(ios::floatfield);
+	cout << "  " << left << setw(44) << "value " + trait << right << setprecision(17) << value << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// reportPeakMemory()
+//
+// Prints the most memory the process has held at once, in megabytes.
+//////////////////////////////////////////////////////////////////////////////////
+static void reportPeakMemory()
+{
+	cout << "Peak memory: " << fixed << setprecision(1) << ProcessMemory::getPeakMegabytes() << " MB" << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// benchmarkImage()
+//
+// Times every stage of the pipeline on one generated image. Each stage gets the
+// output of the stage before it, as it would in RootSystem.
+//////////////////////////////////////////////////////////////////////////////////
+static void benchmarkImage(const RootImageParameters& parameters, const int repetitions)
+{
+	const double megapixels = static_cast<double>(parameters.width) * parameters.height / 1e6;
+
+	cout << parameters.width << " x " << parameters.height << " (" << setprecision(1) << fixed << megapixels << " MP), "
+		<< parameters.rootCount << " primary roots, " << parameters.thickness << " px thick" << endl;
+
+	Mat image = RootImageGenerator::generate(parameters);
+
+	Mat thresholdedImage;
+	report("Thresholder::threshold", timeStage([&]() { thresholdedImage = Thresholder::threshold(image, THRESH); }, repetitions), megapixels);
+	report("Thresholder::threshold (adaptive)", timeStage([&]() { Thresholder::threshold(image, ADAPTIVE_THRESH); }, repetitions), megapixels);
+	report("Thresholder::computeHistogram", timeStage([&]() { Thresholder::computeHistogram(image); }, repetitions), megapixels);
+
+	// An automatic threshold value costs one histogram pass on top of the threshold itself.
+	ThresholdParameters otsuParameters;
+	otsuParameters.thresholdSelection = OTSU_THRESHOLD;
+	report("Thresholder::threshold (Otsu)", timeStage([&]() { Thresholder::threshold(image, THRESH, otsuParameters); }, repetitions), megapixels);
+
+	// The integral images make the cost of the doubly adaptive threshold independent of its window sizes.
+	const int BLOCK_SIZES[] = { 19, 61, 201 };
+
+	for (const int blockSize : BLOCK_SIZES)
+	{
+		ThresholdParameters thresholdParameters;
+		thresholdParameters.blockSize = blockSize;
+		thresholdParameters.contrastBlockSize = blockSize;
+
+		report("Thresholder::threshold (double-adaptive, " + to_string(blockSize) + " px)", timeStage([&]() { Thresholder::threshold(image, DOUBLE_ADAPTIVE_THRESH, thresholdParameters); }, repetitions), megapixels);
+	}
+
+	Mat network;
+	report("ComponentLabeler::extractLargestComponent", timeStage([&]() { Mat component; Rect boundingBox; ComponentLabeler::extractLargestComponent(thresholdedImage, component, boundingBox); }, repetitions), megapixels);
+	report("OcvUtilities::keepOnlyLargestContour", timeStage([&]() { network = thresholdedImage.clone(); OcvUtilities::keepOnlyLargestContour(network); }, repetitions), megapixels);
+
+	const SkeletonMethod SKELETON_METHODS[] = { MORPHOLOGICAL_SKELETON, MEDIAL_AXIS_TRANSFORM, DISTANCE_TRANSFORM_SKELETON, THINNED_SKELETON };
+	const string SKELETON_METHOD_NAMES[] = { "morphological", "medial-axis", "distance-transform", "thinning" };
+
+	for (int method = 0; method < 4; ++method)
+	{
+		Mat radiusMap;
+		report("Skeletonizer::skeletonize (" + SKELETON_METHOD_NAMES[method] + ")", timeStage([&]() { Skeletonizer::skeletonize(network, SKELETON_METHODS[method], radiusMap); }, repetitions), megapixels);
+	}
+
+	report("Skeletonizer::computeDistanceTransform", timeStage([&]() { Skeletonizer::computeDistanceTransform(network); }, repetitions), megapixels);
+	report("NeighborhoodCode::computeNeighborhoodCodes", timeStage([&]() { NeighborhoodCode::computeNeighborhoodCodes(network, true); }, repetitions), megapixels);
+
+	// The graph is built from the thinned skeleton, which is the one pixel wide skeleton it is meant for.
+	Mat radiusMap;
+	const BitMask packedSkeleton = BitMask(Skeletonizer::skeletonize(network, THINNED_SKELETON, radiusMap));
+	radiusMap = Skeletonizer::computeDistanceTransform(network);
+	report("SkeletonGraph", timeStage([&]() { SkeletonGraph graph(packedSkeleton, radiusMap); }, repetitions), megapixels);
+
+	report("BitMask packing", timeStage([&]() { BitMask packed(network); }, repetitions), megapixels);
+	report("RunLengthMask encoding", timeStage([&]() { RunLengthMask encoded(network); }, repetitions), megapixels);
+
+	for (int method = 0; method < 4; ++method)
+		report("RootSystem (" + SKELETON_METHOD_NAMES[method] + ")", timeStage([&]() { RootSystem rootSystem(image, SKELETON_METHODS[method]); rootSystem.getStatistics(); }, repetitions), megapixels);
+
+	// The same stages again on a single thread, to show what the row bands gain on this machine.
+	{
+		ParallelScope parallelScope(1);
+
+		report("Skeletonizer::computeDistanceTransform (1 thread)", timeStage([&]() { Skeletonizer::computeDistanceTransform(network); }, repetitions), megapixels);
+		report("NeighborhoodCode::computeNeighborhoodCodes (1 thread)", timeStage([&]() { NeighborhoodCode::computeNeighborhoodCodes(network, true); }, repetitions), megapixels);
+
+		for (int method = 0; method < 4; ++method)
+			report("RootSystem (" + SKELETON_METHOD_NAMES[method] + ", 1 thread)", timeStage([&]() { RootSystem rootSystem(image, SKELETON_METHODS[method]); rootSystem.getStatistics(); }, repetitions), megapixels);
+	}
+
+	// The traits that only need the mask and the row profile, so the skeleton is never built and the mask is released early.
+	const string GEOMETRIC_TRAITS[] = { "network_area", "perimeter", "convex_area", "network_depth", "network_width", "network_solidity" };
+
+	vector<TraitDescriptor> geometricTraits;
+
+	for (const string& name : GEOMETRIC_TRAITS)
+		geometricTraits.push_back(*TraitTable::findTrait(name));
+
+	report("RootSystem (geometric traits only)", timeStage([&]()
+	{
+		RootSystem rootSystem(image, MEDIAL_AXIS_TRANSFORM, THRESH, ThresholdParameters(), geometricTraits);
+
+		for (const TraitDescriptor& trait : geometricTraits)
+			rootSystem.computeTrait(trait);
+	}, repetitions), megapixels);
+
+	AnalysisOptions quickLookOptions;
+	quickLookOptions.skeletonMethod = DISTANCE_TRANSFORM_SKELETON;
+
+	for (int level = 1; level <= 3; ++level)
+		report("QuickLook (level " + to_string(level) + ")", timeStage([&]() { QuickLook quickLook(image, quickLookOptions, level); }, repetitions), megapixels);
+
+	const QuickLook quickLook = QuickLook(image, quickLookOptions, 2);
+	report("QuickLook::refine", timeStage([&]() { quickLook.refine(); }, repetitions), megapixels);
+
+	report("StripPipeline (256 row strips)", timeStage([&]()
+	{
+		MatStripSource source(image);
+		RootSystemStatistics statistics;
+		string error;
+		StripPipeline::computeStatistics(source, 256, THRESH, ThresholdParameters(), statistics, error);
+	}, repetitions), megapixels);
+
+	// Every intermediate result is built before the traits are timed, so this is the cost of each trait on top of them.
+	RootSystem rootSystem(image);
+	rootSystem.getStatistics();
+
+	for (const TraitDescriptor& trait : TraitTable::getTraits())
+		report("trait " + trait.name, timeStage([&]() { rootSystem.computeTrait(trait); }, repetitions), megapixels);
+
+	// A change that is meant to be faster, not different, must leave these unchanged for the same seed.
+	for (const TraitDescriptor& trait : TraitTable::getTraits())
+		reportValue(trait.name, rootSystem.computeTrait(trait));
+
+	cout << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseList()
+//
+// Parses a comma separated list of positive numbers. Returns false if any entry
+// is not a positive number.
+//////////////////////////////////////////////////////////////////////////////////
+static bool parseList(const string& text, vector<double>& values)
+{
+	values.clear();
+
+	stringstream stream(text);
+	string entry;
+
+	while (getline(stream, entry, ','))
+	{
+		char* end = nullptr;
+		const double value = strtod(entry.c_str(), &end);
+
+		if (entry.empty() || *end != '\0' || !(value > 0))
+			return false;
+
+		values.push_back(value);
+	}
+
+	return !values.empty();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseArguments()
+//
+// Parses the arguments into options. Returns false if an argument is not valid.
+//////////////////////////////////////////////////////////////////////////////////
+static bool parseArguments(const int argc, char** argv, BenchmarkOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const string argument = argv[i];
+		const size_t separator = argument.find('=');
+
+		if (separator == string::npos)
+			return false;
+
+		const string name = argument.substr(0, separator);
+		const string value = argument.substr(separator + 1);
+
+		vector<double> values;
+
+		if (!parseList(value, values))
+			return false;
+
+		if (name == "--megapixels")
+			options.megapixels = values;
+		else if (name == "--density" && values.size() == 1)
+			options.density = values[0];
+		else if (name == "--thickness" && values.size() == 1)
+			options.thickness = values[0];
+		else if (name == "--repetitions" && values.size() == 1)
+			options.repetitions = static_cast<int>(values[0]);
+		else if (name == "--seed" && values.size() == 1)
+			options.seed = static_cast<unsigned int>(values[0]);
+		else
+			return false;
+	}
+
+	return options.repetitions > 0;
+}
+
+int main(int argc, char** argv)
+{
+	BenchmarkOptions options;
+
+	if (!parseArguments(argc, argv, options))
+	{
+		cerr << "Usage: benchmark [--megapixels=1,10,100] [--density=roots_per_1000_columns] [--thickness=px] [--repetitions=n] [--seed=n]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	// Stages reuse their scratch buffers across repetitions, as they do across the images of a batch.
+	Workspace workspace;
+	WorkspaceScope workspaceScope(&workspace);
+
+	for (const double megapixels : options.megapixels)
+	{
+		// Root scans are taller than they are wide.
+		RootImageParameters parameters;
+		parameters.width = max(1, static_cast<int>(round(sqrt(megapixels * 1e6 * 3 / 4))));
+		parameters.height = max(1, static_cast<int>(round(megapixels * 1e6 / parameters.width)));
+		parameters.rootCount = max(1, static_cast<int>(round(options.density * parameters.width / 1000)));
+		parameters.thickness = options.thickness;
+		parameters.seed = options.seed;
+
+		benchmarkImage(parameters, options.repetitions);
+	}
+
+	reportPeakMemory();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,36 @@
+#include "process_memory.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace benchmark;
+
+//////////////////////////////////////////////////////////////////////////////////
+// getPeakMegabytes()
+//
+// Returns the most memory the process has held at once, in megabytes. The peak
+// never goes down, so it covers everything the process has done so far.
+//////////////////////////////////////////////////////////////////////////////////
+double ProcessMemory::getPeakMegabytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	const double peakBytes = GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? static_cast<double>(counters.PeakWorkingSetSize) : 0;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+	const double peakBytes = static_cast<double>(usage.ru_maxrss);
+#else
+	const double peakBytes = static_cast<double>(usage.ru_maxrss) * 1024;	// Linux reports kilobytes.
+#endif
+#endif
+
+	return peakBytes / (1024 * 1024);
+}
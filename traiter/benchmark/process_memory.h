@@ -0,0 +1,18 @@
+#pragma once
+
+namespace benchmark
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// ProcessMemory
+	//
+	// Reports how much memory the process has used, for the benchmark and the
+	// regression suite.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ProcessMemory final
+	{
+	public:
+		static double getPeakMegabytes();
+	private:
+		ProcessMemory();
+	};
+}
@@ -0,0 +1,128 @@
+#include "root_image_generator.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace benchmark;
+using namespace cv;
+using namespace std;
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootImageParameters::RootImageParameters()
+//
+// Constructor that describes a one megapixel image of a moderately bushy root
+// system.
+//////////////////////////////////////////////////////////////////////////////////
+RootImageParameters::RootImageParameters()
+	: width(864), height(1152), rootCount(8), thickness(9), branchProbability(0.02), seed(1)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// generate()
+//
+// Generates the root system image. The primary roots start evenly spread along
+// the top of the image and grow downward, wandering and tapering as they go.
+// Faint noise is added to the background so that thresholding has real work
+// to do.
+//////////////////////////////////////////////////////////////////////////////////
+Mat RootImageGenerator::generate(const RootImageParameters& parameters)
+{
+	const uchar BACKGROUND = 40;
+	const int NOISE = 60;	// Background pixels stay well below the threshold.
+
+	mt19937 generator(parameters.seed);
+
+	Mat image = Mat(parameters.height, parameters.width, CV_8UC1);
+
+	for (int row = 0; row < image.rows; ++row)
+	{
+		uchar* imageRow = image.ptr<uchar>(row);
+
+		for (int col = 0; col < image.cols; ++col)
+			imageRow[col] = static_cast<uchar>(BACKGROUND + generator() % (NOISE + 1));
+	}
+
+	const double PI = 3.14159265358979323846;
+
+	for (int root = 0; root < parameters.rootCount; ++root)
+	{
+		const double x = (root + 0.5) * parameters.width / parameters.rootCount;
+		growRoot(image, generator, parameters, Point2d(x, 0), PI / 2, parameters.thickness, 0, INT_MAX);
+	}
+
+	return image;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// growRoot()
+//
+// Draws one root from the specified position until it leaves the image, becomes
+// too thin to see or runs out of steps, sprouting lateral roots along the way.
+// Laterals start thinner than their parent, grow out to the side before turning
+// down, and are shorter the further they are from the primary root.
+//////////////////////////////////////////////////////////////////////////////////
+void RootImageGenerator::growRoot(Mat& image, mt19937& generator, const RootImageParameters& parameters, Point2d position, double angle, double thickness, const int depth, int remainingSteps)
+{
+	const double PI = 3.14159265358979323846;
+	const double STEP = 4;	// Length of each straight segment, in pixels.
+	const double TAPER = 0.9985;	// Thickness kept per step.
+	const double GRAVITROPISM = 0.05;	// How strongly a root turns back toward straight down per step.
+	const double MINIMUM_THICKNESS = 1;
+	const int MAXIMUM_DEPTH = 2;	// Laterals of laterals do not branch any further.
+
+	const double WANDER = 0.08;	// Standard deviation of the turn per step, in radians.
+
+	while (remainingSteps-- > 0 && thickness >= MINIMUM_THICKNESS && position.y < image.rows && position.x >= 0 && position.x < image.cols)
+	{
+		angle += WANDER * drawNormal(generator) + GRAVITROPISM * (PI / 2 - angle);
+
+		const Point2d next = position + STEP * Point2d(cos(angle), sin(angle));
+		const uchar brightness = static_cast<uchar>(220 + 35 * drawUniform(generator));
+
+		line(image, Point(cvRound(position.x), cvRound(position.y)), Point(cvRound(next.x), cvRound(next.y)), Scalar(brightness), max(1, cvRound(thickness)));
+
+		if (depth < MAXIMUM_DEPTH && drawUniform(generator) < parameters.branchProbability)
+		{
+			const double side = drawUniform(generator) < 0.5 ? -1 : 1;
+			const int lateralSteps = static_cast<int>(image.rows / (STEP * 6 * (depth + 1)));
+
+			growRoot(image, generator, parameters, next, angle + side * (PI / 3 + 0.3 * drawUniform(generator)), thickness * 0.5, depth + 1, lateralSteps);
+		}
+
+		position = next;
+		thickness *= TAPER;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// drawUniform()
+//
+// Draws a number uniformly distributed in [0, 1). The standard distributions
+// are free to differ between standard libraries, while mt19937 is not, so the
+// numbers are made from its output directly. That way every build generates the
+// same image from the same parameters, and the regression suite can compare the
+// traits of generated images with golden values recorded on another machine.
+//////////////////////////////////////////////////////////////////////////////////
+double RootImageGenerator::drawUniform(mt19937& generator)
+{
+	return generator() / 4294967296.0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// drawNormal()
+//
+// Draws a number from a close approximation of the standard normal distribution,
+// as the sum of twelve uniform numbers less their mean. It only needs additions,
+// so it gives the same result on every platform.
+//////////////////////////////////////////////////////////////////////////////////
+double RootImageGenerator::drawNormal(mt19937& generator)
+{
+	double sum = 0;
+
+	for (int i = 0; i < 12; ++i)
+		sum += drawUniform(generator);
+
+	return sum - 6;
+}
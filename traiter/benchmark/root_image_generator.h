@@ -0,0 +1,43 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <random>
+
+namespace benchmark
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// RootImageParameters
+	//
+	// Describes the synthetic root system image to generate.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct RootImageParameters
+	{
+		RootImageParameters();
+
+		int width;
+		int height;
+		int rootCount;	// Number of primary roots growing down from the top of the image.
+		double thickness;	// Thickness of a primary root where it leaves the top of the image, in pixels.
+		double branchProbability;	// Chance per growth step that a root sprouts a lateral root.
+		unsigned int seed;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// RootImageGenerator
+	//
+	// Generates grayscale images of branching root systems, bright roots on a dark
+	// background, for benchmarking at sizes larger than the sample images. The
+	// same parameters always generate the same image, whichever compiler built it.
+	//////////////////////////////////////////////////////////////////////////////////
+	class RootImageGenerator final
+	{
+	public:
+		static cv::Mat generate(const RootImageParameters& parameters);
+	private:
+		RootImageGenerator();
+
+		static void growRoot(cv::Mat& image, std::mt19937& generator, const RootImageParameters& parameters, cv::Point2d position, double angle, double thickness, const int depth, int remainingSteps);
+		static double drawUniform(std::mt19937& generator);
+		static double drawNormal(std::mt19937& generator);
+	};
+}
@@ -0,0 +1,811 @@
+#include "process_memory.h"
+#include "root_image_generator.h"
+#include "component_labeler.h"
+#include "general_utilities.h"
+#include "image_analyzer.h"
+#include "image_strip_source.h"
+#include "mapped_image.h"
+#include "parallel_for.h"
+#include "quick_look.h"
+#include "root_system.h"
+#include "root_system_statistics.h"
+#include "skeleton_method.h"
+#include "skeletonizer.h"
+#include "strip_pipeline.h"
+#include "thresh_method.h"
+#include "thresholder.h"
+#include "trait_dependency.h"
+#include "trait_table.h"
+#include "workspace.h"
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace benchmark;
+using namespace cv;
+using namespace morph;
+using namespace segment;
+using namespace std;
+using namespace traiter;
+using namespace utility;
+
+namespace
+{
+	// A recorded budget leaves this much room above the measurement, so that an
+	// ordinary run on the same machine does not fail.
+	const double TIME_HEADROOM = 1.5;
+	const double MINIMUM_TIME_HEADROOM = 5;	// Milliseconds. Stages this short are mostly timer noise.
+	const double MEMORY_HEADROOM = 1.2;
+	const double MINIMUM_MEMORY_HEADROOM = 16;	// Megabytes.
+
+	// Short strips, so that components are carried across strip boundaries in all but the tiniest images.
+	const int STREAM_STRIP_ROWS = 16;
+	const int QUICK_LOOK_LEVEL = 1;
+	const string QUICK_LOOK_SUFFIX = ":quick_look";	// Names the golden values of the quick look of a case.
+
+	// The profile used on a machine that has not recorded its own.
+	const string REFERENCE_PROFILE_PATH = "profiles/reference.txt";
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RegressionOptions
+//
+// The options the regression suite was started with. Relative paths are from
+// the working directory, which is the directory of the project when it is run
+// from Visual Studio.
+//////////////////////////////////////////////////////////////////////////////////
+struct RegressionOptions
+{
+	RegressionOptions()
+		: samplesDirectory("../traiter/"), goldenPath("golden.txt"), tolerancesPath("tolerances.txt"), repetitions(3), writeGolden(false), writeProfile(false)
+	{
+	}
+
+	string samplesDirectory;
+	string goldenPath;
+	string tolerancesPath;
+	string profilePath;	// Empty uses the profile of this machine, named after it.
+	int repetitions;
+	bool writeGolden;
+	bool writeProfile;
+};
+
+//////////////////////////////////////////////////////////////////////////////////
+// RegressionCase
+//
+// One image the suite analyzes: a sample image, or a generated one if the path
+// is empty. The name identifies the case in the golden values and budgets.
+//////////////////////////////////////////////////////////////////////////////////
+struct RegressionCase
+{
+	string name;
+	string imagePath;
+	RootImageParameters parameters;
+};
+
+//////////////////////////////////////////////////////////////////////////////////
+// CaseResults
+//
+// Every trait of a case, in output order, as each way of computing them found
+// it.
+//////////////////////////////////////////////////////////////////////////////////
+struct CaseResults
+{
+	vector<double> values;	// The full analysis on every core, which the golden values hold.
+	vector<double> serialValues;	// The full analysis on a single thread.
+	vector<double> distanceTransformValues;	// The full analysis with DISTANCE_TRANSFORM_SKELETON.
+	vector<double> streamedValues;	// The StripPipeline, which should match distanceTransformValues.
+	vector<double> quickLookValues;	// Approximate, so they have golden values of their own.
+	vector<double> refinedValues;	// The refined quick look, which should match values.
+};
+
+//////////////////////////////////////////////////////////////////////////////////
+// Measurement
+//
+// How long a stage of a case took, at best, and the peak memory of the process
+// once it had run.
+//////////////////////////////////////////////////////////////////////////////////
+struct Measurement
+{
+	string key;	// The case and the stage, separated by a space.
+	double milliseconds;
+	double peakMegabytes;
+};
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildCases()
+//
+// Lists the cases: the sample images, a photograph of real roots, and generated
+// images that cover a larger image and thinner, bushier roots than the samples
+// do.
+//////////////////////////////////////////////////////////////////////////////////
+static vector<RegressionCase> buildCases(const RegressionOptions& options)
+{
+	const string SAMPLE_IMAGES[] = { "rect.png", "bigrect.png", "bigrectodd.png", "weirdshape.png" };
+
+	vector<RegressionCase> cases;
+
+	for (const string& sampleImage : SAMPLE_IMAGES)
+	{
+		RegressionCase sample;
+		sample.name = sampleImage;
+		sample.imagePath = options.samplesDirectory + sampleImage;
+		cases.push_back(sample);
+	}
+
+	// roots.jpg from the samples, decoded once and stored losslessly, so that its golden values do not depend on the JPEG decoder.
+	RegressionCase photograph;
+	photograph.name = "roots.png";
+	photograph.imagePath = "roots.png";
+	cases.push_back(photograph);
+
+	RegressionCase generated;
+	generated.name = "generated_seed1";
+	generated.parameters.seed = 1;
+	cases.push_back(generated);
+
+	generated.name = "generated_seed2_4mp";
+	generated.parameters.width = 1732;
+	generated.parameters.height = 2309;
+	generated.parameters.rootCount = 16;
+	generated.parameters.seed = 2;
+	cases.push_back(generated);
+
+	generated.name = "generated_seed3_thin";
+	generated.parameters = RootImageParameters();
+	generated.parameters.rootCount = 12;
+	generated.parameters.thickness = 4;
+	generated.parameters.branchProbability = 0.04;
+	generated.parameters.seed = 3;
+	cases.push_back(generated);
+
+	return cases;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// measureStage()
+//
+// Runs the stage the specified number of times and records the fastest run,
+// which is the one least disturbed by the rest of the system, and the peak
+// memory of the process after it.
+//////////////////////////////////////////////////////////////////////////////////
+static void measureStage(const string& caseName, const string& stage, const function<void()>& run, const int repetitions, vector<Measurement>& measurements)
+{
+	double fastest = 0;
+
+	for (int repetition = 0; repetition < repetitions; ++repetition)
+	{
+		const int64 start = getTickCount();
+		run();
+		const double elapsed = (getTickCount() - start) * 1000 / getTickFrequency();
+
+		if (repetition == 0 || elapsed < fastest)
+			fastest = elapsed;
+	}
+
+	Measurement measurement;
+	measurement.key = caseName + " " + stage;
+	measurement.milliseconds = fastest;
+	measurement.peakMegabytes = ProcessMemory::getPeakMegabytes();
+	measurements.push_back(measurement);
+
+	cout << "  " << left << setw(28) << stage << right << setw(12) << fixed << setprecision(3) << measurement.milliseconds << " ms"
+		<< setw(12) << setprecision(1) << measurement.peakMegabytes << " MB peak" << endl;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeTraits()
+//
+// Computes every trait of the root system, in output order.
+//////////////////////////////////////////////////////////////////////////////////
+static vector<double> computeTraits(RootSystem& rootSystem)
+{
+	vector<double> values;
+
+	for (const TraitDescriptor& trait : TraitTable::getTraits())
+		values.push_back(rootSystem.computeTrait(trait));
+
+	return values;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeTraits()
+//
+// Builds the root system of the image with the specified skeleton and computes
+// every trait, in output order.
+//////////////////////////////////////////////////////////////////////////////////
+static vector<double> computeTraits(const Mat& image, const SkeletonMethod skeletonMethod)
+{
+	RootSystem rootSystem(image, skeletonMethod);
+
+	return computeTraits(rootSystem);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeStreamedTraits()
+//
+// Streams the image through the StripPipeline, as --stream does, and computes
+// every trait, in output order. Returns false and sets error if the pipeline
+// failed.
+//////////////////////////////////////////////////////////////////////////////////
+static bool computeStreamedTraits(const Mat& image, vector<double>& values, string& error)
+{
+	MatStripSource source(image);
+	RootSystemStatistics statistics;
+
+	if (!StripPipeline::computeStatistics(source, STREAM_STRIP_ROWS, THRESH, ThresholdParameters(), statistics, error))
+		return false;
+
+	RootSystem rootSystem(statistics);
+	values = computeTraits(rootSystem);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// runCase()
+//
+// Loads or generates the image of the case, times the stages of the pipeline on
+// it, and computes every trait in each of the ways traiter can: on every core
+// and on a single thread, with the distance transform skeleton in memory and
+// streamed, and from a quick look and its refinement. Returns false and sets
+// error if the image could not be read or streamed.
+//////////////////////////////////////////////////////////////////////////////////
+static bool runCase(const RegressionCase& regressionCase, const int repetitions, CaseResults& results, vector<Measurement>& measurements, string& error)
+{
+	cout << regressionCase.name << endl;
+
+	MappedImage mapping;	// Keeps the pixels of a mapped image valid until the case is done.
+	Mat image;
+
+	measureStage(regressionCase.name, "load", [&]()
+	{
+		if (regressionCase.imagePath.empty())
+			image = RootImageGenerator::generate(regressionCase.parameters);
+		else
+			image = MappedImage::load(regressionCase.imagePath, mapping, error);
+	}, 1, measurements);
+
+	if (image.empty())
+	{
+		error = regressionCase.imagePath + ": " + error;
+		return false;
+	}
+
+	// The stages that RootSystem runs before its traits, each on the output of the one before it.
+	Mat thresholdedImage;
+	measureStage(regressionCase.name, "threshold", [&]() { thresholdedImage = Thresholder::threshold(image, THRESH); }, repetitions, measurements);
+
+	Mat network;
+	measureStage(regressionCase.name, "component", [&]() { Rect boundingBox; ComponentLabeler::extractLargestComponent(thresholdedImage, network, boundingBox); }, repetitions, measurements);
+
+	measureStage(regressionCase.name, "skeleton", [&]() { Mat radiusMap; Skeletonizer::skeletonize(network, MEDIAL_AXIS_TRANSFORM, radiusMap); }, repetitions, measurements);
+
+	measureStage(regressionCase.name, "traits", [&]() { results.values = computeTraits(image, MEDIAL_AXIS_TRANSFORM); }, repetitions, measurements);
+
+	{
+		ParallelScope parallelScope(1);
+		measureStage(regressionCase.name, "traits_1_thread", [&]() { results.serialValues = computeTraits(image, MEDIAL_AXIS_TRANSFORM); }, repetitions, measurements);
+	}
+
+	measureStage(regressionCase.name, "traits_distance_transform", [&]() { results.distanceTransformValues = computeTraits(image, DISTANCE_TRANSFORM_SKELETON); }, repetitions, measurements);
+
+	bool streamed = true;
+	measureStage(regressionCase.name, "stream", [&]() { streamed = computeStreamedTraits(image, results.streamedValues, error); }, repetitions, measurements);
+
+	if (!streamed)
+	{
+		error = regressionCase.name + ": " + error;
+		return false;
+	}
+
+	// The quick look is timed without the refinement, which is a separate stage: a user reads one before asking for the other.
+	unique_ptr<QuickLook> quickLook;
+	measureStage(regressionCase.name, "quick_look", [&]()
+	{
+		quickLook.reset(new QuickLook(image, AnalysisOptions(), QUICK_LOOK_LEVEL));
+		results.quickLookValues = computeTraits(*quickLook->getRootSystem());
+	}, repetitions, measurements);
+
+	measureStage(regressionCase.name, "refine", [&]() { results.refinedValues = computeTraits(*quickLook->refine()); }, repetitions, measurements);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// formatValue()
+//
+// Formats a value with every significant digit, so that it reads back as the
+// same double. Values that are not finite are written the same way on every
+// platform.
+//////////////////////////////////////////////////////////////////////////////////
+static string formatValue(const double value)
+{
+	if (value != value)
+		return "nan";
+
+	if (value == numeric_limits<double>::infinity())
+		return "inf";
+
+	if (value == -numeric_limits<double>::infinity())
+		return "-inf";
+
+	ostringstream text;
+	text << setprecision(17) << value;
+
+	return text.str();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseValue()
+//
+// Parses a value written by formatValue(). Returns false if the text is not a
+// number.
+//////////////////////////////////////////////////////////////////////////////////
+static bool parseValue(const string& text, double& value)
+{
+	if (text == "nan")
+		value = numeric_limits<double>::quiet_NaN();
+	else if (text == "inf")
+		value = numeric_limits<double>::infinity();
+	else if (text == "-inf")
+		value = -numeric_limits<double>::infinity();
+	else
+	{
+		char* end = nullptr;
+		value = strtod(text.c_str(), &end);
+
+		return !text.empty() && *end == '\0';
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// readEntries()
+//
+// Reads a file of entries, one per line, each of which is a key of the
+// specified number of words followed by one or more numbers. Blank lines and
+// lines that start with # are skipped. Returns false and sets error if the file
+// could not be read or a line is not an entry.
+//////////////////////////////////////////////////////////////////////////////////
+static bool readEntries(const string& path, const int keyWords, const int valueCount, map<string, vector<double> >& entries, string& error)
+{
+	ifstream file(path.c_str());
+
+	if (!file)
+	{
+		error = path + ": could not be read";
+		return false;
+	}
+
+	string line;
+	int lineNumber = 0;
+
+	while (getline(file, line))
+	{
+		++lineNumber;
+
+		if (!line.empty() && line[line.size() - 1] == '\r')
+			line.erase(line.size() - 1);
+
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		istringstream stream(line);
+		vector<string> words;
+		string word;
+
+		while (stream >> word)
+			words.push_back(word);
+
+		vector<double> values(valueCount);
+		bool valid = static_cast<int>(words.size()) == keyWords + valueCount;
+
+		for (int value = 0; valid && value < valueCount; ++value)
+			valid = parseValue(words[keyWords + value], values[value]);
+
+		if (!valid)
+		{
+			error = path + ":" + to_string(lineNumber) + ": invalid entry: " + line;
+			return false;
+		}
+
+		string key = words[0];
+
+		for (int keyWord = 1; keyWord < keyWords; ++keyWord)
+			key += " " + words[keyWord];
+
+		entries[key] = values;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeFile()
+//
+// Writes the text to the file at the specified path, replacing it. Returns false
+// and sets error if the file could not be written.
+//////////////////////////////////////////////////////////////////////////////////
+static bool writeFile(const string& path, const string& text, string& error)
+{
+	ofstream file(path.c_str());
+	file << text;
+
+	if (!file.flush())
+	{
+		error = path + ": could not be written";
+		return false;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getMachineName()
+//
+// Returns the name of this machine, which names its profile of budgets.
+//////////////////////////////////////////////////////////////////////////////////
+static string getMachineName()
+{
+#if defined(_WIN32)
+	char name[MAX_COMPUTERNAME_LENGTH + 1];
+	DWORD size = sizeof(name);
+
+	return GetComputerNameA(name, &size) ? string(name, size) : "unknown";
+#else
+	char name[256] = {};
+
+	return gethostname(name, sizeof(name) - 1) == 0 ? string(name) : "unknown";
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkValue()
+//
+// Compares a trait with the value it is expected to have and prints it if it is
+// further from that value than allowed. Returns false if it is.
+//////////////////////////////////////////////////////////////////////////////////
+static bool checkValue(const string& label, const double value, const double expected, const string& expectedName, const double allowed)
+{
+	const bool bothNotANumber = value != value && expected != expected;
+
+	if (bothNotANumber || fabs(value - expected) <= allowed || value == expected)
+		return true;
+
+	cout << "FAIL " << label << ": " << formatValue(value) << ", " << expectedName << " " << formatValue(expected)
+		<< ", off by " << formatValue(fabs(value - expected)) << " where " << formatValue(allowed) << " is allowed" << endl;
+
+	return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkValues()
+//
+// Compares the traits of a case with the values they are expected to have and
+// prints every trait that is missing a tolerance, or is further from its
+// expected value than its tolerance allows: the absolute tolerance plus the
+// relative tolerance times the magnitude of the expected value. Traits that
+// depend on any of the skipped dependencies are not compared. Returns the number
+// of such traits.
+//////////////////////////////////////////////////////////////////////////////////
+static int checkValues(const string& caseName, const string& variant, const vector<double>& values, const vector<double>& expectedValues, const string& expectedName, const map<string, vector<double> >& tolerances, const int skippedDependencies = 0)
+{
+	const vector<TraitDescriptor>& traits = TraitTable::getTraits();
+
+	int failures = 0;
+
+	for (size_t trait = 0; trait < traits.size(); ++trait)
+	{
+		if (traits[trait].dependencies & skippedDependencies)
+			continue;
+
+		const string& name = traits[trait].name;
+		const map<string, vector<double> >::const_iterator tolerance = tolerances.find(name);
+
+		if (tolerance == tolerances.end())
+		{
+			cout << "FAIL " << caseName << " " << name << variant << ": no tolerance" << endl;
+			++failures;
+			continue;
+		}
+
+		const double expected = expectedValues[trait];
+		const double allowed = tolerance->second[0] + tolerance->second[1] * fabs(expected);
+
+		if (!checkValue(caseName + " " + name + variant, values[trait], expected, expectedName, allowed))
+			++failures;
+	}
+
+	return failures;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// findGoldenValues()
+//
+// Finds the golden value of every trait of a case, in output order, and prints
+// every trait that has none. Returns the number of such traits.
+//////////////////////////////////////////////////////////////////////////////////
+static int findGoldenValues(const string& caseName, const map<string, vector<double> >& golden, vector<double>& goldenValues)
+{
+	const vector<TraitDescriptor>& traits = TraitTable::getTraits();
+
+	int failures = 0;
+
+	goldenValues.assign(traits.size(), numeric_limits<double>::quiet_NaN());
+
+	for (size_t trait = 0; trait < traits.size(); ++trait)
+	{
+		const map<string, vector<double> >::const_iterator goldenValue = golden.find(caseName + " " + traits[trait].name);
+
+		if (goldenValue == golden.end())
+		{
+			cout << "FAIL " << caseName << " " << traits[trait].name << ": no golden value" << endl;
+			++failures;
+			continue;
+		}
+
+		goldenValues[trait] = goldenValue->second[0];
+	}
+
+	return failures;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// checkBudgets()
+//
+// Compares the time and peak memory of every stage with its budget and prints
+// every stage that is missing a budget or went over one. Returns the number of
+// such stages.
+//////////////////////////////////////////////////////////////////////////////////
+static int checkBudgets(const vector<Measurement>& measurements, const map<string, vector<double> >& budgets)
+{
+	int failures = 0;
+
+	for (const Measurement& measurement : measurements)
+	{
+		const map<string, vector<double> >::const_iterator budget = budgets.find(measurement.key);
+
+		if (budget == budgets.end())
+		{
+			cout << "FAIL " << measurement.key << ": no budget" << endl;
+			++failures;
+			continue;
+		}
+
+		if (measurement.milliseconds > budget->second[0])
+		{
+			cout << "FAIL " << measurement.key << ": took " << fixed << setprecision(3) << measurement.milliseconds
+				<< " ms where the budget is " << budget->second[0] << " ms" << endl;
+			++failures;
+		}
+
+		if (measurement.peakMegabytes > budget->second[1])
+		{
+			cout << "FAIL " << measurement.key << ": peak memory reached " << fixed << setprecision(1) << measurement.peakMegabytes
+				<< " MB where the budget is " << budget->second[1] << " MB" << endl;
+			++failures;
+		}
+	}
+
+	return failures;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseArguments()
+//
+// Parses the arguments into options. Returns false if an argument is not valid.
+//////////////////////////////////////////////////////////////////////////////////
+static bool parseArguments(const int argc, char** argv, RegressionOptions& options)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		const string argument = argv[i];
+
+		if (argument == "--write-golden")
+		{
+			options.writeGolden = true;
+			continue;
+		}
+
+		if (argument == "--write-profile")
+		{
+			options.writeProfile = true;
+			continue;
+		}
+
+		const size_t separator = argument.find('=');
+
+		if (separator == string::npos || separator + 1 == argument.size())
+			return false;
+
+		const string name = argument.substr(0, separator);
+		const string value = argument.substr(separator + 1);
+
+		if (name == "--samples")
+			options.samplesDirectory = value[value.size() - 1] == '/' || value[value.size() - 1] == '\\' ? value : value + "/";
+		else if (name == "--golden")
+			options.goldenPath = value;
+		else if (name == "--tolerances")
+			options.tolerancesPath = value;
+		else if (name == "--profile")
+			options.profilePath = value;
+		else if (name == "--repetitions")
+			options.repetitions = atoi(value.c_str());
+		else
+			return false;
+	}
+
+	return options.repetitions > 0;
+}
+
+int main(int argc, char** argv)
+{
+	RegressionOptions options;
+
+	if (!parseArguments(argc, argv, options))
+	{
+		cerr << "Usage: regression [--samples=directory] [--golden=file] [--tolerances=file] [--profile=file] [--repetitions=n] [--write-golden] [--write-profile]" << endl;
+		return EXIT_FAILURE;
+	}
+
+	const string machineProfilePath = "profiles/" + getMachineName() + ".txt";
+
+	// A machine that has not recorded its own budgets is held to those of the reference machine.
+	if (options.profilePath.empty())
+		options.profilePath = options.writeProfile || GeneralUtilities::fileExists(machineProfilePath) ? machineProfilePath : REFERENCE_PROFILE_PATH;
+
+	// Golden values that are being recorded are not checked. The tolerances are always needed, by the checks that compare two ways of computing the traits.
+	map<string, vector<double> > golden;
+	map<string, vector<double> > tolerances;
+	map<string, vector<double> > budgets;
+	string error;
+
+	if ((!options.writeGolden && !readEntries(options.goldenPath, 2, 1, golden, error)) || !readEntries(options.tolerancesPath, 1, 2, tolerances, error))
+	{
+		cerr << error << endl;
+		return EXIT_FAILURE;
+	}
+
+	bool checksBudgets = !options.writeProfile;
+
+	// Without a profile the traits are still worth checking, so only the budgets are skipped.
+	if (checksBudgets && !GeneralUtilities::fileExists(options.profilePath))
+	{
+		cerr << "Warning: " << options.profilePath << " does not exist, so the time and memory budgets are not checked." << endl;
+		cerr << "Record the budgets of this machine with --write-profile on a build that is known to be good." << endl;
+		checksBudgets = false;
+	}
+
+	if (checksBudgets && !readEntries(options.profilePath, 2, 2, budgets, error))
+	{
+		cerr << error << endl;
+		return EXIT_FAILURE;
+	}
+
+	// Stages reuse their scratch buffers across repetitions, as they do across the images of a batch.
+	Workspace workspace;
+	WorkspaceScope workspaceScope(&workspace);
+
+	const vector<TraitDescriptor>& traits = TraitTable::getTraits();
+
+	ostringstream goldenText;
+	goldenText << "# The value of every trait of every case, written by regression --write-golden." << endl;
+
+	ostringstream quickLookText;
+	quickLookText << "# The value of every trait of the quick look of every case." << endl;
+
+	vector<Measurement> measurements;
+	int failures = 0;
+
+	for (const RegressionCase& regressionCase : buildCases(options))
+	{
+		CaseResults results;
+
+		if (!runCase(regressionCase, options.repetitions, results, measurements, error))
+		{
+			cerr << error << endl;
+			return EXIT_FAILURE;
+		}
+
+		const string quickLookName = regressionCase.name + QUICK_LOOK_SUFFIX;
+
+		for (size_t trait = 0; trait < traits.size(); ++trait)
+			goldenText << regressionCase.name << " " << traits[trait].name << " " << formatValue(results.values[trait]) << endl;
+
+		for (size_t trait = 0; trait < traits.size(); ++trait)
+			quickLookText << quickLookName << " " << traits[trait].name << " " << formatValue(results.quickLookValues[trait]) << endl;
+
+		if (!options.writeGolden)
+		{
+			vector<double> goldenValues;
+			int missing = findGoldenValues(regressionCase.name, golden, goldenValues);
+
+			if (missing == 0)
+			{
+				failures += checkValues(regressionCase.name, "", results.values, goldenValues, "golden value", tolerances);
+				failures += checkValues(regressionCase.name, " (1 thread)", results.serialValues, goldenValues, "golden value", tolerances);
+			}
+
+			failures += missing;
+			missing = findGoldenValues(quickLookName, golden, goldenValues);
+
+			if (missing == 0)
+				failures += checkValues(quickLookName, "", results.quickLookValues, goldenValues, "golden value", tolerances);
+
+			failures += missing;
+		}
+
+		// These compare two ways of computing the same traits, so they need no golden values. A streamed image has no skeleton graph.
+		failures += checkValues(regressionCase.name, " (streamed)", results.streamedValues, results.distanceTransformValues, "in memory", tolerances, SKELETON_GRAPH_DEPENDENCY);
+		failures += checkValues(regressionCase.name, " (refined)", results.refinedValues, results.values, "full analysis", tolerances);
+	}
+
+	if (checksBudgets)
+		failures += checkBudgets(measurements, budgets);
+
+	if (options.writeGolden && !writeFile(options.goldenPath, goldenText.str() + quickLookText.str(), error))
+	{
+		cerr << error << endl;
+		return EXIT_FAILURE;
+	}
+
+	if (options.writeProfile)
+	{
+		ostringstream profileText;
+		profileText << "# The time, in milliseconds, and the peak memory once it has run, in megabytes, that each stage of" << endl
+			<< "# each case may take on " << getMachineName() << ", written by regression --write-profile." << endl;
+
+		for (const Measurement& measurement : measurements)
+		{
+			profileText << measurement.key << fixed
+				<< " " << setprecision(3) << max(measurement.milliseconds * TIME_HEADROOM, measurement.milliseconds + MINIMUM_TIME_HEADROOM)
+				<< " " << setprecision(1) << max(measurement.peakMegabytes * MEMORY_HEADROOM, measurement.peakMegabytes + MINIMUM_MEMORY_HEADROOM) << endl;
+		}
+
+		const size_t directoryEnd = options.profilePath.find_last_of("/\\");
+		const string directory = directoryEnd == string::npos ? "" : options.profilePath.substr(0, directoryEnd);
+
+		if (!directory.empty() && !GeneralUtilities::createDirectory(directory))
+		{
+			cerr << directory << ": could not be created" << endl;
+			return EXIT_FAILURE;
+		}
+
+		if (!writeFile(options.profilePath, profileText.str(), error))
+		{
+			cerr << error << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (failures > 0)
+	{
+		cout << failures << " checks failed" << endl;
+		return EXIT_FAILURE;
+	}
+
+	cout << "All checks passed" << endl;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,433 @@
+#include "analysis_server.h"
+#include "command_line.h"
+#include "image_analyzer.h"
+#include "parallel_for.h"
+#include "root_system.h"
+#include "workspace.h"
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace traiter;
+using namespace utility;
+
+namespace
+{
+	// A request longer than this is not a list of arguments, so its connection is closed.
+	const size_t MAXIMUM_REQUEST_BYTES = 1 << 16;
+
+#if defined(MSG_NOSIGNAL)
+	const int SEND_FLAGS = MSG_NOSIGNAL;	// A client that hangs up must not kill the server.
+#else
+	const int SEND_FLAGS = 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// AnalysisServer::AnalysisServer()
+//
+// Constructor to specify how many worker threads serve the connections to a
+// socket. A thread count of zero uses one thread per core.
+//////////////////////////////////////////////////////////////////////////////////
+AnalysisServer::AnalysisServer(const unsigned int threadCount)
+	: _threadCount(threadCount), _stopping(false)
+{
+	if (_threadCount == 0)
+		_threadCount = max(thread::hardware_concurrency(), 1u);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// serve()
+//
+// Answers each line of the input with a line of output, in order, until the
+// input ends. Requests are analyzed one at a time on the calling thread, and
+// each image is spread over the threads allowed by the current ParallelScope.
+// Blank lines are skipped, and every reply is flushed as soon as it is written.
+//////////////////////////////////////////////////////////////////////////////////
+void AnalysisServer::serve(istream& input, ostream& output)
+{
+	Workspace workspace;	// Kept until the input ends, so every request after the first finds its buffers allocated.
+	WorkspaceScope workspaceScope(&workspace);
+
+	string request;
+
+	while (getline(input, request))
+	{
+		if (!isBlank(request))
+			output << respond(request) << flush;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// serve()
+//
+// Listens on a Unix domain socket at the specified path and answers every line
+// a client sends with a line of its own, in order. Connections are handed to a
+// pool of worker threads, each of which serves one connection at a time and
+// analyzes each image on its own core, so clients that connect at the same time
+// are served at the same time.
+//
+// A socket left at the path by a server that is no longer running is replaced.
+// The server runs until accepting a connection fails, and then returns false
+// and sets error, as it does if the socket could not be created.
+//////////////////////////////////////////////////////////////////////////////////
+bool AnalysisServer::serve(const string& socketPath, string& error)
+{
+#if defined(_WIN32)
+	error = "Unix domain sockets are not supported on this platform; use --serve without a path to serve standard input.";
+	return false;
+#else
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+
+	if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path))
+	{
+		error = socketPath + ": invalid socket path";
+		return false;
+	}
+
+	socketPath.copy(address.sun_path, socketPath.size());
+
+	struct stat status;
+
+	if (lstat(socketPath.c_str(), &status) == 0)
+	{
+		if (!S_ISSOCK(status.st_mode))
+		{
+			error = socketPath + ": exists and is not a socket";
+			return false;
+		}
+
+		// A socket that still accepts connections belongs to a server that is running.
+		const int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		const bool inUse = probe >= 0 && connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+
+		if (probe >= 0)
+			close(probe);
+
+		if (inUse)
+		{
+			error = socketPath + ": another server is listening on this socket";
+			return false;
+		}
+
+		unlink(socketPath.c_str());
+	}
+
+	const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (listener < 0)
+	{
+		error = "could not create a socket";
+		return false;
+	}
+
+	if (::bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+	{
+		close(listener);
+		error = socketPath + ": could not listen on the socket";
+		return false;
+	}
+
+	vector<thread> workers;
+
+	for (unsigned int worker = 0; worker < _threadCount; ++worker)
+		workers.push_back(thread(&AnalysisServer::serveConnections, this));
+
+	while (true)
+	{
+		const int connection = accept(listener, nullptr, nullptr);
+
+		if (connection < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+
+			error = socketPath + ": could not accept a connection";
+			break;
+		}
+
+		{
+			lock_guard<mutex> lock(_mutex);
+			_connections.push_back(connection);
+		}
+
+		_connectionAccepted.notify_one();
+	}
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stopping = true;
+	}
+
+	_connectionAccepted.notify_all();
+
+	for (thread& worker : workers)
+		worker.join();
+
+	close(listener);
+	unlink(socketPath.c_str());
+
+	return false;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// respond()
+//
+// Returns the reply to a single request, which is the JSON object of its image,
+// as in the JSON output of a batch, on one line. A request that could not be
+// parsed or analyzed is answered with the reason instead of its traits.
+//////////////////////////////////////////////////////////////////////////////////
+string AnalysisServer::respond(const string& request)
+{
+	vector<TraitDescriptor> traits;
+	const TraitResult result = analyze(request, traits);
+
+	ostringstream reply;
+	TraitWriter::writeJsonLine(reply, result, traits);
+
+	return reply.str();
+}
+
+#if !defined(_WIN32)
+//////////////////////////////////////////////////////////////////////////////////
+// serveConnections()
+//
+// The loop of a worker thread, which serves the accepted connections one after
+// another until the server stops and none are left.
+//////////////////////////////////////////////////////////////////////////////////
+void AnalysisServer::serveConnections()
+{
+	Workspace workspace;	// Kept for as long as the server runs.
+	WorkspaceScope workspaceScope(&workspace);
+	ParallelScope parallelScope(1);	// Each worker has a core of its own.
+
+	while (true)
+	{
+		unique_lock<mutex> lock(_mutex);
+		_connectionAccepted.wait(lock, [&]() { return _stopping || !_connections.empty(); });
+
+		if (_connections.empty())
+			return;
+
+		const int connection = _connections.front();
+		_connections.pop_front();
+		lock.unlock();
+
+		serveConnection(connection);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// serveConnection()
+//
+// Answers every line received on the connection until the client hangs up, and
+// then closes it. A connection whose request grows past the longest request
+// accepted is closed without a reply.
+//////////////////////////////////////////////////////////////////////////////////
+void AnalysisServer::serveConnection(const int connection)
+{
+#if defined(SO_NOSIGPIPE)
+	const int noSignal = 1;
+	setsockopt(connection, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+
+	string pending;
+	char buffer[4096];
+	bool open = true;
+
+	while (open)
+	{
+		size_t lineEnd;
+
+		while (open && (lineEnd = pending.find('\n')) != string::npos)
+		{
+			const string request = pending.substr(0, lineEnd);
+			pending.erase(0, lineEnd + 1);
+
+			if (!isBlank(request))
+				open = sendReply(connection, respond(request));
+		}
+
+		if (!open || pending.size() > MAXIMUM_REQUEST_BYTES)
+			break;
+
+		const ssize_t received = recv(connection, buffer, sizeof(buffer), 0);
+
+		if (received < 0 && errno == EINTR)
+			continue;
+
+		if (received <= 0)
+			break;
+
+		pending.append(buffer, static_cast<size_t>(received));
+	}
+
+	close(connection);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// sendReply()
+//
+// Writes the whole reply to the connection. Returns false if the client hung up.
+//////////////////////////////////////////////////////////////////////////////////
+bool AnalysisServer::sendReply(const int connection, const string& reply)
+{
+	size_t sent = 0;
+
+	while (sent < reply.size())
+	{
+		const ssize_t written = send(connection, reply.data() + sent, reply.size() - sent, SEND_FLAGS);
+
+		if (written < 0 && errno == EINTR)
+			continue;
+
+		if (written <= 0)
+			return false;
+
+		sent += static_cast<size_t>(written);
+	}
+
+	return true;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////
+// analyze()
+//
+// Parses the request as the arguments of traiter for a single image, and
+// computes the traits it selects, which are also returned in traits. Failures
+// are recorded in the result rather than thrown, so that one bad request does
+// not stop the server. Options that only make sense for a whole run, such as
+// --batch, --output or --threads, are refused.
+//////////////////////////////////////////////////////////////////////////////////
+TraitResult AnalysisServer::analyze(const string& request, vector<TraitDescriptor>& traits)
+{
+	TraitResult result;
+	result.succeeded = false;
+
+	vector<string> arguments;
+
+	if (!splitArguments(request, arguments, result.error))
+		return result;
+
+	string programName = "traiter";
+	vector<char*> argv(1, &programName[0]);
+
+	for (string& argument : arguments)
+		argv.push_back(&argument[0]);
+
+	CommandLineOptions options;
+
+	if (!CommandLine::parse(static_cast<int>(argv.size()), &argv[0], options, result.error))
+		return result;
+
+	result.imagePath = options.imagePath;
+
+	// --threads=0 parses to the default thread count, so the argument itself is looked for.
+	const bool threadCountGiven = any_of(arguments.begin(), arguments.end(), [](const string& argument) { return argument.compare(0, 10, "--threads=") == 0; });
+
+	if (options.imagePath.empty() || options.serve || options.quickLookLevel >= 0 || options.thresholdSweep
+		|| !options.outputPath.empty() || !options.profilePath.empty() || !options.cachePath.empty() || threadCountGiven)
+	{
+		result.error = "A request only takes an image and the options that change its traits.";
+		return result;
+	}
+
+	traits = options.analysis.traits;
+
+	try
+	{
+		unique_ptr<RootSystem> rootSystem = ImageAnalyzer::analyze(options.imagePath, options.analysis, result.error);
+
+		if (!rootSystem)
+			return result;
+
+		for (const TraitDescriptor& trait : traits)
+			result.values.push_back(rootSystem->computeTrait(trait));
+
+		result.succeeded = true;
+	}
+	catch (const exception& e)
+	{
+		result.values.clear();
+		result.error = e.what();
+	}
+
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// splitArguments()
+//
+// Splits a request into arguments at runs of white space. Double quotes group
+// white space into an argument, as in "C:\Root Scans\plant 1.png", and are
+// removed. Returns false and sets error if a quote is not closed.
+//////////////////////////////////////////////////////////////////////////////////
+bool AnalysisServer::splitArguments(const string& request, vector<string>& arguments, string& error)
+{
+	arguments.clear();
+
+	string argument;
+	bool inArgument = false;
+	bool quoted = false;
+
+	for (const char character : request)
+	{
+		if (character == '"')
+		{
+			quoted = !quoted;
+			inArgument = true;	// Even "" is an argument.
+		}
+		else if (!quoted && isspace(static_cast<unsigned char>(character)))
+		{
+			if (inArgument)
+				arguments.push_back(argument);
+
+			argument.clear();
+			inArgument = false;
+		}
+		else
+		{
+			argument += character;
+			inArgument = true;
+		}
+	}
+
+	if (quoted)
+	{
+		error = "Unterminated quote in request.";
+		return false;
+	}
+
+	if (inArgument)
+		arguments.push_back(argument);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// isBlank()
+//
+// Returns true if the request holds nothing but white space, and so is not
+// answered.
+//////////////////////////////////////////////////////////////////////////////////
+bool AnalysisServer::isBlank(const string& request)
+{
+	return request.find_first_not_of(" \t\r") == string::npos;
+}
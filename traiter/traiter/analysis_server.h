@@ -0,0 +1,56 @@
+#pragma once
+
+#include "trait_writer.h"
+#include <condition_variable>
+#include <deque>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// AnalysisServer
+	//
+	// Answers requests for the traits of images for as long as it runs, so that a
+	// caller that analyzes one image at a time only pays for starting traiter once.
+	// Each request is a line holding the arguments traiter takes for a single
+	// image, and each reply is a line holding the JSON object of that image.
+	//
+	// Requests are read from a stream, or from the connections to a Unix domain
+	// socket, which are served on a fixed pool of worker threads. Every worker
+	// keeps its workspace for as long as the server runs, so the scratch buffers of
+	// one request are reused by the next.
+	//////////////////////////////////////////////////////////////////////////////////
+	class AnalysisServer final
+	{
+	public:
+		explicit AnalysisServer(const unsigned int threadCount = 0);
+
+		void serve(std::istream& input, std::ostream& output);
+		bool serve(const std::string& socketPath, std::string& error);
+
+		static std::string respond(const std::string& request);
+	private:
+		AnalysisServer();
+		AnalysisServer(const AnalysisServer&);
+		AnalysisServer& operator=(const AnalysisServer&);
+
+		void serveConnections();
+
+		static void serveConnection(const int connection);
+		static bool sendReply(const int connection, const std::string& reply);
+		static TraitResult analyze(const std::string& request, std::vector<TraitDescriptor>& traits);
+		static bool splitArguments(const std::string& request, std::vector<std::string>& arguments, std::string& error);
+		static bool isBlank(const std::string& request);
+
+		unsigned int _threadCount;
+
+		std::mutex _mutex;
+		std::condition_variable _connectionAccepted;
+		std::deque<int> _connections;	// Accepted connections no worker has taken yet.
+		bool _stopping;
+	};
+}
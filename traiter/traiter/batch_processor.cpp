@@ -0,0 +1,204 @@
+#include "batch_processor.h"
+#include "general_utilities.h"
+#include "parallel_for.h"
+#include "root_system.h"
+#include "trait_table.h"
+#include "workspace.h"
+#include <opencv2/core/core.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <thread>
+
+using namespace cv;
+using namespace std;
+using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// BatchProcessor::BatchProcessor()
+//
+// Constructor to specify how images are analyzed and how many worker threads to
+// use. A thread count of zero uses one thread per core. If profile is true, the
+// timers and counters of each image are recorded in its result. If a cache
+// directory is given, traits are looked up there before an image is analyzed,
+// and stored there after.
+//////////////////////////////////////////////////////////////////////////////////
+BatchProcessor::BatchProcessor(const AnalysisOptions& analysisOptions, const unsigned int threadCount, const bool profile, const string& cacheDirectory)
+	: _analysisOptions(analysisOptions), _threadCount(threadCount), _profile(profile), _cache(cacheDirectory, analysisOptions)
+{
+	if (_threadCount == 0)
+		_threadCount = max(thread::hardware_concurrency(), 1u);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// process()
+//
+// Computes the traits of every image. Workers claim the next unprocessed image
+// from a shared counter, so a slow image never holds up the others, and each
+// result is stored at the index of its image so the output order is
+// deterministic. With more than one worker, each image is processed on a single
+// thread; a lone worker spreads its image over the threads instead.
+//////////////////////////////////////////////////////////////////////////////////
+vector<TraitResult> BatchProcessor::process(const vector<string>& imagePaths)
+{
+	vector<TraitResult> results(imagePaths.size());
+	atomic<size_t> nextImage(0);
+	const size_t workerCount = min<size_t>(_threadCount, imagePaths.size());
+
+	auto worker = [&]()
+	{
+		Workspace workspace;	// Scratch buffers are reused by every image this worker processes.
+		WorkspaceScope workspaceScope(&workspace);
+		ParallelScope parallelScope(workerCount > 1 ? 1 : _threadCount);
+
+		for (size_t image = nextImage++; image < imagePaths.size(); image = nextImage++)
+			results[image] = processImage(imagePaths[image]);
+	};
+
+	vector<thread> workers;
+
+	for (size_t i = 1; i < workerCount; ++i)
+		workers.push_back(thread(worker));
+
+	worker();	// The calling thread does its share of the work too.
+
+	for (thread& workerThread : workers)
+		workerThread.join();
+
+	return results;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// collectImagePaths()
+//
+// Returns the sorted list of image files in the specified directory. If the path
+// is a file instead, it is read as a list with one image path per line.
+//////////////////////////////////////////////////////////////////////////////////
+vector<string> BatchProcessor::collectImagePaths(const string& directoryOrList)
+{
+	vector<string> imagePaths;
+
+	if (GeneralUtilities::isDirectory(directoryOrList))
+	{
+		vector<String> files;
+		glob(directoryOrList + "/*", files, false);
+
+		for (const String& file : files)
+		{
+			if (isImageFile(file))
+				imagePaths.push_back(file);
+		}
+
+		sort(imagePaths.begin(), imagePaths.end());	// The order glob returns files in depends on the file system.
+	}
+	else
+	{
+		ifstream list(directoryOrList.c_str());
+		string line;
+
+		while (getline(list, line))
+		{
+			line.erase(line.find_last_not_of(" \t\r\n") + 1);
+
+			if (!line.empty())
+				imagePaths.push_back(line);
+		}
+	}
+
+	return imagePaths;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// processImage()
+//
+// Computes the selected traits of a single image, reading whichever of them are
+// in the cache from it and adding the others to it. Failures are recorded in
+// the result rather than thrown, so that one bad scan does not stop the batch.
+//////////////////////////////////////////////////////////////////////////////////
+TraitResult BatchProcessor::processImage(const string& imagePath)
+{
+	TraitResult result;
+	result.imagePath = imagePath;
+	result.succeeded = false;
+
+	ProfileScope profileScope(_profile ? &result.profile : nullptr);
+
+	try
+	{
+		string cacheKey;
+		map<string, double> values;
+
+		if (_cache.isEnabled() && _cache.computeKey(imagePath, cacheKey))
+			_cache.load(cacheKey, values);
+
+		AnalysisOptions missingOptions = _analysisOptions;
+		missingOptions.traits.clear();
+
+		for (const TraitDescriptor& trait : _analysisOptions.traits)
+		{
+			if (values.find(trait.name) == values.end())
+				missingOptions.traits.push_back(trait);
+		}
+
+		if (!missingOptions.traits.empty())
+		{
+			// Only the traits the cache does not hold are computed, and only the results they depend on are built.
+			unique_ptr<RootSystem> rootSystem = ImageAnalyzer::analyze(imagePath, missingOptions, result.error);
+
+			if (!rootSystem)
+				return result;
+
+			map<string, double> computedValues;
+
+			for (const TraitDescriptor& trait : missingOptions.traits)
+				computedValues[trait.name] = rootSystem->computeTrait(trait);
+
+			if (!cacheKey.empty())
+				_cache.store(cacheKey, computedValues);
+
+			values.insert(computedValues.begin(), computedValues.end());
+		}
+
+		if (!cacheKey.empty())
+		{
+			TRAITER_PROFILE_COUNT(missingOptions.traits.empty() ? "cache_hits" : "cache_misses", 1);
+		}
+
+		for (const TraitDescriptor& trait : _analysisOptions.traits)
+			result.values.push_back(values[trait.name]);
+
+		result.succeeded = true;
+	}
+	catch (const exception& e)
+	{
+		result.values.clear();
+		result.error = e.what();
+	}
+
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// isImageFile()
+//
+// Returns true if the path has the extension of an image format that traiter
+// reads.
+//////////////////////////////////////////////////////////////////////////////////
+bool BatchProcessor::isImageFile(const string& path)
+{
+	const string IMAGE_EXTENSIONS[] = { "bmp", "jpeg", "jpg", "pbm", "pgm", "png", "tif", "tiff" };
+
+	const size_t extensionStart = path.find_last_of('.');
+
+	if (extensionStart == string::npos)
+		return false;
+
+	string extension = path.substr(extensionStart + 1);
+	transform(extension.begin(), extension.end(), extension.begin(), [](const char character) { return static_cast<char>(tolower(static_cast<unsigned char>(character))); });
+
+	return find(begin(IMAGE_EXTENSIONS), end(IMAGE_EXTENSIONS), extension) != end(IMAGE_EXTENSIONS);
+}
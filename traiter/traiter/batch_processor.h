@@ -0,0 +1,39 @@
+#pragma once
+
+#include "image_analyzer.h"
+#include "trait_cache.h"
+#include "trait_writer.h"
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// BatchProcessor
+	//
+	// Computes the traits of many images on a fixed-size pool of worker threads.
+	// Each worker builds one RootSystem at a time. Results are returned in the
+	// order the images were given, regardless of which worker finished first.
+	// Images whose traits are already in the cache are not analyzed again.
+	//////////////////////////////////////////////////////////////////////////////////
+	class BatchProcessor final
+	{
+	public:
+		BatchProcessor(const AnalysisOptions& analysisOptions, const unsigned int threadCount = 0, const bool profile = false, const std::string& cacheDirectory = std::string());
+
+		std::vector<TraitResult> process(const std::vector<std::string>& imagePaths);
+
+		static std::vector<std::string> collectImagePaths(const std::string& directoryOrList);
+	private:
+		BatchProcessor();
+
+		TraitResult processImage(const std::string& imagePath);
+
+		static bool isImageFile(const std::string& path);
+
+		AnalysisOptions _analysisOptions;
+		unsigned int _threadCount;
+		bool _profile;
+		TraitCache _cache;
+	};
+}
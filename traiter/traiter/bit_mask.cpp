@@ -0,0 +1,446 @@
+#include "bit_mask.h"
+#include "parallel_for.h"
+#include "profiler.h"
+#include <cassert>
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRAITER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+using namespace std;
+using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// BitMask::BitMask()
+//
+// Constructs an empty mask.
+//////////////////////////////////////////////////////////////////////////////////
+BitMask::BitMask()
+	: _rows(0), _cols(0), _wordsPerRow(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// BitMask::BitMask()
+//
+// Constructs an all-black mask of the specified size.
+//////////////////////////////////////////////////////////////////////////////////
+BitMask::BitMask(const int rows, const int cols)
+	: _rows(rows), _cols(cols), _wordsPerRow((cols + 63) / 64), _words(static_cast<size_t>(rows) * ((cols + 63) / 64), 0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// BitMask::BitMask()
+//
+// Packs the specified CV_8UC1 mask, in which any non-zero pixel is white. With
+// SSE2, sixteen pixels are packed at a time, and bands of rows are packed in
+// parallel.
+//////////////////////////////////////////////////////////////////////////////////
+BitMask::BitMask(const Mat& mask)
+	: _rows(mask.rows), _cols(mask.cols), _wordsPerRow((mask.cols + 63) / 64), _words(static_cast<size_t>(mask.rows) * ((mask.cols + 63) / 64), 0)
+{
+	TRAITER_PROFILE_COUNT("bytes_allocated", _words.size() * sizeof(uint64_t));
+
+	ParallelFor::run(_rows, ParallelFor::computeBandSize(_cols), [&](const int firstRow, const int endRow)
+	{
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			const uchar* maskRow = mask.ptr<uchar>(row);
+			uint64_t* words = rowWords(row);
+			int col = 0;
+
+#if defined(TRAITER_USE_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+
+			for (; col + 16 <= _cols; col += 16)
+			{
+				const __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(maskRow + col));
+				const uint64_t blackBits = static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, zero)));
+
+				words[col / 64] |= (~blackBits & 0xFFFF) << (col % 64);	// Sixteen-pixel groups never straddle a word.
+			}
+#endif
+
+			for (; col < _cols; ++col)
+			{
+				if (maskRow[col] != 0)
+					words[col / 64] |= static_cast<uint64_t>(1) << (col % 64);
+			}
+		}
+	});
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// toMat()
+//
+// Unpacks the mask into a CV_8UC1 image holding 0 and 255.
+//////////////////////////////////////////////////////////////////////////////////
+Mat BitMask::toMat() const
+{
+	Mat mask = Mat(_rows, _cols, CV_8UC1, Scalar(0));
+
+	for (int row = 0; row < _rows; ++row)
+	{
+		const uint64_t* words = rowWords(row);
+		uchar* maskRow = mask.ptr<uchar>(row);
+
+		for (int word = 0; word < _wordsPerRow; ++word)
+		{
+			// Only visit the set bits, so sparse rows unpack quickly.
+			for (uint64_t bits = words[word]; bits != 0; bits &= bits - 1)
+				maskRow[word * 64 + countTrailingZeros(bits)] = 255;
+		}
+	}
+
+	return mask;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rows()
+//
+// Returns the number of rows in the mask.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::rows() const
+{
+	return _rows;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// cols()
+//
+// Returns the number of columns in the mask.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::cols() const
+{
+	return _cols;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// wordsPerRow()
+//
+// Returns the number of 64-bit words used to store each row.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::wordsPerRow() const
+{
+	return _wordsPerRow;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// empty()
+//
+// Returns true if the mask has no pixels.
+//////////////////////////////////////////////////////////////////////////////////
+bool BitMask::empty() const
+{
+	return _rows == 0 || _cols == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rowWords()
+//
+// Returns a pointer to the first word of the specified row.
+//////////////////////////////////////////////////////////////////////////////////
+uint64_t* BitMask::rowWords(const int row)
+{
+	return _words.data() + static_cast<size_t>(row) * _wordsPerRow;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rowWords()
+//
+// Returns a pointer to the first word of the specified row.
+//////////////////////////////////////////////////////////////////////////////////
+const uint64_t* BitMask::rowWords(const int row) const
+{
+	return _words.data() + static_cast<size_t>(row) * _wordsPerRow;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// get()
+//
+// Returns true if the specified pixel is white.
+//////////////////////////////////////////////////////////////////////////////////
+bool BitMask::get(const int row, const int col) const
+{
+	return (rowWords(row)[col / 64] >> (col % 64)) & 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// set()
+//
+// Sets the specified pixel to white (true) or black (false).
+//////////////////////////////////////////////////////////////////////////////////
+void BitMask::set(const int row, const int col, const bool value)
+{
+	const uint64_t bit = static_cast<uint64_t>(1) << (col % 64);
+
+	if (value)
+		rowWords(row)[col / 64] |= bit;
+	else
+		rowWords(row)[col / 64] &= ~bit;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// area()
+//
+// Returns the number of white pixels in the mask.
+//////////////////////////////////////////////////////////////////////////////////
+long long BitMask::area() const
+{
+	long long area = 0;
+
+	for (const uint64_t word : _words)
+		area += popcount(word);
+
+	return area;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rowArea()
+//
+// Returns the number of white pixels in the specified row.
+//////////////////////////////////////////////////////////////////////////////////
+long long BitMask::rowArea(const int row) const
+{
+	const uint64_t* words = rowWords(row);
+	long long area = 0;
+
+	for (int word = 0; word < _wordsPerRow; ++word)
+		area += popcount(words[word]);
+
+	return area;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// risingEdges()
+//
+// Returns the number of white pixels in the specified row whose left neighbor is
+// black or outside of the image, which is the number of runs in the row. A pixel
+// starts a run when its bit is set and the bit below it is not, so the starts of
+// 64 pixels are found at once with x & ~(x << 1), carrying in the last bit of the
+// previous word.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::risingEdges(const int row) const
+{
+	const uint64_t* words = rowWords(row);
+	uint64_t carry = 0;
+	int edges = 0;
+
+	for (int word = 0; word < _wordsPerRow; ++word)
+	{
+		const uint64_t bits = words[word];
+		edges += popcount(bits & ~((bits << 1) | carry));
+		carry = bits >> 63;
+	}
+
+	return edges;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// firstColumn()
+//
+// Returns the column of the leftmost white pixel in the specified row, or -1 if
+// the row is entirely black.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::firstColumn(const int row) const
+{
+	const uint64_t* words = rowWords(row);
+
+	for (int word = 0; word < _wordsPerRow; ++word)
+	{
+		if (words[word] != 0)
+			return word * 64 + countTrailingZeros(words[word]);
+	}
+
+	return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// lastColumn()
+//
+// Returns the column of the rightmost white pixel in the specified row, or -1
+// if the row is entirely black.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::lastColumn(const int row) const
+{
+	const uint64_t* words = rowWords(row);
+
+	for (int word = _wordsPerRow - 1; word >= 0; --word)
+	{
+		if (words[word] != 0)
+			return word * 64 + findHighestBit(words[word]);
+	}
+
+	return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// operator&=()
+//
+// Keeps only the pixels that are white in both masks. The masks must be the same
+// size.
+//////////////////////////////////////////////////////////////////////////////////
+BitMask& BitMask::operator&=(const BitMask& other)
+{
+	assert(_rows == other._rows && _cols == other._cols);
+
+	for (size_t i = 0; i < _words.size(); ++i)
+		_words[i] &= other._words[i];
+
+	return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// operator|=()
+//
+// Makes every pixel that is white in either mask white. The masks must be the
+// same size.
+//////////////////////////////////////////////////////////////////////////////////
+BitMask& BitMask::operator|=(const BitMask& other)
+{
+	assert(_rows == other._rows && _cols == other._cols);
+
+	for (size_t i = 0; i < _words.size(); ++i)
+		_words[i] |= other._words[i];
+
+	return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// operator^=()
+//
+// Makes white the pixels that are white in exactly one of the masks. The masks
+// must be the same size.
+//////////////////////////////////////////////////////////////////////////////////
+BitMask& BitMask::operator^=(const BitMask& other)
+{
+	assert(_rows == other._rows && _cols == other._cols);
+
+	for (size_t i = 0; i < _words.size(); ++i)
+		_words[i] ^= other._words[i];
+
+	return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// invert()
+//
+// Swaps white and black pixels.
+//////////////////////////////////////////////////////////////////////////////////
+void BitMask::invert()
+{
+	for (uint64_t& word : _words)
+		word = ~word;
+
+	clearPadding();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// popcount()
+//
+// Returns the number of set bits in the word. The POPCNT instruction that
+// __popcnt64 compiles to is not part of x64 itself, so it is only used once the
+// processor has been found to support it. Otherwise the bits are counted in
+// parallel within the word.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::popcount(const uint64_t word)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	static const bool popcntSupported = supportsPopcnt();	// A thread that reads it before it is set counts the bits portably, with the same result.
+
+	if (popcntSupported)
+		return static_cast<int>(__popcnt64(word));
+#elif defined(__GNUC__)
+	return __builtin_popcountll(word);
+#endif
+
+	uint64_t bits = word - ((word >> 1) & 0x5555555555555555ULL);
+	bits = (bits & 0x3333333333333333ULL) + ((bits >> 2) & 0x3333333333333333ULL);
+	bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return static_cast<int>((bits * 0x0101010101010101ULL) >> 56);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// supportsPopcnt()
+//
+// Returns true if the processor has the POPCNT instruction, which CPUID reports
+// in bit 23 of ECX for function 1.
+//////////////////////////////////////////////////////////////////////////////////
+bool BitMask::supportsPopcnt()
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	int registers[4];
+	__cpuid(registers, 1);
+
+	return (registers[2] & (1 << 23)) != 0;
+#else
+	return false;	// __builtin_popcountll is used instead, which only emits POPCNT when the target has it.
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// countTrailingZeros()
+//
+// Returns the index of the lowest set bit of a non-zero word.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::countTrailingZeros(const uint64_t word)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return static_cast<int>(index);
+#elif defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	int index = 0;
+	while (!((word >> index) & 1))
+		++index;
+	return index;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// findHighestBit()
+//
+// Returns the index of the highest set bit of a non-zero word.
+//////////////////////////////////////////////////////////////////////////////////
+int BitMask::findHighestBit(const uint64_t word)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanReverse64(&index, word);
+	return static_cast<int>(index);
+#elif defined(__GNUC__)
+	return 63 - __builtin_clzll(word);
+#else
+	int index = 63;
+	while (!((word >> index) & 1))
+		--index;
+	return index;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// clearPadding()
+//
+// Clears the bits past the last column of every row.
+//////////////////////////////////////////////////////////////////////////////////
+void BitMask::clearPadding()
+{
+	if (_cols % 64 == 0)
+		return;
+
+	const uint64_t lastWordMask = (static_cast<uint64_t>(1) << (_cols % 64)) - 1;
+
+	for (int row = 0; row < _rows; ++row)
+		rowWords(row)[_wordsPerRow - 1] &= lastWordMask;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <stdint.h>
+#include <vector>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// BitMask
+	//
+	// A binary mask packed at one bit per pixel. Each row starts on a 64-bit word,
+	// and pixel col of a row is bit col % 64 of word col / 64. Bits past the last
+	// column of a row are always zero, so whole words can be counted and combined
+	// without masking.
+	//////////////////////////////////////////////////////////////////////////////////
+	class BitMask final
+	{
+	public:
+		BitMask();
+		BitMask(const int rows, const int cols);
+		explicit BitMask(const cv::Mat& mask);
+
+		cv::Mat toMat() const;
+
+		int rows() const;
+		int cols() const;
+		int wordsPerRow() const;
+		bool empty() const;
+
+		uint64_t* rowWords(const int row);
+		const uint64_t* rowWords(const int row) const;
+
+		bool get(const int row, const int col) const;
+		void set(const int row, const int col, const bool value);
+
+		long long area() const;
+		long long rowArea(const int row) const;
+		int risingEdges(const int row) const;
+		int firstColumn(const int row) const;
+		int lastColumn(const int row) const;
+
+		BitMask& operator&=(const BitMask& other);
+		BitMask& operator|=(const BitMask& other);
+		BitMask& operator^=(const BitMask& other);
+		void invert();
+
+		static int popcount(const uint64_t word);
+		static int countTrailingZeros(const uint64_t word);
+		static int findHighestBit(const uint64_t word);
+	private:
+		void clearPadding();
+
+		static bool supportsPopcnt();
+
+		int _rows;
+		int _cols;
+		int _wordsPerRow;
+		std::vector<uint64_t> _words;
+	};
+}
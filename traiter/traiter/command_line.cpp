@@ -0,0 +1,529 @@
+#include "command_line.h"
+#include "skeleton_method.h"
+#include "thresh_method.h"
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+using namespace std;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// CommandLineOptions::CommandLineOptions()
+//
+// Constructor that sets every option to its default.
+//////////////////////////////////////////////////////////////////////////////////
+CommandLineOptions::CommandLineOptions()
+	: quickLookLevel(-1), refine(false), outputFormat(CSV_OUTPUT), series(false), thresholdSweep(false), serve(false), threadCount(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parse()
+//
+// Parses the arguments into options. Returns false and describes the problem in
+// error if the arguments are not valid.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parse(const int argc, char** argv, CommandLineOptions& options, string& error)
+{
+	const unsigned int MAXIMUM_QUICK_LOOK_LEVEL = 8;	// Beyond this, even a large scan is reduced to a handful of pixels.
+
+	options = CommandLineOptions();
+	bool skeletonMethodGiven = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const string argument = argv[i];
+		string value;
+
+		if (parseOption(argument, "--threshold", value))
+		{
+			if (!parseThreshMethod(value, options.analysis.threshMethod))
+			{
+				error = "Unknown thresholding method: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--threshold-value", value))
+		{
+			if (!parseThresholdValue(value, options.analysis.thresholdParameters))
+			{
+				error = "Invalid threshold value: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--block-size", value))
+		{
+			if (!parseBlockSize(value, options.analysis.thresholdParameters.blockSize))
+			{
+				error = "Invalid block size: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--offset", value))
+		{
+			if (!parseDouble(value, options.analysis.thresholdParameters.offset))
+			{
+				error = "Invalid offset: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--contrast-block-size", value))
+		{
+			if (!parseBlockSize(value, options.analysis.thresholdParameters.contrastBlockSize))
+			{
+				error = "Invalid contrast block size: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--minimum-contrast", value))
+		{
+			if (!parseDouble(value, options.analysis.thresholdParameters.minimumContrast) || options.analysis.thresholdParameters.minimumContrast < 0)
+			{
+				error = "Invalid minimum contrast: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--skeleton", value))
+		{
+			if (!parseSkeletonMethod(value, options.analysis.skeletonMethod))
+			{
+				error = "Unknown skeleton method: " + value;
+				return false;
+			}
+
+			skeletonMethodGiven = true;
+		}
+		else if (parseOption(argument, "--traits", value))
+		{
+			if (!parseTraits(value, options.analysis.traits, error))
+				return false;
+		}
+		else if (parseOption(argument, "--stream", value))
+		{
+			if (!parseUnsignedInteger(value, options.analysis.stripRows) || options.analysis.stripRows == 0 || options.analysis.stripRows > INT_MAX)
+			{
+				error = "Invalid strip height: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--batch", value))
+		{
+			options.batchInput = value;
+		}
+		else if (parseOption(argument, "--quick-look", value))
+		{
+			unsigned int level;
+
+			if (!parseUnsignedInteger(value, level) || level > MAXIMUM_QUICK_LOOK_LEVEL)
+			{
+				error = "Invalid quick look level: " + value;
+				return false;
+			}
+
+			options.quickLookLevel = static_cast<int>(level);
+		}
+		else if (argument == "--refine")
+		{
+			options.refine = true;
+		}
+		else if (argument == "--series")
+		{
+			options.series = true;
+		}
+		else if (argument == "--threshold-sweep")
+		{
+			options.thresholdSweep = true;
+		}
+		else if (argument == "--serve")
+		{
+			options.serve = true;
+		}
+		else if (parseOption(argument, "--serve", value))
+		{
+			options.serve = true;
+			options.socketPath = value;
+		}
+		else if (parseOption(argument, "--output", value))
+		{
+			options.outputPath = value;
+		}
+		else if (parseOption(argument, "--format", value))
+		{
+			if (!parseOutputFormat(value, options.outputFormat))
+			{
+				error = "Unknown output format: " + value;
+				return false;
+			}
+		}
+		else if (parseOption(argument, "--profile", value))
+		{
+			options.profilePath = value;
+		}
+		else if (parseOption(argument, "--cache", value))
+		{
+			options.cachePath = value;
+		}
+		else if (parseOption(argument, "--threads", value))
+		{
+			if (!parseUnsignedInteger(value, options.threadCount))
+			{
+				error = "Invalid thread count: " + value;
+				return false;
+			}
+		}
+		else if (argument.compare(0, 2, "--") == 0)
+		{
+			error = "Unrecognized option: " + argument;
+			return false;
+		}
+		else if (options.imagePath.empty())
+		{
+			options.imagePath = argument;
+		}
+		else
+		{
+			error = "Unexpected argument: " + argument;
+			return false;
+		}
+	}
+
+	if (options.serve)
+	{
+		// Every request brings its own image and options, so the server only takes the number of threads.
+		for (int i = 1; i < argc; ++i)
+		{
+			const string argument = argv[i];
+			string value;
+
+			if (argument != "--serve" && !parseOption(argument, "--serve", value) && !parseOption(argument, "--threads", value))
+			{
+				error = "--serve only takes --threads; give the image and its options in each request.";
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	if (options.imagePath.empty() == options.batchInput.empty())
+	{
+		error = "Specify either an image or --batch.";
+		return false;
+	}
+
+	// The adaptive threshold compares each pixel with the mean of its window, so
+	// there is no global value for Otsu's or the triangle method to choose.
+	if (options.analysis.threshMethod == ADAPTIVE_THRESH && options.analysis.thresholdParameters.thresholdSelection != segment::FIXED_THRESHOLD)
+	{
+		error = "--threshold-value=otsu and --threshold-value=triangle cannot be combined with --threshold=adaptive.";
+		return false;
+	}
+
+	if (options.analysis.stripRows > 0)
+	{
+		// Only the distance transform skeleton can be computed one strip at a time.
+		if (skeletonMethodGiven && options.analysis.skeletonMethod != DISTANCE_TRANSFORM_SKELETON)
+		{
+			error = "--stream requires --skeleton=distance-transform.";
+			return false;
+		}
+
+		options.analysis.skeletonMethod = DISTANCE_TRANSFORM_SKELETON;
+	}
+
+	if (options.quickLookLevel >= 0 && (!options.batchInput.empty() || options.analysis.stripRows > 0))
+	{
+		error = "--quick-look only applies to a single image that is loaded whole.";
+		return false;
+	}
+
+	if (options.refine && options.quickLookLevel < 0)
+	{
+		error = "--refine requires --quick-look.";
+		return false;
+	}
+
+	if (!options.cachePath.empty() && options.batchInput.empty())
+	{
+		error = "--cache requires --batch.";
+		return false;
+	}
+
+	// A sweep only reads the histograms of the images, and none of the traits.
+	if (options.thresholdSweep && (options.series || options.analysis.stripRows > 0 || options.quickLookLevel >= 0 || !options.cachePath.empty()))
+	{
+		error = "--threshold-sweep cannot be combined with --series, --stream, --quick-look or --cache.";
+		return false;
+	}
+
+	if (options.series)
+	{
+		if (options.batchInput.empty())
+		{
+			error = "--series requires --batch.";
+			return false;
+		}
+
+		if (options.analysis.stripRows > 0)
+		{
+			error = "--series cannot be combined with --stream.";
+			return false;
+		}
+
+		// Every frame is computed from the one before it, so none can be skipped.
+		if (!options.cachePath.empty())
+		{
+			error = "--series cannot be combined with --cache.";
+			return false;
+		}
+
+		// Only the distance transform skeleton can be updated one band of rows at a time.
+		if (skeletonMethodGiven && options.analysis.skeletonMethod != DISTANCE_TRANSFORM_SKELETON)
+		{
+			error = "--series requires --skeleton=distance-transform.";
+			return false;
+		}
+
+		options.analysis.skeletonMethod = DISTANCE_TRANSFORM_SKELETON;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// printUsage()
+//
+// Describes the arguments traiter accepts.
+//////////////////////////////////////////////////////////////////////////////////
+void CommandLine::printUsage(ostream& stream)
+{
+	stream << "Usage: traiter image_name [--threads=n] [--quick-look=level [--refine]] [options]\n"
+		<< "       traiter --batch=directory_or_list [--output=file] [--format=csv|json] [--threads=n] [--series | --cache=directory] [options]\n"
+		<< "       traiter image_name|--batch=directory_or_list --threshold-sweep [--output=file] [--format=csv|json]\n"
+		<< "       traiter --serve[=socket_path] [--threads=n]\n"
+		<< "\n"
+		<< "Options:\n"
+		<< "  --threshold=global|adaptive|double-adaptive\n"
+		<< "  --threshold-value=n|otsu|triangle\n"
+		<< "                             Global threshold, and the threshold of flat regions when double-adaptive (default 183),\n"
+		<< "                             or the method that chooses it from the histogram of each image\n"
+		<< "  --block-size=n             Odd width of the window whose mean a pixel is compared to (default 19)\n"
+		<< "  --offset=x                 Amount subtracted from the window mean (default 0)\n"
+		<< "  --contrast-block-size=n    Odd width of the window whose contrast is measured when double-adaptive (default 61)\n"
+		<< "  --minimum-contrast=x       Standard deviation below which a window is flat when double-adaptive (default 15)\n"
+		<< "  --skeleton=medial-axis|morphological|distance-transform|thinning\n"
+		<< "  --traits=name,...          Only compute these traits, named as in the output, skipping the stages no other trait needs\n"
+		<< "  --stream=rows              Read images in strips of this many rows instead of all at once\n"
+		<< "  --quick-look=level         Estimate the traits, with error bounds, from a pyramid level with 1/4^level of the pixels\n"
+		<< "  --refine                   After a quick look, compute the exact traits of the region the network was found in\n"
+		<< "  --series                   Treat the batch as frames of one plant, in order, and only recompute what changed\n"
+		<< "  --threshold-sweep          Only write how many pixels are brighter than each threshold value, over every image,\n"
+		<< "                             and print the values Otsu's and the triangle method choose\n"
+		<< "  --cache=directory          Reuse the traits of images analyzed before with the same options\n"
+		<< "  --serve[=socket_path]      Answer requests, each one line with an image and its options, on standard input or a socket\n"
+		<< "  --profile=file             Write the time spent in each stage, and other counters, to a JSON file\n";
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseOption()
+//
+// Returns true if the argument has the form name=value, and stores the value.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseOption(const string& argument, const string& name, string& value)
+{
+	if (argument.size() <= name.size() || argument.compare(0, name.size(), name) != 0 || argument[name.size()] != '=')
+		return false;
+
+	value = argument.substr(name.size() + 1);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseThreshMethod()
+//
+// Converts the value of the --threshold option to a ThreshMethod. Returns false
+// if the name is not recognized.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseThreshMethod(const string& name, ThreshMethod& threshMethod)
+{
+	if (name == "global")
+		threshMethod = THRESH;
+	else if (name == "adaptive")
+		threshMethod = ADAPTIVE_THRESH;
+	else if (name == "double-adaptive")
+		threshMethod = DOUBLE_ADAPTIVE_THRESH;
+	else
+		return false;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseThresholdValue()
+//
+// Converts the value of the --threshold-value option to either a fixed threshold
+// value of at most 255 or the method that chooses it. Returns false if the text
+// is neither.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseThresholdValue(const string& text, segment::ThresholdParameters& thresholdParameters)
+{
+	unsigned int thresholdValue;
+
+	if (text == "otsu")
+	{
+		thresholdParameters.thresholdSelection = segment::OTSU_THRESHOLD;
+	}
+	else if (text == "triangle")
+	{
+		thresholdParameters.thresholdSelection = segment::TRIANGLE_THRESHOLD;
+	}
+	else if (parseUnsignedInteger(text, thresholdValue) && thresholdValue <= 255)
+	{
+		thresholdParameters.thresholdValue = static_cast<int>(thresholdValue);
+		thresholdParameters.thresholdSelection = segment::FIXED_THRESHOLD;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseSkeletonMethod()
+//
+// Converts the value of the --skeleton option to a SkeletonMethod. Returns false
+// if the name is not recognized.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseSkeletonMethod(const string& name, SkeletonMethod& skeletonMethod)
+{
+	if (name == "morphological")
+		skeletonMethod = MORPHOLOGICAL_SKELETON;
+	else if (name == "medial-axis")
+		skeletonMethod = MEDIAL_AXIS_TRANSFORM;
+	else if (name == "distance-transform")
+		skeletonMethod = DISTANCE_TRANSFORM_SKELETON;
+	else if (name == "thinning")
+		skeletonMethod = THINNED_SKELETON;
+	else
+		return false;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseOutputFormat()
+//
+// Converts the value of the --format option to an OutputFormat. Returns false if
+// the name is not recognized.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseOutputFormat(const string& name, OutputFormat& outputFormat)
+{
+	if (name == "csv")
+		outputFormat = CSV_OUTPUT;
+	else if (name == "json")
+		outputFormat = JSON_OUTPUT;
+	else
+		return false;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseTraits()
+//
+// Converts the comma-separated trait names of the --traits option to their
+// descriptors, in the order given. Names that are repeated are only kept once.
+// Returns false and sets error if a name is not a trait.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseTraits(const string& text, vector<TraitDescriptor>& traits, string& error)
+{
+	vector<TraitDescriptor> selectedTraits;
+	size_t nameStart = 0;
+
+	while (nameStart <= text.size())
+	{
+		size_t nameEnd = text.find(',', nameStart);
+
+		if (nameEnd == string::npos)
+			nameEnd = text.size();
+
+		const string name = text.substr(nameStart, nameEnd - nameStart);
+		const TraitDescriptor* trait = TraitTable::findTrait(name);
+
+		if (!trait)
+		{
+			error = "Unknown trait: " + name;
+			return false;
+		}
+
+		const bool repeated = find_if(selectedTraits.begin(), selectedTraits.end(), [&](const TraitDescriptor& selectedTrait) { return selectedTrait.name == name; }) != selectedTraits.end();
+
+		if (!repeated)
+			selectedTraits.push_back(*trait);
+
+		nameStart = nameEnd + 1;
+	}
+
+	traits.swap(selectedTraits);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseUnsignedInteger()
+//
+// Converts the text to an unsigned integer. Returns false if the text is not a
+// whole number, or if the number does not fit in an unsigned int.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseUnsignedInteger(const string& text, unsigned int& value)
+{
+	if (text.empty() || text.find_first_not_of("0123456789") != string::npos)
+		return false;
+
+	errno = 0;
+	const unsigned long parsedValue = strtoul(text.c_str(), nullptr, 10);
+
+	if (errno == ERANGE || parsedValue > UINT_MAX)
+		return false;
+
+	value = static_cast<unsigned int>(parsedValue);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseBlockSize()
+//
+// Converts the text to the width of a thresholding window. Returns false if the
+// width is not an odd number of at least 3, which is what a centered window
+// needs.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseBlockSize(const string& text, int& blockSize)
+{
+	unsigned int value;
+
+	if (!parseUnsignedInteger(text, value) || value < 3 || value % 2 == 0 || value > INT_MAX)
+		return false;
+
+	blockSize = static_cast<int>(value);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseDouble()
+//
+// Converts the text to a number, which may be signed and have a fractional
+// part. Returns false if the text is not entirely a number.
+//////////////////////////////////////////////////////////////////////////////////
+bool CommandLine::parseDouble(const string& text, double& value)
+{
+	if (text.empty())
+		return false;
+
+	char* end;
+	value = strtod(text.c_str(), &end);
+
+	return *end == '\0';
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "image_analyzer.h"
+#include "output_format.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// CommandLineOptions
+	//
+	// The options traiter was started with. Exactly one of imagePath and
+	// batchInput is set, unless traiter is serving requests.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct CommandLineOptions
+	{
+		CommandLineOptions();
+
+		// Interactive mode
+		std::string imagePath;
+		int quickLookLevel;	// The pyramid level to estimate the traits at, or -1 to compute them exactly.
+		bool refine;	// Also compute the exact traits of a quick look.
+
+		// Batch mode
+		std::string batchInput;
+		std::string outputPath;
+		OutputFormat outputFormat;
+		bool series;	// The images are frames of one plant, in order.
+
+		// Calibration
+		bool thresholdSweep;	// Only report the mask area at every threshold value.
+
+		// Server mode
+		bool serve;
+		std::string socketPath;	// The Unix domain socket requests arrive on, or empty for standard input.
+
+		// Pipeline
+		AnalysisOptions analysis;
+		unsigned int threadCount;	// Zero uses one thread per core.
+		std::string profilePath;
+		std::string cachePath;	// The directory batch results are cached in, or empty for no cache.
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// CommandLine
+	//
+	// Parses the arguments traiter was started with.
+	//////////////////////////////////////////////////////////////////////////////////
+	class CommandLine final
+	{
+	public:
+		static bool parse(const int argc, char** argv, CommandLineOptions& options, std::string& error);
+		static void printUsage(std::ostream& stream);
+	private:
+		static bool parseOption(const std::string& argument, const std::string& name, std::string& value);
+		static bool parseThreshMethod(const std::string& name, ThreshMethod& threshMethod);
+		static bool parseThresholdValue(const std::string& text, segment::ThresholdParameters& thresholdParameters);
+		static bool parseSkeletonMethod(const std::string& name, SkeletonMethod& skeletonMethod);
+		static bool parseOutputFormat(const std::string& name, OutputFormat& outputFormat);
+		static bool parseTraits(const std::string& text, std::vector<TraitDescriptor>& traits, std::string& error);
+		static bool parseUnsignedInteger(const std::string& text, unsigned int& value);
+		static bool parseBlockSize(const std::string& text, int& blockSize);
+		static bool parseDouble(const std::string& text, double& value);
+
+		CommandLine();
+	};
+}
@@ -0,0 +1,151 @@
+#include "component_labeler.h"
+#include "profiler.h"
+#include "run_length_mask.h"
+#include <algorithm>
+#include <climits>
+
+using namespace cv;
+using namespace segment;
+using namespace std;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// extractLargestComponent()
+//
+// Finds the 8-connected component of the image with the most white pixels, and
+// draws it into componentMask, which is the same size as the image and may be
+// the image itself. Holes in the component are left black. Returns the number
+// of pixels in the component and sets boundingBox to its extents, or returns 0
+// if the image has no white pixels.
+//////////////////////////////////////////////////////////////////////////////////
+long long ComponentLabeler::extractLargestComponent(const Mat& image, Mat& componentMask, Rect& boundingBox)
+{
+	TRAITER_PROFILE_SCOPE("ComponentLabeler::extractLargestComponent");
+	TRAITER_PROFILE_COUNT("pixels_visited", image.total());
+
+	const RunLengthMask runs = RunLengthMask(image);
+	const int rows = runs.rows();
+
+	vector<int> runLabels;	// The label of every run, in row order.
+	vector<int> parents;
+	vector<long long> labelAreas;
+
+	size_t previousRowStart = 0;
+
+	for (int row = 0; row < rows; ++row)
+	{
+		const size_t rowStart = runLabels.size();
+		const Run* previousRow = row > 0 ? runs.rowBegin(row - 1) : nullptr;
+		const int previousRunCount = row > 0 ? runs.runCount(row - 1) : 0;
+		int previous = 0;
+
+		for (const Run* run = runs.rowBegin(row); run != runs.rowEnd(row); ++run)
+		{
+			// A run in the row above touches this run if they overlap or meet diagonally.
+			while (previous < previousRunCount && previousRow[previous].end < run->start)
+				++previous;
+
+			int label = -1;
+
+			for (int touching = previous; touching < previousRunCount && previousRow[touching].start <= run->end; ++touching)
+			{
+				if (label < 0)
+					label = runLabels[previousRowStart + touching];
+				else
+					unite(parents, label, runLabels[previousRowStart + touching]);
+			}
+
+			if (label < 0)
+			{
+				label = static_cast<int>(parents.size());
+				parents.push_back(label);
+				labelAreas.push_back(0);
+			}
+
+			runLabels.push_back(label);
+			labelAreas[label] += run->end - run->start;
+		}
+
+		previousRowStart = rowStart;
+	}
+
+	TRAITER_PROFILE_COUNT("components_found", parents.size());
+
+	// The runs hold everything still needed from the image, so the mask may be the image itself.
+	componentMask.create(image.size(), CV_8UC1);
+	componentMask.setTo(Scalar(0));
+	boundingBox = Rect();
+
+	if (parents.empty())
+		return 0;	// The image is entirely black.
+
+	vector<long long> componentAreas(parents.size(), 0);
+
+	for (int label = 0; label < static_cast<int>(parents.size()); ++label)
+		componentAreas[findRoot(parents, label)] += labelAreas[label];
+
+	const int largestComponent = static_cast<int>(max_element(componentAreas.begin(), componentAreas.end()) - componentAreas.begin());
+
+	int minX = INT_MAX;
+	int maxX = INT_MIN;
+	int minY = INT_MAX;
+	int maxY = INT_MIN;
+
+	size_t runIndex = 0;
+
+	for (int row = 0; row < rows; ++row)
+	{
+		uchar* maskRow = componentMask.ptr<uchar>(row);
+
+		for (const Run* run = runs.rowBegin(row); run != runs.rowEnd(row); ++run, ++runIndex)
+		{
+			if (findRoot(parents, runLabels[runIndex]) != largestComponent)
+				continue;
+
+			fill(maskRow + run->start, maskRow + run->end, static_cast<uchar>(255));
+
+			minX = min(minX, run->start);
+			maxX = max(maxX, run->end);
+			minY = min(minY, row);
+			maxY = max(maxY, row + 1);
+		}
+	}
+
+	boundingBox = Rect(minX, minY, maxX - minX, maxY - minY);
+
+	return componentAreas[largestComponent];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// findRoot()
+//
+// Returns the label that represents the set the specified label belongs to,
+// halving the path to it along the way.
+//////////////////////////////////////////////////////////////////////////////////
+int ComponentLabeler::findRoot(vector<int>& parents, int label)
+{
+	while (parents[label] != label)
+	{
+		parents[label] = parents[parents[label]];
+		label = parents[label];
+	}
+
+	return label;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// unite()
+//
+// Joins the sets of the two labels. The lower label becomes the root, so a
+// component is always represented by the first label it was given.
+//////////////////////////////////////////////////////////////////////////////////
+void ComponentLabeler::unite(vector<int>& parents, const int first, const int second)
+{
+	const int firstRoot = findRoot(parents, first);
+	const int secondRoot = findRoot(parents, second);
+
+	if (firstRoot < secondRoot)
+		parents[secondRoot] = firstRoot;
+	else if (secondRoot < firstRoot)
+		parents[firstRoot] = secondRoot;
+}
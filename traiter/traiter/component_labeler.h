@@ -0,0 +1,27 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace segment
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// ComponentLabeler
+	//
+	// Labels the 8-connected components of a binary image. The first scan labels
+	// each run of white pixels and joins it to the runs it touches in the row
+	// above with a union-find; the second scan keeps only the runs whose label
+	// belongs to the largest component. No contours are traced, so specks cost no
+	// more than the runs they are made of.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ComponentLabeler final
+	{
+	public:
+		static long long extractLargestComponent(const cv::Mat& image, cv::Mat& componentMask, cv::Rect& boundingBox);
+
+		static int findRoot(std::vector<int>& parents, int label);
+		static void unite(std::vector<int>& parents, const int first, const int second);
+	private:
+		ComponentLabeler();
+	};
+}
@@ -1,5 +1,10 @@
 #include "general_utilities.h"
 #include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#endif
 #include <algorithm>
 
 using namespace std;
@@ -15,3 +20,32 @@ bool GeneralUtilities::fileExists(const string& fileName)
 	struct stat buffer;
 	return stat(fileName.c_str(), &buffer) == 0;
 }
+
+//////////////////////////////////////////////////////////////////////////////////
+// isDirectory()
+//
+// Returns true if the specified path exists and is a directory, false
+// otherwise.
+//////////////////////////////////////////////////////////////////////////////////
+bool GeneralUtilities::isDirectory(const string& path)
+{
+	struct stat buffer;
+	return stat(path.c_str(), &buffer) == 0 && (buffer.st_mode & S_IFMT) == S_IFDIR;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// createDirectory()
+//
+// Creates the specified directory. Its parent must already exist. Returns true
+// if the directory was created or already existed, false otherwise.
+//////////////////////////////////////////////////////////////////////////////////
+bool GeneralUtilities::createDirectory(const string& path)
+{
+#if defined(_WIN32)
+	const int status = _mkdir(path.c_str());
+#else
+	const int status = mkdir(path.c_str(), 0777);
+#endif
+
+	return status == 0 || isDirectory(path);
+}
@@ -18,6 +18,8 @@ namespace utility
 		// File utilities
 
 		static bool fileExists(const std::string& fileName);
+		static bool isDirectory(const std::string& path);
+		static bool createDirectory(const std::string& path);
 
 		// Math utilities
 
@@ -0,0 +1,62 @@
+#include "image_analyzer.h"
+#include "general_utilities.h"
+#include "image_strip_source.h"
+#include "mapped_image.h"
+#include "root_system.h"
+#include "root_system_statistics.h"
+#include "strip_pipeline.h"
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+using namespace std;
+using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// AnalysisOptions::AnalysisOptions()
+//
+// Constructor that sets every option to its default. Every trait is computed.
+//////////////////////////////////////////////////////////////////////////////////
+AnalysisOptions::AnalysisOptions()
+	: threshMethod(THRESH), skeletonMethod(MEDIAL_AXIS_TRANSFORM), stripRows(0), traits(TraitTable::getTraits())
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// analyze()
+//
+// Builds the root system of the image at the specified path. Streamed images
+// only keep their statistics, so the image and skeleton of the returned root
+// system are empty. Returns null and sets error if the image could not be read.
+//////////////////////////////////////////////////////////////////////////////////
+unique_ptr<RootSystem> ImageAnalyzer::analyze(const string& imagePath, const AnalysisOptions& options, string& error)
+{
+	if (!GeneralUtilities::fileExists(imagePath))
+	{
+		error = "file does not exist";
+		return nullptr;
+	}
+
+	if (options.stripRows > 0)
+	{
+		unique_ptr<ImageStripSource> source = ImageStripSource::open(imagePath, error);
+
+		if (!source)
+			return nullptr;
+
+		RootSystemStatistics statistics;
+
+		if (!StripPipeline::computeStatistics(*source, static_cast<int>(options.stripRows), options.threshMethod, options.thresholdParameters, statistics, error))
+			return nullptr;
+
+		return unique_ptr<RootSystem>(new RootSystem(statistics));
+	}
+
+	MappedImage mapping;	// Keeps the pixels of a mapped image valid while the root system is built.
+	Mat originalImage = MappedImage::load(imagePath, mapping, error);
+
+	if (originalImage.empty())
+		return nullptr;
+
+	return unique_ptr<RootSystem>(new RootSystem(originalImage, options.skeletonMethod, options.threshMethod, options.thresholdParameters, options.traits));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "skeleton_method.h"
+#include "thresh_method.h"
+#include "thresholder.h"
+#include "trait_table.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	class RootSystem;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// AnalysisOptions
+	//
+	// How the root system in each image is found and measured.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct AnalysisOptions
+	{
+		AnalysisOptions();
+
+		ThreshMethod threshMethod;
+		segment::ThresholdParameters thresholdParameters;
+		SkeletonMethod skeletonMethod;
+		unsigned int stripRows;	// Images are streamed in strips of this many rows, or loaded whole if zero.
+		std::vector<TraitDescriptor> traits;	// The traits to compute, in output order.
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ImageAnalyzer
+	//
+	// Builds the root system of an image file, either by loading the whole image or
+	// by streaming it through the StripPipeline.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ImageAnalyzer final
+	{
+	public:
+		static std::unique_ptr<RootSystem> analyze(const std::string& imagePath, const AnalysisOptions& options, std::string& error);
+	private:
+		ImageAnalyzer();
+	};
+}
@@ -0,0 +1,173 @@
+#include "image_strip_source.h"
+#include "pgm_header.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <algorithm>
+#include <cctype>
+
+using namespace cv;
+using namespace std;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// ImageStripSource::~ImageStripSource()
+//
+// Destructor.
+//////////////////////////////////////////////////////////////////////////////////
+ImageStripSource::~ImageStripSource()
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// open()
+//
+// Opens the image at the specified path for streaming. PGM files with a maximum
+// value of 255 are streamed from disk; every other image, including any other
+// PGM file, is decoded in full and served from memory. Returns null and sets
+// error if the image could not be opened.
+//////////////////////////////////////////////////////////////////////////////////
+unique_ptr<ImageStripSource> ImageStripSource::open(const string& path, string& error)
+{
+	string extension = path.substr(min(path.find_last_of('.'), path.size()));
+	transform(extension.begin(), extension.end(), extension.begin(), [](const char character) { return static_cast<char>(tolower(static_cast<unsigned char>(character))); });
+
+	if (extension == ".pgm")
+	{
+		unique_ptr<PgmStripSource> source(new PgmStripSource());
+		string streamingError;
+
+		if (source->open(path, streamingError))
+			return unique_ptr<ImageStripSource>(source.release());
+	}
+
+	Mat image = imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+
+	if (image.empty())
+	{
+		error = "could not read image";
+		return nullptr;
+	}
+
+	return unique_ptr<ImageStripSource>(new MatStripSource(image));
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// PgmStripSource::PgmStripSource()
+//
+// Constructs a source with no file open.
+//////////////////////////////////////////////////////////////////////////////////
+PgmStripSource::PgmStripSource()
+	: _pixelOffset(0), _rows(0), _cols(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// PgmStripSource::open()
+//
+// Opens a binary (P5) PGM file and reads its header. Only files with a maximum
+// value of 255 are supported.
+//////////////////////////////////////////////////////////////////////////////////
+bool PgmStripSource::open(const string& path, string& error)
+{
+	_file.open(path.c_str(), ios::in | ios::binary);
+
+	if (!_file)
+	{
+		error = "could not open image";
+		return false;
+	}
+
+	PgmHeader header;
+
+	if (!header.read([this]() -> int { return _file.get(); }, error))
+		return false;
+
+	_rows = header.rows();
+	_cols = header.cols();
+	_pixelOffset = static_cast<streamoff>(header.pixelOffset());
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rows()
+//
+// Returns the number of rows in the image.
+//////////////////////////////////////////////////////////////////////////////////
+int PgmStripSource::rows() const
+{
+	return _rows;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// cols()
+//
+// Returns the number of columns in the image.
+//////////////////////////////////////////////////////////////////////////////////
+int PgmStripSource::cols() const
+{
+	return _cols;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// readRows()
+//
+// Reads rowCount rows starting at firstRow into a CV_8UC1 strip. Returns false
+// if the file ends early.
+//////////////////////////////////////////////////////////////////////////////////
+bool PgmStripSource::readRows(const int firstRow, const int rowCount, Mat& strip)
+{
+	strip.create(rowCount, _cols, CV_8UC1);
+
+	_file.clear();
+	_file.seekg(_pixelOffset + static_cast<streamoff>(firstRow) * _cols);
+
+	for (int row = 0; row < rowCount; ++row)
+	{
+		if (!_file.read(reinterpret_cast<char*>(strip.ptr<uchar>(row)), _cols))
+			return false;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// MatStripSource::MatStripSource()
+//
+// Constructor to specify the image to serve strips of.
+//////////////////////////////////////////////////////////////////////////////////
+MatStripSource::MatStripSource(const Mat& image)
+	: _image(image)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rows()
+//
+// Returns the number of rows in the image.
+//////////////////////////////////////////////////////////////////////////////////
+int MatStripSource::rows() const
+{
+	return _image.rows;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// cols()
+//
+// Returns the number of columns in the image.
+//////////////////////////////////////////////////////////////////////////////////
+int MatStripSource::cols() const
+{
+	return _image.cols;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// readRows()
+//
+// Returns a view of rowCount rows starting at firstRow. No pixels are copied.
+//////////////////////////////////////////////////////////////////////////////////
+bool MatStripSource::readRows(const int firstRow, const int rowCount, Mat& strip)
+{
+	strip = _image.rowRange(firstRow, firstRow + rowCount);
+
+	return true;
+}
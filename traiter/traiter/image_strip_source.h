@@ -0,0 +1,74 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// ImageStripSource
+	//
+	// A grayscale image that is read a strip of rows at a time, from top to bottom,
+	// so that images larger than memory can be analyzed.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ImageStripSource
+	{
+	public:
+		virtual ~ImageStripSource();
+
+		virtual int rows() const = 0;
+		virtual int cols() const = 0;
+
+		virtual bool readRows(const int firstRow, const int rowCount, cv::Mat& strip) = 0;
+
+		static std::unique_ptr<ImageStripSource> open(const std::string& path, std::string& error);
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// PgmStripSource
+	//
+	// Reads strips straight from a binary PGM file with a maximum value of 255,
+	// without ever holding more than one strip in memory.
+	//////////////////////////////////////////////////////////////////////////////////
+	class PgmStripSource final : public ImageStripSource
+	{
+	public:
+		PgmStripSource();
+
+		bool open(const std::string& path, std::string& error);
+
+		int rows() const override;
+		int cols() const override;
+
+		bool readRows(const int firstRow, const int rowCount, cv::Mat& strip) override;
+	private:
+		std::ifstream _file;
+		std::streamoff _pixelOffset;
+		int _rows;
+		int _cols;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// MatStripSource
+	//
+	// Serves strips of an image that is already in memory. Used for formats that
+	// can only be decoded as a whole, so that every image goes through the same
+	// streaming pipeline.
+	//////////////////////////////////////////////////////////////////////////////////
+	class MatStripSource final : public ImageStripSource
+	{
+	public:
+		explicit MatStripSource(const cv::Mat& image);
+
+		int rows() const override;
+		int cols() const override;
+
+		bool readRows(const int firstRow, const int rowCount, cv::Mat& strip) override;
+	private:
+		MatStripSource();
+
+		cv::Mat _image;
+	};
+}
@@ -0,0 +1,452 @@
+#include "mapped_image.h"
+#include "pgm_header.h"
+#include "profiler.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <vector>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace cv;
+using namespace std;
+using namespace traiter;
+
+namespace
+{
+	// TIFF tags and field types that an uncompressed grayscale image is described with.
+	const int TIFF_IMAGE_WIDTH = 256;
+	const int TIFF_IMAGE_LENGTH = 257;
+	const int TIFF_BITS_PER_SAMPLE = 258;
+	const int TIFF_COMPRESSION = 259;
+	const int TIFF_PHOTOMETRIC_INTERPRETATION = 262;
+	const int TIFF_STRIP_OFFSETS = 273;
+	const int TIFF_SAMPLES_PER_PIXEL = 277;
+	const int TIFF_ROWS_PER_STRIP = 278;
+	const int TIFF_STRIP_BYTE_COUNTS = 279;
+	const int TIFF_TILE_WIDTH = 322;
+	const int TIFF_SAMPLE_FORMAT = 339;
+
+	const int TIFF_SHORT = 3;
+	const int TIFF_LONG = 4;
+
+	const uint32_t TIFF_NO_COMPRESSION = 1;
+	const uint32_t TIFF_BLACK_IS_ZERO = 1;
+	const uint32_t TIFF_UNSIGNED_INTEGER = 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// MappedImage::MappedImage()
+//
+// Constructs an image with no file mapped.
+//////////////////////////////////////////////////////////////////////////////////
+MappedImage::MappedImage()
+	: _data(nullptr), _size(0),
+#if defined(_WIN32)
+	_file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+#else
+	_file(-1)
+#endif
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// MappedImage::~MappedImage()
+//
+// Unmaps the file, if one is mapped.
+//////////////////////////////////////////////////////////////////////////////////
+MappedImage::~MappedImage()
+{
+	close();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// open()
+//
+// Maps the binary 8-bit PGM or uncompressed 8-bit grayscale TIFF file at the
+// specified path. A TIFF file must store its rows contiguously and with black as
+// zero, since the pixels are never rearranged. Returns false and sets error if
+// the file cannot be mapped as an image, and the file is then left unmapped.
+//////////////////////////////////////////////////////////////////////////////////
+bool MappedImage::open(const string& path, string& error)
+{
+	TRAITER_PROFILE_SCOPE("MappedImage::open");
+
+	close();
+
+	if (!mapFile(path, error))
+		return false;
+
+	size_t pixelOffset = 0;
+	int rows = 0;
+	int cols = 0;
+	bool parsed = false;
+
+	if (_size >= 2 && _data[0] == 'P' && _data[1] == '5')
+		parsed = parsePgmHeader(pixelOffset, rows, cols, error);
+	else if (_size >= 4 && ((_data[0] == 'I' && _data[1] == 'I' && _data[2] == 42 && _data[3] == 0) || (_data[0] == 'M' && _data[1] == 'M' && _data[2] == 0 && _data[3] == 42)))
+		parsed = parseTiffHeader(pixelOffset, rows, cols, error);
+	else
+		error = "not a binary PGM or TIFF image";
+
+	if (parsed && (pixelOffset > _size || static_cast<size_t>(rows) * cols > _size - pixelOffset))
+	{
+		error = "image is truncated";
+		parsed = false;
+	}
+
+	if (!parsed)
+	{
+		close();
+		return false;
+	}
+
+	// The mapping is read-only, and nothing writes to an image that is being analyzed.
+	_image = Mat(rows, cols, CV_8UC1, const_cast<uchar*>(_data + pixelOffset));
+
+	TRAITER_PROFILE_COUNT("bytes_mapped", _size);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// close()
+//
+// Unmaps the file. The image becomes empty.
+//////////////////////////////////////////////////////////////////////////////////
+void MappedImage::close()
+{
+	_image = Mat();
+
+#if defined(_WIN32)
+	if (_data)
+		UnmapViewOfFile(_data);
+
+	if (_mapping)
+		CloseHandle(_mapping);
+
+	if (_file != INVALID_HANDLE_VALUE)
+		CloseHandle(_file);
+
+	_mapping = nullptr;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_data)
+		munmap(const_cast<uchar*>(_data), _size);
+
+	if (_file >= 0)
+		::close(_file);
+
+	_file = -1;
+#endif
+
+	_data = nullptr;
+	_size = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getImage()
+//
+// Returns a CV_8UC1 header over the mapped pixels, or an empty image if no file
+// is mapped.
+//////////////////////////////////////////////////////////////////////////////////
+const Mat& MappedImage::getImage() const
+{
+	return _image;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// load()
+//
+// Returns the grayscale image at the specified path. Files that can be mapped
+// are mapped by the specified mapping, and the returned image must not outlive
+// it; every other file is decoded. Returns an empty image and sets error if the
+// file could not be read.
+//////////////////////////////////////////////////////////////////////////////////
+Mat MappedImage::load(const string& path, MappedImage& mapping, string& error)
+{
+	string mappingError;
+
+	if (mapping.open(path, mappingError))
+		return mapping.getImage();
+
+	Mat image = imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+
+	if (image.empty())
+		error = "could not read image";
+
+	return image;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// mapFile()
+//
+// Maps the whole file read-only. Returns false and sets error if it could not be
+// mapped.
+//////////////////////////////////////////////////////////////////////////////////
+bool MappedImage::mapFile(const string& path, string& error)
+{
+#if defined(_WIN32)
+	_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	LARGE_INTEGER fileSize;
+
+	if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		error = "could not open image";
+		return false;
+	}
+
+	_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	_data = _mapping ? static_cast<const uchar*>(MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+	if (!_data)
+	{
+		error = "could not map image";
+		return false;
+	}
+
+	_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	_file = ::open(path.c_str(), O_RDONLY);
+
+	struct stat status;
+
+	if (_file < 0 || fstat(_file, &status) != 0 || status.st_size == 0)
+	{
+		error = "could not open image";
+		return false;
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, _file, 0);
+
+	if (data == MAP_FAILED)
+	{
+		error = "could not map image";
+		return false;
+	}
+
+	_data = static_cast<const uchar*>(data);
+	_size = static_cast<size_t>(status.st_size);
+#endif
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parsePgmHeader()
+//
+// Reads the size of a binary PGM image and where its pixels start. Only files
+// with a maximum value of 255 are supported, because their samples can be used
+// as they are; load() decodes any other PGM file, which rescales its samples.
+//////////////////////////////////////////////////////////////////////////////////
+bool MappedImage::parsePgmHeader(size_t& pixelOffset, int& rows, int& cols, string& error) const
+{
+	size_t position = 0;
+	PgmHeader header;
+
+	if (!header.read([this, &position]() -> int { return position < _size ? _data[position++] : EOF; }, error))
+		return false;
+
+	pixelOffset = header.pixelOffset();
+	rows = header.rows();
+	cols = header.cols();
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// parseTiffHeader()
+//
+// Reads the size of the first image of a TIFF file and where its pixels start.
+// It must be an uncompressed, unsigned 8-bit, single channel image with black as
+// zero, stored in strips that follow each other without gaps.
+//////////////////////////////////////////////////////////////////////////////////
+bool MappedImage::parseTiffHeader(size_t& pixelOffset, int& rows, int& cols, string& error) const
+{
+	const bool bigEndian = _data[0] == 'M';
+
+	if (_size < 8)
+	{
+		error = "not a TIFF image";
+		return false;
+	}
+
+	const size_t directoryOffset = readUnsigned(4, 4, bigEndian);
+
+	if (directoryOffset + 2 > _size)
+	{
+		error = "not a TIFF image";
+		return false;
+	}
+
+	const int entryCount = static_cast<int>(readUnsigned(directoryOffset, 2, bigEndian));
+
+	if (directoryOffset + 2 + static_cast<size_t>(entryCount) * 12 > _size)
+	{
+		error = "not a TIFF image";
+		return false;
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t bitsPerSample = 1;
+	uint32_t compression = TIFF_NO_COMPRESSION;
+	uint32_t photometricInterpretation = TIFF_BLACK_IS_ZERO;
+	uint32_t samplesPerPixel = 1;
+	uint32_t rowsPerStrip = UINT32_MAX;
+	uint32_t sampleFormat = TIFF_UNSIGNED_INTEGER;
+	bool tiled = false;
+	vector<uint32_t> stripOffsets;
+	vector<uint32_t> stripByteCounts;
+
+	for (int entry = 0; entry < entryCount; ++entry)
+	{
+		const size_t entryOffset = directoryOffset + 2 + entry * 12;
+		const int tag = static_cast<int>(readUnsigned(entryOffset, 2, bigEndian));
+		const int type = static_cast<int>(readUnsigned(entryOffset + 2, 2, bigEndian));
+		const uint32_t count = readUnsigned(entryOffset + 4, 4, bigEndian);
+
+		if (type != TIFF_SHORT && type != TIFF_LONG)
+		{
+			if (tag == TIFF_TILE_WIDTH)
+				tiled = true;
+
+			continue;	// None of the tags read here have other types.
+		}
+
+		const size_t valueSize = type == TIFF_SHORT ? 2 : 4;
+
+		// Values that fit in four bytes are stored in the entry itself.
+		size_t valuesOffset = entryOffset + 8;
+
+		if (count * valueSize > 4)
+			valuesOffset = readUnsigned(entryOffset + 8, 4, bigEndian);
+
+		if (count == 0 || valuesOffset + count * valueSize > _size)
+		{
+			error = "TIFF image is truncated";
+			return false;
+		}
+
+		const uint32_t value = readTiffValue(valuesOffset, type, bigEndian);
+
+		switch (tag)
+		{
+		case TIFF_IMAGE_WIDTH:
+			width = value;
+			break;
+		case TIFF_IMAGE_LENGTH:
+			height = value;
+			break;
+		case TIFF_BITS_PER_SAMPLE:
+			bitsPerSample = value;
+			break;
+		case TIFF_COMPRESSION:
+			compression = value;
+			break;
+		case TIFF_PHOTOMETRIC_INTERPRETATION:
+			photometricInterpretation = value;
+			break;
+		case TIFF_SAMPLES_PER_PIXEL:
+			samplesPerPixel = value;
+			break;
+		case TIFF_ROWS_PER_STRIP:
+			rowsPerStrip = value;
+			break;
+		case TIFF_SAMPLE_FORMAT:
+			sampleFormat = value;
+			break;
+		case TIFF_TILE_WIDTH:
+			tiled = true;
+			break;
+		case TIFF_STRIP_OFFSETS:
+		case TIFF_STRIP_BYTE_COUNTS:
+			{
+				vector<uint32_t>& values = tag == TIFF_STRIP_OFFSETS ? stripOffsets : stripByteCounts;
+				values.resize(count);
+
+				for (uint32_t index = 0; index < count; ++index)
+					values[index] = readTiffValue(valuesOffset + index * valueSize, type, bigEndian);
+			}
+			break;
+		}
+	}
+
+	if (width == 0 || height == 0 || width > INT_MAX || height > INT_MAX || stripOffsets.empty() || stripOffsets.size() != stripByteCounts.size())
+	{
+		error = "not a TIFF image";
+		return false;
+	}
+
+	if (bitsPerSample != 8 || samplesPerPixel != 1 || sampleFormat != TIFF_UNSIGNED_INTEGER || photometricInterpretation != TIFF_BLACK_IS_ZERO)
+	{
+		error = "only 8-bit grayscale TIFF images can be mapped";
+		return false;
+	}
+
+	if (compression != TIFF_NO_COMPRESSION || tiled)
+	{
+		error = "only uncompressed TIFF images stored in strips can be mapped";
+		return false;
+	}
+
+	// The rows can only be used where they lie if every strip starts where the one before it ended.
+	const size_t rowsInStrip = min<size_t>(rowsPerStrip, height);
+
+	for (size_t strip = 0; strip < stripOffsets.size(); ++strip)
+	{
+		const size_t expectedOffset = static_cast<size_t>(stripOffsets[0]) + strip * rowsInStrip * width;
+
+		if (stripOffsets[strip] != expectedOffset)
+		{
+			error = "only TIFF images whose strips are contiguous can be mapped";
+			return false;
+		}
+	}
+
+	pixelOffset = stripOffsets[0];
+	rows = static_cast<int>(height);
+	cols = static_cast<int>(width);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// readTiffValue()
+//
+// Reads a SHORT or LONG value of a TIFF field.
+//////////////////////////////////////////////////////////////////////////////////
+uint32_t MappedImage::readTiffValue(const size_t offset, const int type, const bool bigEndian) const
+{
+	return readUnsigned(offset, type == TIFF_SHORT ? 2 : 4, bigEndian);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// readUnsigned()
+//
+// Reads an unsigned integer of the specified number of bytes, in the byte order
+// of the file. The caller has checked that it lies within the file.
+//////////////////////////////////////////////////////////////////////////////////
+uint32_t MappedImage::readUnsigned(const size_t offset, const int bytes, const bool bigEndian) const
+{
+	uint32_t value = 0;
+
+	for (int byte = 0; byte < bytes; ++byte)
+	{
+		const uint32_t part = _data[offset + byte];
+		value |= part << (8 * (bigEndian ? bytes - 1 - byte : byte));
+	}
+
+	return value;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// MappedImage
+	//
+	// An 8-bit grayscale image file that is mapped into memory rather than read,
+	// for the binary PGM and uncompressed TIFF files that scanners write. The image
+	// is a header over the mapped pixels, so nothing is decoded or copied, and
+	// pages are only read from disk as the analysis first touches them.
+	//
+	// The pixels are read-only, and the image is only valid while the file stays
+	// mapped.
+	//////////////////////////////////////////////////////////////////////////////////
+	class MappedImage final
+	{
+	public:
+		MappedImage();
+		~MappedImage();
+
+		bool open(const std::string& path, std::string& error);
+		void close();
+
+		const cv::Mat& getImage() const;
+
+		static cv::Mat load(const std::string& path, MappedImage& mapping, std::string& error);
+	private:
+		MappedImage(const MappedImage&);
+		MappedImage& operator=(const MappedImage&);
+
+		bool mapFile(const std::string& path, std::string& error);
+		bool parsePgmHeader(size_t& pixelOffset, int& rows, int& cols, std::string& error) const;
+		bool parseTiffHeader(size_t& pixelOffset, int& rows, int& cols, std::string& error) const;
+
+		uint32_t readTiffValue(const size_t offset, const int type, const bool bigEndian) const;
+		uint32_t readUnsigned(const size_t offset, const int bytes, const bool bigEndian) const;
+
+		const uchar* _data;
+		size_t _size;
+
+#if defined(_WIN32)
+		void* _file;
+		void* _mapping;
+#else
+		int _file;
+#endif
+
+		cv::Mat _image;
+	};
+}
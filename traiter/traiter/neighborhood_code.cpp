@@ -0,0 +1,261 @@
+#include "neighborhood_code.h"
+#include "direction.h"
+#include "parallel_for.h"
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#define TRAITER_USE_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRAITER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+using namespace cv;
+using namespace std;
+using namespace morph;
+using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeNeighborhoodCodes()
+//
+// Computes the neighborhood code of every pixel of a CV_8UC1 mask holding 0 and
+// 255, and returns the codes as a CV_8UC1 image of the same size. Neighbors
+// outside of the image are treated as white if outsideIsWhite is set, and black
+// otherwise.
+//
+// Each row is copied once into a padded buffer, so that the kernel can read the
+// left and right neighbors of every pixel without any bounds checks. Bands of
+// rows are coded in parallel.
+//////////////////////////////////////////////////////////////////////////////////
+Mat NeighborhoodCode::computeNeighborhoodCodes(const Mat& mask, const bool outsideIsWhite)
+{
+	const int width = mask.cols;
+	const int height = mask.rows;
+	const uchar outsideValue = outsideIsWhite ? 255 : 0;
+
+	Mat codes = Mat(mask.size(), CV_8UC1);
+
+	if (width == 0 || height == 0)
+		return codes;
+
+	ParallelFor::run(height, ParallelFor::computeBandSize(width), [&](const int firstRow, const int endRow)
+	{
+		// Three padded rows are kept: above, current and below. The one outside of the image at the top and bottom is all outsideValue.
+		const int paddedWidth = width + 2;
+		vector<uchar> paddedRows(3 * paddedWidth, outsideValue);
+		uchar* above = &paddedRows[0];
+		uchar* current = &paddedRows[paddedWidth];
+		uchar* below = &paddedRows[2 * paddedWidth];
+
+		if (firstRow > 0)
+			memcpy(above + 1, mask.ptr<uchar>(firstRow - 1), width);
+
+		memcpy(current + 1, mask.ptr<uchar>(firstRow), width);
+
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			if (row < height - 1)
+				memcpy(below + 1, mask.ptr<uchar>(row + 1), width);
+			else
+				memset(below, outsideValue, paddedWidth);
+
+			computeRowCodes(above, current, below, codes.ptr<uchar>(row), width);
+
+			// Rotate the buffers so that the current row becomes the row above. Only the interior is ever overwritten, so the padding survives.
+			uchar* recycled = above;
+			above = current;
+			current = below;
+			below = recycled;
+		}
+	});
+
+	return codes;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// countBorderPixels()
+//
+// Returns the number of white pixels in the mask whose neighborhood code is not
+// 0xFF, meaning they have at least one neighbor that is not white. Bands of rows
+// are counted in parallel.
+//////////////////////////////////////////////////////////////////////////////////
+long long NeighborhoodCode::countBorderPixels(const Mat& mask, const Mat& codes)
+{
+	vector<long long> borderPixelsInRows(mask.rows, 0);
+
+	ParallelFor::run(mask.rows, ParallelFor::computeBandSize(mask.cols), [&](const int firstRow, const int endRow)
+	{
+		for (int row = firstRow; row < endRow; ++row)
+			borderPixelsInRows[row] = countBorderPixelsInRow(mask.ptr<uchar>(row), codes.ptr<uchar>(row), mask.cols);
+	});
+
+	long long borderPixels = 0;
+
+	for (const long long borderPixelsInRow : borderPixelsInRows)
+		borderPixels += borderPixelsInRow;
+
+	return borderPixels;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// countNeighbors()
+//
+// Returns the number of white neighbors described by the code.
+//////////////////////////////////////////////////////////////////////////////////
+int NeighborhoodCode::countNeighbors(const uchar code)
+{
+	int neighbors = 0;
+
+	for (int bits = code; bits != 0; bits &= bits - 1)
+		neighbors++;
+
+	return neighbors;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// countTransitions()
+//
+// Returns the number of black to white transitions when walking clockwise
+// around the neighborhood. This is the number of separate branches that touch
+// the pixel.
+//////////////////////////////////////////////////////////////////////////////////
+int NeighborhoodCode::countTransitions(const uchar code)
+{
+	int transitions = 0;
+
+	for (int direction = NORTH; direction <= NORTHWEST; ++direction)
+	{
+		if (!((code >> direction) & 1) && ((code >> ((direction + 1) % 8)) & 1))
+			transitions++;
+	}
+
+	return transitions;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// isEndpoint()
+//
+// Returns true if a skeleton pixel with this code is the tip of a branch.
+//////////////////////////////////////////////////////////////////////////////////
+bool NeighborhoodCode::isEndpoint(const uchar code)
+{
+	return countNeighbors(code) == 1 || (countNeighbors(code) == 2 && countTransitions(code) == 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// isJunction()
+//
+// Returns true if a skeleton pixel with this code joins three or more branches.
+//////////////////////////////////////////////////////////////////////////////////
+bool NeighborhoodCode::isJunction(const uchar code)
+{
+	return countTransitions(code) >= 3;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeRowCodes()
+//
+// Computes the codes of one row from the padded rows above, at and below it.
+// Index i + 1 of a padded row holds pixel i. Since white pixels are 255, masking
+// a neighbor with the bit of its direction yields either that bit or zero.
+//////////////////////////////////////////////////////////////////////////////////
+void NeighborhoodCode::computeRowCodes(const uchar* above, const uchar* current, const uchar* below, uchar* codes, const int width)
+{
+	int col = 0;
+
+#if defined(TRAITER_USE_AVX2)
+	for (; col + 32 <= width; col += 32)
+	{
+		#define TRAITER_LOAD_256(row, offset, direction) _mm256_and_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>((row) + col + (offset))), _mm256_set1_epi8(static_cast<char>(1 << (direction))))
+
+		__m256i code = TRAITER_LOAD_256(above, 1, NORTH);
+		code = _mm256_or_si256(code, TRAITER_LOAD_256(above, 2, NORTHEAST));
+		code = _mm256_or_si256(code, TRAITER_LOAD_256(current, 2, EAST));
+		code = _mm256_or_si256(code, TRAITER_LOAD_256(below, 2, SOUTHEAST));
+		code = _mm256_or_si256(code, TRAITER_LOAD_256(below, 1, SOUTH));
+		code = _mm256_or_si256(code, TRAITER_LOAD_256(below, 0, SOUTHWEST));
+		code = _mm256_or_si256(code, TRAITER_LOAD_256(current, 0, WEST));
+		code = _mm256_or_si256(code, TRAITER_LOAD_256(above, 0, NORTHWEST));
+
+		#undef TRAITER_LOAD_256
+
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(codes + col), code);
+	}
+#endif
+
+#if defined(TRAITER_USE_SSE2)
+	for (; col + 16 <= width; col += 16)
+	{
+		#define TRAITER_LOAD_128(row, offset, direction) _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>((row) + col + (offset))), _mm_set1_epi8(static_cast<char>(1 << (direction))))
+
+		__m128i code = TRAITER_LOAD_128(above, 1, NORTH);
+		code = _mm_or_si128(code, TRAITER_LOAD_128(above, 2, NORTHEAST));
+		code = _mm_or_si128(code, TRAITER_LOAD_128(current, 2, EAST));
+		code = _mm_or_si128(code, TRAITER_LOAD_128(below, 2, SOUTHEAST));
+		code = _mm_or_si128(code, TRAITER_LOAD_128(below, 1, SOUTH));
+		code = _mm_or_si128(code, TRAITER_LOAD_128(below, 0, SOUTHWEST));
+		code = _mm_or_si128(code, TRAITER_LOAD_128(current, 0, WEST));
+		code = _mm_or_si128(code, TRAITER_LOAD_128(above, 0, NORTHWEST));
+
+		#undef TRAITER_LOAD_128
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(codes + col), code);
+	}
+#endif
+
+	for (; col < width; ++col)
+	{
+		codes[col] = static_cast<uchar>(
+			(above[col + 1] & (1 << NORTH)) |
+			(above[col + 2] & (1 << NORTHEAST)) |
+			(current[col + 2] & (1 << EAST)) |
+			(below[col + 2] & (1 << SOUTHEAST)) |
+			(below[col + 1] & (1 << SOUTH)) |
+			(below[col] & (1 << SOUTHWEST)) |
+			(current[col] & (1 << WEST)) |
+			(above[col] & (1 << NORTHWEST)));
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// countBorderPixelsInRow()
+//
+// Returns the number of border pixels in one row of a mask and its codes.
+//////////////////////////////////////////////////////////////////////////////////
+long long NeighborhoodCode::countBorderPixelsInRow(const uchar* maskRow, const uchar* codeRow, const int width)
+{
+	long long borderPixels = 0;
+	int col = 0;
+
+#if defined(TRAITER_USE_SSE2)
+	const __m128i allSet = _mm_set1_epi8(static_cast<char>(0xFF));
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; col + 16 <= width; col += 16)
+	{
+		const __m128i maskBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(maskRow + col));
+		const __m128i codeBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codeRow + col));
+
+		// A border pixel is white (mask != 0) and not surrounded (code != 0xFF).
+		const __m128i isWhite = _mm_xor_si128(_mm_cmpeq_epi8(maskBytes, zero), allSet);
+		const __m128i isSurrounded = _mm_cmpeq_epi8(codeBytes, allSet);
+		const int borderBits = _mm_movemask_epi8(_mm_andnot_si128(isSurrounded, isWhite));
+
+		for (int bits = borderBits; bits != 0; bits &= bits - 1)
+			borderPixels++;
+	}
+#endif
+
+	for (; col < width; ++col)
+	{
+		if (maskRow[col] != 0 && codeRow[col] != 0xFF)
+			borderPixels++;
+	}
+
+	return borderPixels;
+}
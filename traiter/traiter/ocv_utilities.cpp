@@ -1,58 +1,61 @@
 #include "ocv_utilities.h"
+#include "component_labeler.h"
 #include "direction.h"
+#include "profiler.h"
+#include "workspace.h"
 
 using namespace std;
 using namespace cv;
+using namespace segment;
 using namespace traiter;
 using namespace utility;
 
 //////////////////////////////////////////////////////////////////////////////////
 // keepOnlyLargestContour()
 //
-// Remove all contours that are not the largest contour from the specified image.
-// Returns the contour that was found.
+// Remove everything but the largest 8-connected component from the specified
+// image, in place, keeping its holes. Returns the outer contour of that
+// component, or an empty contour if the image has no white pixels.
+//
+// The component is found by labeling rather than by tracing every contour, so
+// only the one contour that is kept is ever traced, and only within the bounding
+// box of its component.
 //////////////////////////////////////////////////////////////////////////////////
 vector<Point> OcvUtilities::keepOnlyLargestContour(Mat& originalImage)
 {
-	Mat largestContourImage;
-	padImage(originalImage, largestContourImage);	// If we don't pad, then findContours will not mark the edge as part of the contour.
-
-	vector<vector<Point>> contours;
-	vector<Vec4i> hierarchy;
-	findContours(largestContourImage, contours, hierarchy, CV_RETR_CCOMP, CV_CHAIN_APPROX_NONE);
-
-	int largestContourIndex = getLargestContourIndex(contours);
+	TRAITER_PROFILE_SCOPE("OcvUtilities::keepOnlyLargestContour");
 
-	originalImage = originalImage.zeros(originalImage.size(), CV_8UC1);	// Clear the existing image before drawing the largest contour back onto it.
-	largestContourImage = largestContourImage.zeros(largestContourImage.size(), CV_8UC1);
+	Rect boundingBox;
 
-	drawContours(largestContourImage, contours, largestContourIndex, Scalar(255), CV_FILLED, 8, hierarchy);	//TODO: Instead of 255, use maximumThresholdValue
+	if (ComponentLabeler::extractLargestComponent(originalImage, originalImage, boundingBox) == 0)
+		return vector<Point>();	// The image is already entirely black.
 
-	removePadding(largestContourImage, originalImage);
-
-	return contours[largestContourIndex];
+	return traceOuterContour(originalImage, boundingBox);
 }
 
 //////////////////////////////////////////////////////////////////////////////////
-// getLargestContourIndex()
+// traceOuterContour()
 //
-// Find the largest contour in the list of contours and return its index.
+// Returns the outer contour of the single component in the specified image,
+// which lies within the specified bounding box, or an empty contour if the box
+// is empty.
 //////////////////////////////////////////////////////////////////////////////////
-int OcvUtilities::getLargestContourIndex(const vector<vector<Point>>& contours)
+vector<Point> OcvUtilities::traceOuterContour(const Mat& componentImage, const Rect& boundingBox)
 {
-	int largestContourIndex = 0;
-	double largestContourArea = 0;
-	for (int i = 0; i < contours.size(); i++)
-	{
-		double currentContourArea = contourArea(contours[i]);
-		if (currentContourArea > largestContourArea)
-		{
-			largestContourArea = currentContourArea;
-			largestContourIndex = i;
-		}
-	}
+	TRAITER_PROFILE_SCOPE("OcvUtilities::traceOuterContour");
+
+	if (boundingBox.area() == 0)
+		return vector<Point>();
+
+	Mat boundingBoxImage = Workspace::borrow("OcvUtilities::boundingBoxImage", Size(boundingBox.width + 2, boundingBox.height + 2), CV_8UC1);
+	padImage(componentImage(boundingBox), boundingBoxImage);	// If we don't pad, then findContours will not mark the edge as part of the contour.
+
+	vector<vector<Point>> contours;
+	findContours(boundingBoxImage, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE, Point(boundingBox.x - 1, boundingBox.y - 1));
+
+	TRAITER_PROFILE_COUNT("contours_found", contours.size());
 
-	return largestContourIndex;
+	return contours.empty() ? vector<Point>() : contours[0];	// A single component only has one outer contour.
 }
 
 //////////////////////////////////////////////////////////////////////////////////
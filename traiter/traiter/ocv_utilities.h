@@ -18,7 +18,7 @@ namespace utility
 	{
 	public:
 		static std::vector<cv::Point> keepOnlyLargestContour(cv::Mat& originalImage);
-		static int getLargestContourIndex(const std::vector<std::vector<cv::Point>>& contours);
+		static std::vector<cv::Point> traceOuterContour(const cv::Mat& componentImage, const cv::Rect& boundingBox);
 
 		static bool isPointInImage(const cv::Mat& image, const cv::Point& point);
 		static bool isPointWhite(const cv::Mat& image, const cv::Point& point);
@@ -0,0 +1,18 @@
+#pragma once
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// OutputFormat
+	//
+	// Represents the machine-readable format that trait results are written in.
+	//////////////////////////////////////////////////////////////////////////////////
+	enum OutputFormat
+	{
+		// One comma separated row per image, preceded by a header row
+		CSV_OUTPUT,
+
+		// An array containing one object per image
+		JSON_OUTPUT
+	};
+}
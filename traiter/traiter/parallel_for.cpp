@@ -0,0 +1,329 @@
+#include "parallel_for.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace utility;
+
+TRAITER_THREAD_LOCAL unsigned int ParallelFor::_threadLimit = 0;
+
+namespace
+{
+	// Bands smaller than this cost more to hand to another thread than to process.
+	const int MINIMUM_BAND_PIXELS = 1 << 16;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// BandQueue
+	//
+	// The bands a thread has yet to process, as a range packed into one word so that
+	// the owner can take from the front and thieves from the back without a lock.
+	// The padding keeps the queues of different threads on different cache lines.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct BandQueue
+	{
+		atomic<uint64_t> range;	// The first band in the high half, and one past the last in the low half.
+		char padding[64 - sizeof(atomic<uint64_t>)];
+	};
+
+	uint64_t packRange(const uint32_t first, const uint32_t last)
+	{
+		return (static_cast<uint64_t>(first) << 32) | last;
+	}
+
+	// Takes the first band of the queue. Returns false if the queue is empty.
+	bool popFront(BandQueue& queue, int& band)
+	{
+		uint64_t range = queue.range.load();
+
+		while (true)
+		{
+			const uint32_t first = static_cast<uint32_t>(range >> 32);
+			const uint32_t last = static_cast<uint32_t>(range);
+
+			if (first >= last)
+				return false;
+
+			if (queue.range.compare_exchange_weak(range, packRange(first + 1, last)))
+			{
+				band = static_cast<int>(first);
+				return true;
+			}
+		}
+	}
+
+	// Takes the last band of the queue. Returns false if the queue is empty.
+	bool popBack(BandQueue& queue, int& band)
+	{
+		uint64_t range = queue.range.load();
+
+		while (true)
+		{
+			const uint32_t first = static_cast<uint32_t>(range >> 32);
+			const uint32_t last = static_cast<uint32_t>(range);
+
+			if (first >= last)
+				return false;
+
+			if (queue.range.compare_exchange_weak(range, packRange(first, last - 1)))
+			{
+				band = static_cast<int>(last - 1);
+				return true;
+			}
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ThreadPool
+	//
+	// Threads that are started once and then wait for loops, so that a loop does not
+	// pay for starting and joining a thread per core every time it runs. Threads are
+	// added as loops ask for more of them, and are never stopped.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ThreadPool final
+	{
+	public:
+		ThreadPool();
+
+		void run(const int workerCount, const function<void(const int worker)>& work);
+	private:
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator=(const ThreadPool&);
+
+		void serve(const int worker);
+
+		vector<thread> _threads;
+		mutex _mutex;
+		condition_variable _loopStarted;
+		condition_variable _loopFinished;
+		const function<void(const int worker)>* _work;
+		int _workerCount;
+		int _workersRunning;
+		uint64_t _loop;	// Counts the loops started, so that each thread joins every loop once.
+	};
+
+	// Lets one loop at a time use the pool. A loop that finds it busy runs on the
+	// thread that started it, since every core is already busy.
+	mutex poolMutex;
+
+	// Created by the first loop that needs it, and deliberately never destroyed, so
+	// that no thread has to be joined while the process exits.
+	ThreadPool* pool = nullptr;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ThreadPool::ThreadPool()
+	//
+	// Constructs a pool with no threads.
+	//////////////////////////////////////////////////////////////////////////////////
+	ThreadPool::ThreadPool()
+		: _work(nullptr), _workerCount(0), _workersRunning(0), _loop(0)
+	{
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ThreadPool::run()
+	//
+	// Calls work with every worker index in [0, workerCount), worker 0 on the calling
+	// thread and the others on the pool, and returns once they have all returned.
+	// work must not throw.
+	//////////////////////////////////////////////////////////////////////////////////
+	void ThreadPool::run(const int workerCount, const function<void(const int worker)>& work)
+	{
+		{
+			lock_guard<mutex> lock(_mutex);
+
+			while (static_cast<int>(_threads.size()) < workerCount - 1)
+				_threads.push_back(thread(&ThreadPool::serve, this, static_cast<int>(_threads.size()) + 1));
+
+			_work = &work;
+			_workerCount = workerCount;
+			_workersRunning = workerCount - 1;
+			++_loop;
+		}
+
+		_loopStarted.notify_all();
+
+		work(0);
+
+		unique_lock<mutex> lock(_mutex);
+
+		while (_workersRunning > 0)
+			_loopFinished.wait(lock);
+
+		_work = nullptr;
+	}
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ThreadPool::serve()
+	//
+	// Runs the share of every loop that falls to the specified worker, on a thread
+	// of the pool. Workers beyond those a loop asks for sit it out.
+	//////////////////////////////////////////////////////////////////////////////////
+	void ThreadPool::serve(const int worker)
+	{
+		unique_lock<mutex> lock(_mutex);
+		uint64_t loop = _loop - 1;	// The loop that started this thread still needs it.
+
+		while (true)
+		{
+			while (_loop == loop)
+				_loopStarted.wait(lock);
+
+			loop = _loop;
+
+			if (worker >= _workerCount)
+				continue;
+
+			const function<void(const int worker)>& work = *_work;
+
+			lock.unlock();
+			work(worker);
+			lock.lock();
+
+			if (--_workersRunning == 0)
+				_loopFinished.notify_one();
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// run()
+//
+// Calls body once for every band of bandSize items in [0, count), with the band
+// as a half-open range, and returns once every band is done. The calling thread
+// processes bands too, alongside the threads of a pool that is kept from one
+// loop to the next. If a body throws on another thread, the bands left on that
+// thread still run, and the exception is rethrown on the calling thread at the
+// end.
+//////////////////////////////////////////////////////////////////////////////////
+void ParallelFor::run(const int count, const int bandSize, const function<void(const int begin, const int end)>& body)
+{
+	if (count <= 0)
+		return;
+
+	const int bandCount = (count + bandSize - 1) / bandSize;
+	const int workerCount = static_cast<int>(min<unsigned int>(threadCount(), static_cast<unsigned int>(bandCount)));
+
+	auto runBand = [&](const int band) { body(band * bandSize, min((band + 1) * bandSize, count)); };
+
+	if (workerCount <= 1)
+	{
+		for (int band = 0; band < bandCount; ++band)
+			runBand(band);
+
+		return;
+	}
+
+	unique_ptr<BandQueue[]> queues(new BandQueue[workerCount]);
+
+	for (int worker = 0; worker < workerCount; ++worker)
+	{
+		const uint32_t first = static_cast<uint32_t>(static_cast<long long>(bandCount) * worker / workerCount);
+		const uint32_t last = static_cast<uint32_t>(static_cast<long long>(bandCount) * (worker + 1) / workerCount);
+		queues[worker].range.store(packRange(first, last));
+	}
+
+	vector<exception_ptr> exceptions(workerCount);
+
+	auto work = [&](const int worker)
+	{
+		ParallelScope parallelScope(1);	// Loops started by a body run serially, since every core is already busy.
+
+		auto runBandSafely = [&](const int band)
+		{
+			try
+			{
+				runBand(band);
+			}
+			catch (...)
+			{
+				if (!exceptions[worker])
+					exceptions[worker] = current_exception();
+			}
+		};
+
+		int band;
+
+		while (popFront(queues[worker], band))
+			runBandSafely(band);
+
+		// Steal from the back of the other queues, where their owners will get to last.
+		for (int offset = 1; offset < workerCount; ++offset)
+		{
+			BandQueue& victim = queues[(worker + offset) % workerCount];
+
+			while (popBack(victim, band))
+				runBandSafely(band);
+		}
+	};
+
+	unique_lock<mutex> poolLock(poolMutex, try_to_lock);
+
+	if (poolLock.owns_lock())
+	{
+		if (pool == nullptr)
+			pool = new ThreadPool();
+
+		pool->run(workerCount, work);
+	}
+	else
+		work(0);	// Worker 0 steals every band of the others, so the loop runs on this thread alone.
+
+	for (const exception_ptr& exception : exceptions)
+	{
+		if (exception)
+			rethrow_exception(exception);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeBandSize()
+//
+// Returns how many rows (or columns) of the specified length make a band that is
+// worth handing to another thread.
+//////////////////////////////////////////////////////////////////////////////////
+int ParallelFor::computeBandSize(const int length)
+{
+	return max(1, MINIMUM_BAND_PIXELS / max(length, 1));
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// threadCount()
+//
+// Returns how many threads a loop started on the current thread may use.
+//////////////////////////////////////////////////////////////////////////////////
+unsigned int ParallelFor::threadCount()
+{
+	if (_threadLimit != 0)
+		return _threadLimit;
+
+	return max(thread::hardware_concurrency(), 1u);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// ParallelScope::ParallelScope()
+//
+// Constructor to specify the most threads that loops started on the current
+// thread may use.
+//////////////////////////////////////////////////////////////////////////////////
+ParallelScope::ParallelScope(const unsigned int threadLimit)
+	: _previous(ParallelFor::_threadLimit)
+{
+	ParallelFor::_threadLimit = threadLimit;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// ParallelScope::~ParallelScope()
+//
+// Restores the limit that was in place before this scope.
+//////////////////////////////////////////////////////////////////////////////////
+ParallelScope::~ParallelScope()
+{
+	ParallelFor::_threadLimit = _previous;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "profiler.h"
+#include <functional>
+
+namespace utility
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// ParallelFor
+	//
+	// Runs a loop over rows (or columns) on every core. The range is cut into bands
+	// whose boundaries depend only on the range and the band size, never on the
+	// number of threads, and each thread starts on its own share of the bands and
+	// steals from the others once it runs out, so that a dense part of the image
+	// does not leave the other threads idle.
+	//
+	// A body must only write to the rows of its own band. Anything that is summed
+	// over the image is stored per row (or per band) and added up in order once the
+	// loop is done, so the result is bit-identical however many threads ran it.
+	//
+	// The bodies of a loop run on the calling thread and on the threads of a pool
+	// that is kept for the life of the process. Those threads have no workspace or
+	// profile, so a body must not rely on either, and any loop a body starts runs
+	// serially. While one loop has the pool, a loop started on another thread runs
+	// on that thread alone.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ParallelFor final
+	{
+	public:
+		static void run(const int count, const int bandSize, const std::function<void(const int begin, const int end)>& body);
+
+		static int computeBandSize(const int length);
+		static unsigned int threadCount();
+	private:
+		friend class ParallelScope;
+
+		static TRAITER_THREAD_LOCAL unsigned int _threadLimit;	// Zero uses one thread per core.
+
+		ParallelFor();
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ParallelScope
+	//
+	// Limits the loops started on the current thread to the specified number of
+	// threads for the lifetime of the scope, and restores the previous limit
+	// afterward. A limit of one runs them serially, and zero uses every core.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ParallelScope final
+	{
+	public:
+		explicit ParallelScope(const unsigned int threadLimit);
+		~ParallelScope();
+	private:
+		ParallelScope();
+		ParallelScope(const ParallelScope&);
+		ParallelScope& operator=(const ParallelScope&);
+
+		unsigned int _previous;
+	};
+}
@@ -0,0 +1,135 @@
+#include "pgm_header.h"
+#include <cctype>
+#include <climits>
+#include <cstdio>
+
+using namespace std;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// PgmHeader()
+//
+// Constructs an empty header.
+//////////////////////////////////////////////////////////////////////////////////
+PgmHeader::PgmHeader()
+	: _rows(0), _cols(0), _pixelOffset(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// read()
+//
+// Reads the header from the start of the file, one byte per call to nextByte,
+// which returns EOF at the end of the file. Returns false and sets error if it is
+// not a binary PGM header, if a value does not fit in an int, or if the maximum
+// value is not 255.
+//////////////////////////////////////////////////////////////////////////////////
+bool PgmHeader::read(const function<int()>& nextByte, string& error)
+{
+	size_t position = 0;
+
+	// Counts the bytes read, so that the pixels are known to follow the last one.
+	auto next = [&nextByte, &position]() -> int
+	{
+		const int character = nextByte();
+
+		if (character != EOF)
+			++position;
+
+		return character;
+	};
+
+	int character = next();
+
+	if (character != 'P' || next() != '5')
+	{
+		error = "not a binary PGM image";
+		return false;
+	}
+
+	character = next();
+
+	// Reads the next number, skipping whitespace and comments. The character after
+	// it is read too and left in character.
+	auto readValue = [&next, &character](int& value) -> bool
+	{
+		while (character != EOF && (isspace(character) || character == '#'))
+		{
+			if (character == '#')	// Comments run to the end of the line.
+			{
+				while (character != EOF && character != '\n')
+					character = next();
+			}
+
+			if (character != EOF)
+				character = next();
+		}
+
+		if (character == EOF || !isdigit(character))
+			return false;
+
+		value = 0;
+
+		while (character != EOF && isdigit(character))
+		{
+			const int digit = character - '0';
+
+			if (value > (INT_MAX - digit) / 10)
+				return false;	// Too large to be a dimension.
+
+			value = value * 10 + digit;
+			character = next();
+		}
+
+		return true;
+	};
+
+	int maximumValue = 0;
+
+	// A single whitespace character separates the header from the pixels.
+	if (!readValue(_cols) || !readValue(_rows) || !readValue(maximumValue) || character == EOF || !isspace(character) || _rows <= 0 || _cols <= 0)
+	{
+		error = "not a binary PGM image";
+		return false;
+	}
+
+	if (maximumValue != 255)
+	{
+		error = "only PGM images with a maximum value of 255 are supported";
+		return false;
+	}
+
+	_pixelOffset = position;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rows()
+//
+// Returns the number of rows in the image.
+//////////////////////////////////////////////////////////////////////////////////
+int PgmHeader::rows() const
+{
+	return _rows;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// cols()
+//
+// Returns the number of columns in the image.
+//////////////////////////////////////////////////////////////////////////////////
+int PgmHeader::cols() const
+{
+	return _cols;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// pixelOffset()
+//
+// Returns the offset of the first pixel from the start of the file.
+//////////////////////////////////////////////////////////////////////////////////
+size_t PgmHeader::pixelOffset() const
+{
+	return _pixelOffset;
+}
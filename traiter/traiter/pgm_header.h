@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// PgmHeader
+	//
+	// The header of a binary (P5) PGM file: the size of the image and the offset of
+	// its first pixel. It is read a byte at a time, so that a mapped file and a file
+	// that is streamed from disk are parsed the same way.
+	//
+	// Only files with a maximum value of 255 are accepted, because their samples
+	// can be thresholded as they are; any other file must be decoded, which
+	// rescales its samples.
+	//////////////////////////////////////////////////////////////////////////////////
+	class PgmHeader final
+	{
+	public:
+		PgmHeader();
+
+		bool read(const std::function<int()>& nextByte, std::string& error);
+
+		int rows() const;
+		int cols() const;
+		size_t pixelOffset() const;
+	private:
+		int _rows;
+		int _cols;
+		size_t _pixelOffset;
+	};
+}
@@ -0,0 +1,116 @@
+#include "profiler.h"
+
+using namespace cv;
+using namespace std;
+using namespace utility;
+
+TRAITER_THREAD_LOCAL Profile* Profile::_current = nullptr;
+
+//////////////////////////////////////////////////////////////////////////////////
+// TimerStatistics::TimerStatistics()
+//
+// Constructs a timer that has never run.
+//////////////////////////////////////////////////////////////////////////////////
+TimerStatistics::TimerStatistics()
+	: seconds(0), calls(0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// addTime()
+//
+// Adds one call of the specified duration to the named timer.
+//////////////////////////////////////////////////////////////////////////////////
+void Profile::addTime(const char* name, const double seconds)
+{
+	TimerStatistics& timer = _timers[name];
+	timer.seconds += seconds;
+	++timer.calls;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// addCount()
+//
+// Adds the specified amount to the named counter.
+//////////////////////////////////////////////////////////////////////////////////
+void Profile::addCount(const char* name, const long long count)
+{
+	_counters[name] += count;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// timers()
+//
+// Returns the timers recorded so far, by name.
+//////////////////////////////////////////////////////////////////////////////////
+const map<string, TimerStatistics>& Profile::timers() const
+{
+	return _timers;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// counters()
+//
+// Returns the counters recorded so far, by name.
+//////////////////////////////////////////////////////////////////////////////////
+const map<string, long long>& Profile::counters() const
+{
+	return _counters;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// current()
+//
+// Returns the profile installed on the current thread, or null if there is
+// none.
+//////////////////////////////////////////////////////////////////////////////////
+Profile* Profile::current()
+{
+	return _current;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// ProfileScope::ProfileScope()
+//
+// Constructor to specify the profile to install on the current thread. A null
+// profile turns profiling off for the scope.
+//////////////////////////////////////////////////////////////////////////////////
+ProfileScope::ProfileScope(Profile* profile)
+	: _previous(Profile::_current)
+{
+	Profile::_current = profile;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// ProfileScope::~ProfileScope()
+//
+// Restores the profile that was installed before this scope.
+//////////////////////////////////////////////////////////////////////////////////
+ProfileScope::~ProfileScope()
+{
+	Profile::_current = _previous;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// ScopedTimer::ScopedTimer()
+//
+// Constructor to specify the name of the timer. The clock is only read if a
+// profile is installed.
+//////////////////////////////////////////////////////////////////////////////////
+ScopedTimer::ScopedTimer(const char* name)
+	: _profile(Profile::current()), _name(name), _start(0)
+{
+	if (_profile)
+		_start = getTickCount();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// ScopedTimer::~ScopedTimer()
+//
+// Adds the elapsed time to the timer.
+//////////////////////////////////////////////////////////////////////////////////
+ScopedTimer::~ScopedTimer()
+{
+	if (_profile)
+		_profile->addTime(_name, (getTickCount() - _start) / getTickFrequency());
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <map>
+#include <string>
+
+// Profiling can be compiled out entirely by defining TRAITER_DISABLE_PROFILING.
+// Otherwise, timers and counters only do work on threads that have a Profile
+// installed, and cost a single thread-local read everywhere else.
+#if defined(_MSC_VER)
+#define TRAITER_THREAD_LOCAL __declspec(thread)
+#else
+#define TRAITER_THREAD_LOCAL __thread
+#endif
+
+#define TRAITER_PROFILE_CONCATENATE_INNER(first, second) first##second
+#define TRAITER_PROFILE_CONCATENATE(first, second) TRAITER_PROFILE_CONCATENATE_INNER(first, second)
+
+#if defined(TRAITER_DISABLE_PROFILING)
+#define TRAITER_PROFILE_SCOPE(name)
+#define TRAITER_PROFILE_COUNT(name, count)
+#else
+#define TRAITER_PROFILE_SCOPE(name) utility::ScopedTimer TRAITER_PROFILE_CONCATENATE(scopedTimer, __LINE__)(name)
+#define TRAITER_PROFILE_COUNT(name, count) do { if (utility::Profile* currentProfile = utility::Profile::current()) currentProfile->addCount(name, static_cast<long long>(count)); } while (false)
+#endif
+
+namespace utility
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// TimerStatistics
+	//
+	// The total time spent in a timed scope, and how many times it was entered.
+	// Nested scopes are included in the time of the scopes that contain them.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct TimerStatistics
+	{
+		TimerStatistics();
+
+		double seconds;
+		long long calls;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// Profile
+	//
+	// The timers and counters recorded while a root system was computed. A profile
+	// records everything that happens on the thread it is installed on with a
+	// ProfileScope.
+	//////////////////////////////////////////////////////////////////////////////////
+	class Profile final
+	{
+	public:
+		void addTime(const char* name, const double seconds);
+		void addCount(const char* name, const long long count);
+
+		const std::map<std::string, TimerStatistics>& timers() const;
+		const std::map<std::string, long long>& counters() const;
+
+		static Profile* current();
+	private:
+		friend class ProfileScope;
+
+		std::map<std::string, TimerStatistics> _timers;
+		std::map<std::string, long long> _counters;
+
+		static TRAITER_THREAD_LOCAL Profile* _current;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ProfileScope
+	//
+	// Installs a profile on the current thread for the lifetime of the scope, and
+	// restores the previous one afterward.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ProfileScope final
+	{
+	public:
+		explicit ProfileScope(Profile* profile);
+		~ProfileScope();
+	private:
+		ProfileScope();
+		ProfileScope(const ProfileScope&);
+		ProfileScope& operator=(const ProfileScope&);
+
+		Profile* _previous;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ScopedTimer
+	//
+	// Adds the time between its construction and destruction to the named timer of
+	// the current profile. Use TRAITER_PROFILE_SCOPE rather than constructing one
+	// directly, so that it can be compiled out.
+	//////////////////////////////////////////////////////////////////////////////////
+	class ScopedTimer final
+	{
+	public:
+		explicit ScopedTimer(const char* name);
+		~ScopedTimer();
+	private:
+		ScopedTimer();
+		ScopedTimer(const ScopedTimer&);
+		ScopedTimer& operator=(const ScopedTimer&);
+
+		Profile* _profile;
+		const char* _name;
+		int64 _start;
+	};
+}
@@ -0,0 +1,285 @@
+#include "quick_look.h"
+#include "profiler.h"
+#include "root_system.h"
+#include "thresh_method.h"
+#include "thresholder.h"
+#include "trait_table.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace cv;
+using namespace std;
+using namespace segment;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// QuickLook::QuickLook()
+//
+// Constructor to specify the image, how to analyze it, and the pyramid level to
+// analyze it at. Level 0 is the full resolution image. The level after the
+// requested one is analyzed as well, for the error bounds.
+//////////////////////////////////////////////////////////////////////////////////
+QuickLook::QuickLook(const Mat& image, const AnalysisOptions& analysisOptions, const int level)
+	: _image(image), _analysisOptions(analysisOptions)
+{
+	TRAITER_PROFILE_SCOPE("QuickLook::QuickLook");
+
+	Mat levelImage = image;
+
+	for (int reduction = 0; reduction < level; ++reduction)
+		pyrDown(levelImage, levelImage);
+
+	Mat coarserImage;
+	pyrDown(levelImage, coarserImage);
+
+	const int scale = 1 << level;
+	Rect coarserRegion;
+
+	_statistics = analyzeLevel(levelImage, analysisOptions, scale, image.size(), _region);
+	const RootSystemStatistics coarserStatistics = analyzeLevel(coarserImage, analysisOptions, 2 * scale, image.size(), coarserRegion);
+
+	const vector<double> traits = computeTraits(_statistics);
+	const vector<double> coarserTraits = computeTraits(coarserStatistics);
+
+	_errorBounds.resize(traits.size());
+
+	for (size_t trait = 0; trait < traits.size(); ++trait)
+		_errorBounds[trait] = fabs(traits[trait] - coarserTraits[trait]);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getRootSystem()
+//
+// Returns a root system holding the approximate statistics, in full resolution
+// units. Only its traits are available.
+//////////////////////////////////////////////////////////////////////////////////
+unique_ptr<RootSystem> QuickLook::getRootSystem() const
+{
+	return unique_ptr<RootSystem>(new RootSystem(_statistics));
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getErrorBounds()
+//
+// Returns the estimated error of every selected trait, in the order of the
+// traits of the analysis options and in the units of the trait.
+//////////////////////////////////////////////////////////////////////////////////
+const vector<double>& QuickLook::getErrorBounds() const
+{
+	return _errorBounds;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getRegion()
+//
+// Returns the part of the full resolution image that refine() starts from. It
+// runs from the top of the image to below the network, and spans the network's
+// width, with a margin for the blur of the pyramid and the threshold windows. It
+// is empty if no network was found.
+//////////////////////////////////////////////////////////////////////////////////
+Rect QuickLook::getRegion() const
+{
+	return _region;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// refine()
+//
+// Analyzes the region of the full resolution image where the network was found,
+// and returns its root system. The traits match those of the whole image, as
+// long as the reduced level found the same component to be the largest.
+//
+// The region keeps the top of the image because the row traits are measured
+// from it. Roots too thin to survive the reduction can connect the network to
+// parts that were left outside of the region, so if the network reaches the
+// edge of the region, the whole image is analyzed instead. An automatic
+// threshold value is chosen from the whole image, not from the region.
+//////////////////////////////////////////////////////////////////////////////////
+unique_ptr<RootSystem> QuickLook::refine() const
+{
+	TRAITER_PROFILE_SCOPE("QuickLook::refine");
+
+	const ThresholdParameters thresholdParameters = _analysisOptions.threshMethod == ADAPTIVE_THRESH ? _analysisOptions.thresholdParameters : Thresholder::resolveThresholdValue(_image, _analysisOptions.thresholdParameters);
+
+	if (_region.area() > 0 && _region.area() < static_cast<int>(_image.total()))
+	{
+		unique_ptr<RootSystem> rootSystem = unique_ptr<RootSystem>(new RootSystem(_image(_region), _analysisOptions.skeletonMethod, _analysisOptions.threshMethod, thresholdParameters, _analysisOptions.traits));
+
+		// A local threshold near the edge of the region only sees part of its window, so the network has to stay clear of it.
+		const int clearance = (_analysisOptions.threshMethod != THRESH ? _analysisOptions.thresholdParameters.maximumHalfBlockSize() : 0) + 1;
+		const Rect boundingBox = computeBoundingBox(rootSystem->getPackedImage());
+
+		const bool reachesLeft = _region.x > 0 && boundingBox.x < clearance;
+		const bool reachesRight = _region.x + _region.width < _image.cols && boundingBox.x + boundingBox.width > _region.width - clearance;
+		const bool reachesBottom = _region.height < _image.rows && boundingBox.y + boundingBox.height > _region.height - clearance;
+
+		if (!reachesLeft && !reachesRight && !reachesBottom)
+			return rootSystem;
+
+		TRAITER_PROFILE_COUNT("regions_abandoned", 1);
+	}
+
+	return unique_ptr<RootSystem>(new RootSystem(_image, _analysisOptions.skeletonMethod, _analysisOptions.threshMethod, thresholdParameters, _analysisOptions.traits));
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// analyzeLevel()
+//
+// Analyzes one level of the pyramid, whose pixels are scale full resolution
+// pixels wide, and returns its statistics in full resolution units. Only the
+// results that the selected traits depend on are built. The region that a
+// refinement would need is written to region.
+//////////////////////////////////////////////////////////////////////////////////
+RootSystemStatistics QuickLook::analyzeLevel(const Mat& levelImage, const AnalysisOptions& analysisOptions, const int scale, const Size fullSize, Rect& region)
+{
+	TRAITER_PROFILE_SCOPE("QuickLook::analyzeLevel");
+	TRAITER_PROFILE_COUNT("pixels_visited", levelImage.total());
+
+	RootSystem rootSystem(levelImage, analysisOptions.skeletonMethod, analysisOptions.threshMethod, rescale(analysisOptions.thresholdParameters, scale), analysisOptions.traits);
+	const Rect boundingBox = computeBoundingBox(rootSystem.getPackedImage());
+
+	if (boundingBox.area() == 0)
+	{
+		region = Rect();
+	}
+	else
+	{
+		// Each pyramid reduction blurs over a few pixels of the level below it, and a local threshold looks half a window further.
+		int margin = 2 * scale;
+
+		if (analysisOptions.threshMethod != THRESH)
+			margin += analysisOptions.thresholdParameters.maximumHalfBlockSize();
+
+		const int left = max(boundingBox.x * scale - margin, 0);
+		const int right = min((boundingBox.x + boundingBox.width) * scale + margin, fullSize.width);
+		const int bottom = min((boundingBox.y + boundingBox.height) * scale + margin, fullSize.height);
+
+		region = Rect(left, 0, right - left, bottom);
+	}
+
+	return rescale(rootSystem.getStatistics(), scale, fullSize);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rescale()
+//
+// Converts statistics measured on a level whose pixels are scale full
+// resolution pixels wide into full resolution units. Counts of pixels along a
+// line grow with the scale and counts over an area with its square. Each row of
+// the level stands for scale full resolution rows, which get its number of roots
+// and an equal share of its area.
+//////////////////////////////////////////////////////////////////////////////////
+RootSystemStatistics QuickLook::rescale(const RootSystemStatistics& statistics, const int scale, const Size fullSize)
+{
+	RootSystemStatistics rescaled = statistics;
+
+	const double lengthScale = scale;
+	const double areaScale = lengthScale * scale;
+
+	rescaled.numberOfRootsInRows.assign(fullSize.height, 0);
+	rescaled.networkAreaInRows.assign(fullSize.height, 0);
+
+	for (int row = 0; row < fullSize.height && !statistics.numberOfRootsInRows.empty(); ++row)
+	{
+		const size_t levelRow = min(static_cast<size_t>(row / scale), statistics.numberOfRootsInRows.size() - 1);
+
+		rescaled.numberOfRootsInRows[row] = statistics.numberOfRootsInRows[levelRow];
+		rescaled.networkAreaInRows[row] = statistics.networkAreaInRows[levelRow] * scale;
+	}
+
+	rescaled.networkArea = statistics.networkArea * areaScale;
+	rescaled.perimeter = statistics.perimeter * lengthScale;
+
+	// The length of the skeleton and its radii both grow with the scale.
+	rescaled.networkLength = statistics.networkLength * lengthScale;
+	rescaled.skeletonRadiusSum = statistics.skeletonRadiusSum * areaScale;
+	rescaled.skeletonSquaredRadiusSum = statistics.skeletonSquaredRadiusSum * areaScale * lengthScale;
+
+	if (statistics.numberOfBranches >= 0)
+	{
+		rescaled.medianBranchLength = statistics.medianBranchLength >= 0 ? statistics.medianBranchLength * lengthScale : -1;
+		rescaled.averageBranchLength = statistics.averageBranchLength >= 0 ? statistics.averageBranchLength * lengthScale : -1;
+		rescaled.weightedNetworkLength = statistics.weightedNetworkLength * lengthScale;
+	}
+
+	if (statistics.networkDepth >= 0)
+	{
+		rescaled.networkDepth = statistics.networkDepth * scale;
+		rescaled.networkWidth = statistics.networkWidth * scale;
+	}
+
+	rescaled.convexArea = statistics.convexArea * areaScale;
+	rescaled.bestFittingEllipse.center = Point2f(statistics.bestFittingEllipse.center.x * scale, statistics.bestFittingEllipse.center.y * scale);
+	rescaled.bestFittingEllipse.size = Size2f(statistics.bestFittingEllipse.size.width * scale, statistics.bestFittingEllipse.size.height * scale);
+
+	return rescaled;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rescale()
+//
+// Shrinks the threshold windows to cover the same part of the image at a level
+// whose pixels are scale full resolution pixels wide. Windows stay odd and at
+// least three pixels wide.
+//////////////////////////////////////////////////////////////////////////////////
+ThresholdParameters QuickLook::rescale(const ThresholdParameters& parameters, const int scale)
+{
+	auto rescaleBlockSize = [scale](const int blockSize) { return max(3, (blockSize / scale) | 1); };
+
+	ThresholdParameters rescaled = parameters;
+	rescaled.blockSize = rescaleBlockSize(parameters.blockSize);
+	rescaled.contrastBlockSize = rescaleBlockSize(parameters.contrastBlockSize);
+
+	return rescaled;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeBoundingBox()
+//
+// Returns the smallest rectangle holding every white pixel of the mask, or an
+// empty rectangle if there are none.
+//////////////////////////////////////////////////////////////////////////////////
+Rect QuickLook::computeBoundingBox(const BitMask& mask)
+{
+	int top = -1;
+	int bottom = -1;
+	int left = mask.cols();
+	int right = -1;
+
+	for (int row = 0; row < mask.rows(); ++row)
+	{
+		const int firstColumn = mask.firstColumn(row);
+
+		if (firstColumn < 0)
+			continue;
+
+		if (top < 0)
+			top = row;
+
+		bottom = row;
+		left = min(left, firstColumn);
+		right = max(right, mask.lastColumn(row));
+	}
+
+	if (top < 0)
+		return Rect();
+
+	return Rect(left, top, right - left + 1, bottom - top + 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeTraits()
+//
+// Returns the selected traits of the statistics, in output order.
+//////////////////////////////////////////////////////////////////////////////////
+vector<double> QuickLook::computeTraits(const RootSystemStatistics& statistics) const
+{
+	RootSystem rootSystem(statistics);
+	vector<double> traits;
+
+	for (const TraitDescriptor& trait : _analysisOptions.traits)
+		traits.push_back(rootSystem.computeTrait(trait));
+
+	return traits;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "bit_mask.h"
+#include "image_analyzer.h"
+#include "root_system_statistics.h"
+#include <opencv2/core/core.hpp>
+#include <memory>
+#include <vector>
+
+namespace traiter
+{
+	class RootSystem;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// QuickLook
+	//
+	// Computes approximate traits of an image from a reduced level of its Gaussian
+	// pyramid, where level n has 1/4^n of the pixels. The statistics of that level
+	// are rescaled to full resolution units, so the traits can be read and written
+	// like any others.
+	//
+	// Each trait comes with an estimated error bound: the amount it changes
+	// between this level and the next coarser one. Reducing the resolution roughly
+	// doubles the error, so that change is about the error of this level. Roots
+	// thinner than a pixel of the level can vanish altogether, which no bound
+	// accounts for.
+	//
+	// A quick look can be refined to full resolution, and only the region around
+	// the network found at the reduced level is then analyzed.
+	//////////////////////////////////////////////////////////////////////////////////
+	class QuickLook final
+	{
+	public:
+		QuickLook(const cv::Mat& image, const AnalysisOptions& analysisOptions, const int level);
+
+		std::unique_ptr<RootSystem> getRootSystem() const;
+		const std::vector<double>& getErrorBounds() const;
+		cv::Rect getRegion() const;
+
+		std::unique_ptr<RootSystem> refine() const;
+	private:
+		QuickLook();
+
+		static RootSystemStatistics analyzeLevel(const cv::Mat& levelImage, const AnalysisOptions& analysisOptions, const int scale, const cv::Size fullSize, cv::Rect& region);
+		static RootSystemStatistics rescale(const RootSystemStatistics& statistics, const int scale, const cv::Size fullSize);
+		static segment::ThresholdParameters rescale(const segment::ThresholdParameters& parameters, const int scale);
+		static cv::Rect computeBoundingBox(const BitMask& mask);
+		std::vector<double> computeTraits(const RootSystemStatistics& statistics) const;
+
+		cv::Mat _image;
+		AnalysisOptions _analysisOptions;
+
+		RootSystemStatistics _statistics;
+		std::vector<double> _errorBounds;	// In the order of AnalysisOptions::traits.
+		cv::Rect _region;	// Where the network was found, in full resolution pixels.
+	};
+}
@@ -1,10 +1,18 @@
 #include "root_system.h"
+#include "bit_mask.h"
+#include "component_labeler.h"
 #include "general_utilities.h"
+#include "neighborhood_code.h"
 #include "ocv_utilities.h"
+#include "parallel_for.h"
+#include "profiler.h"
+#include "skeleton_graph.h"
+#include "skeleton_method.h"
 #include "skeletonizer.h"
 #include "thresh_method.h"
 #include "thresholder.h"
 #include <opencv2/opencv.hpp>
+#include <climits>
 
 using namespace cv;
 using namespace std;
@@ -13,27 +21,135 @@ using namespace segment;
 using namespace traiter;
 using namespace utility;
 
+namespace
+{
+	// The results built from the unpacked mask, and from the radius map.
+	const int MASK_READERS = BORDER_DEPENDENCY | CONTOUR_DEPENDENCY | SKELETON_DEPENDENCY | RADIUS_MAP_DEPENDENCY | SKELETON_GRAPH_DEPENDENCY;
+	const int RADIUS_MAP_READERS = RADIUS_MAP_DEPENDENCY | SKELETON_GRAPH_DEPENDENCY;
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // RootSystem::RootSystem()
 //
-// Constructor to specify the image to compute the root system from.
+// Constructor to specify the image to compute the root system from, the methods
+// used to threshold it and compute its skeleton, and the traits that will be
+// asked for. Only the largest component of the thresholded image is found here.
+// Everything else a trait depends on is built the first time a trait that needs
+// it is computed, and then shared by every other trait, so traits that are never
+// asked for cost nothing.
+//
+// The unpacked mask and the radius map are released as soon as the selected
+// traits no longer need them. Asking for a trait that was not selected still
+// works, but may have to unpack the mask again.
 //////////////////////////////////////////////////////////////////////////////////
-RootSystem::RootSystem(Mat image)
+RootSystem::RootSystem(Mat image, const SkeletonMethod skeletonMethod, const ThreshMethod threshMethod, const ThresholdParameters& thresholdParameters, const vector<TraitDescriptor>& traits)
+	: _skeletonMethod(skeletonMethod), _builtDependencies(MASK_DEPENDENCY), _selectedDependencies(expandDependencies(TraitTable::collectDependencies(traits))), _medianNumberOfRoots(-1), _maximumNumberOfRoots(-1)
 {
-	_image = segment::Thresholder::threshold(image, THRESH);
-	_contour = OcvUtilities::keepOnlyLargestContour(_image);
-	//_skeleton = morph::Skeletonizer::computeMorphologicalSkeleton(_image);
-	_skeleton = morph::Skeletonizer::computeMedialAxisTransform(_image);
+	TRAITER_PROFILE_SCOPE("RootSystem::RootSystem");
+
+	_thresholdedImage = segment::Thresholder::threshold(image, threshMethod, thresholdParameters);
+	ComponentLabeler::extractLargestComponent(_thresholdedImage, _thresholdedImage, _boundingBox);
+
+	_image = BitMask(_thresholdedImage);
+
+	releaseUnneededResults();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootSystem::RootSystem()
+//
+// Constructor to specify statistics that were already gathered elsewhere, such
+// as by streaming an image that is too large to load. Only the traits are
+// available; the image and skeleton are left empty.
+//////////////////////////////////////////////////////////////////////////////////
+RootSystem::RootSystem(const RootSystemStatistics& statistics)
+	: _skeletonMethod(DISTANCE_TRANSFORM_SKELETON), _builtDependencies(ALL_DEPENDENCIES), _selectedDependencies(ALL_DEPENDENCIES), _statistics(statistics)
+{
+	computeRowStatistics();
 }
 
 //////////////////////////////////////////////////////////////////////////////////
 // RootSystem::getImage()
 //
-// Returns the image that we are operating on.
+// Returns the image that we are operating on, unpacked into a new image.
 //////////////////////////////////////////////////////////////////////////////////
 cv::Mat RootSystem::getImage()
 {
-	return _image.clone();
+	return _image.toMat();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootSystem::getSkeleton()
+//
+// Returns the skeleton of the root system, unpacked into a new image.
+//////////////////////////////////////////////////////////////////////////////////
+cv::Mat RootSystem::getSkeleton()
+{
+	require(SKELETON_DEPENDENCY);
+
+	return _skeleton.toMat();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootSystem::getPackedImage()
+//
+// Returns the image that we are operating on, without unpacking it.
+//////////////////////////////////////////////////////////////////////////////////
+const BitMask& RootSystem::getPackedImage() const
+{
+	return _image;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootSystem::getPackedSkeleton()
+//
+// Returns the skeleton of the root system, without unpacking it.
+//////////////////////////////////////////////////////////////////////////////////
+const BitMask& RootSystem::getPackedSkeleton()
+{
+	require(SKELETON_DEPENDENCY);
+
+	return _skeleton;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootSystem::getSkeletonGraph()
+//
+// Returns the graph of the tips, junctions and branches of the skeleton. The
+// graph is empty for a root system built from statistics.
+//////////////////////////////////////////////////////////////////////////////////
+const SkeletonGraph& RootSystem::getSkeletonGraph()
+{
+	require(SKELETON_GRAPH_DEPENDENCY);
+
+	return _skeletonGraph;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootSystem::getStatistics()
+//
+// Returns the raw measurements that the selected traits are derived from, which
+// are gathered first. Measurements that no selected trait reads are left at
+// their defaults.
+//////////////////////////////////////////////////////////////////////////////////
+const RootSystemStatistics& RootSystem::getStatistics()
+{
+	require(_selectedDependencies);
+
+	return _statistics;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeTrait()
+//
+// Builds the intermediate results the trait depends on, if they have not been
+// built yet, and returns the value of the trait.
+//////////////////////////////////////////////////////////////////////////////////
+double RootSystem::computeTrait(const TraitDescriptor& trait)
+{
+	require(trait.dependencies);
+
+	return (this->*trait.compute)();
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -45,9 +161,11 @@ cv::Mat RootSystem::getImage()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::bushiness()
 {
-	if (medianNumberOfRoots() != 0)
-		return maximumNumberOfRoots() / medianNumberOfRoots();
-		
+	TRAITER_PROFILE_SCOPE("RootSystem::bushiness");
+
+	if (_medianNumberOfRoots != 0)
+		return _maximumNumberOfRoots / _medianNumberOfRoots;
+
 	return -1;
 }
 
@@ -60,13 +178,9 @@ double RootSystem::bushiness()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::convexArea()
 {
-	vector<Point> hull;
-	convexHull(_contour, hull);
-
-	//TODO_ROBUST: Make a debugging flag to write out an image if the flag is turned on?
-	//drawContours(_image, vector<vector<Point>>(1, hull), 0, Scalar(255));	// drawContours expects a vector of vectors, so we need to construct the expected type from our largest hull contour.
+	TRAITER_PROFILE_SCOPE("RootSystem::convexArea");
 
-	return contourArea(hull);
+	return _statistics.convexArea;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -79,21 +193,9 @@ double RootSystem::convexArea()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkDepth()
 {
-	if (_contour.size() < 1)
-		return -1;
+	TRAITER_PROFILE_SCOPE("RootSystem::networkDepth");
 
-	int minY = _contour[0].y;
-	int maxY = _contour[0].y;
-
-	for each (auto point in _contour)
-	{
-		if (point.y > maxY)
-			maxY = point.y;
-		if (point.y < minY)
-			minY = point.y;
-	}
-
-	return maxY - minY;
+	return _statistics.networkDepth;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -106,32 +208,9 @@ double RootSystem::networkDepth()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkLengthDistribution()
 {
-	int lowerTwoThirdsStart = static_cast<int>(round(0.33 * networkDepth()));	//TODO: Network depth computation makes sense here only if the top of the image is where the network starts (true in current sample image case)
-
-	double lowerTwoThirdsArea = 0;
-
-	for (int row = lowerTwoThirdsStart; row <= networkDepth(); ++row)
-	{
-		for (int col = 0; col < _image.size().width; ++col)
-		{
-			if (OcvUtilities::isPointWhite(_image, Point(col, row)))
-			{
-				lowerTwoThirdsArea++;
-			}
-		}
-	}
+	TRAITER_PROFILE_SCOPE("RootSystem::networkLengthDistribution");
 
-	//TODO_ROBUST: Allow debugging image to be output.
-	//for (int col = 0; col < _image.size().width; ++col)
-	//{
-	//	_image.at<uchar>(Point(col, lowerTwoThirdsStart)) = 255;
-	//	imshow("Lower Two-Thirds Line", _image);
-	//}
-
-	if (networkArea() != 0)
-		return lowerTwoThirdsArea / networkArea();
-
-	return -1;
+	return computeNetworkLengthDistribution();
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -143,9 +222,9 @@ double RootSystem::networkLengthDistribution()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::majorAxis()
 {
-	RotatedRect bestFittingEllipse = fitEllipse(_contour);
+	TRAITER_PROFILE_SCOPE("RootSystem::majorAxis");
 
-	return round(max(bestFittingEllipse.size.width, bestFittingEllipse.size.height));
+	return round(max(_statistics.bestFittingEllipse.size.width, _statistics.bestFittingEllipse.size.height));
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -159,21 +238,9 @@ double RootSystem::majorAxis()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkWidth()
 {
-	if (_contour.size() < 1)
-		return -1;
-
-	int minX = _contour[0].x;
-	int maxX = _contour[0].x;
-
-	for each (auto point in _contour)
-	{
-		if (point.x > maxX)
-			maxX = point.x;
-		if (point.x < minX)
-			minX = point.x;
-	}
+	TRAITER_PROFILE_SCOPE("RootSystem::networkWidth");
 
-	return maxX - minX;	//TODO: Note that this does not assume that pixels are in the same row as specified in the comment above. We should confirm that this is the desired behavior.
+	return _statistics.networkWidth;	//TODO: Note that this does not assume that pixels are in the same row as specified in the comment above. We should confirm that this is the desired behavior.
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -187,15 +254,9 @@ double RootSystem::networkWidth()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::maximumNumberOfRoots()
 {
-	const double PERCENTILE = 0.84;
-
-	vector<int> numberOfRootsInRow = computeNumberOfRootsInRows();
-
-	sort(numberOfRootsInRow.begin(), numberOfRootsInRow.end());
+	TRAITER_PROFILE_SCOPE("RootSystem::maximumNumberOfRoots");
 
-	int maximumIndex = static_cast<int>(round(PERCENTILE * numberOfRootsInRow.size()));
-
-	return numberOfRootsInRow[maximumIndex];
+	return _maximumNumberOfRoots;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -209,7 +270,12 @@ double RootSystem::maximumNumberOfRoots()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::averageRootWidth()
 {
-	return 0;
+	TRAITER_PROFILE_SCOPE("RootSystem::averageRootWidth");
+
+	if (_statistics.networkLength == 0)
+		return -1;
+
+	return 2 * _statistics.skeletonRadiusSum / _statistics.networkLength;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -223,7 +289,9 @@ double RootSystem::averageRootWidth()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::medianNumberOfRoots()
 {
-	return GeneralUtilities::computeMedian(computeNumberOfRootsInRows());
+	TRAITER_PROFILE_SCOPE("RootSystem::medianNumberOfRoots");
+
+	return _medianNumberOfRoots;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -235,9 +303,9 @@ double RootSystem::medianNumberOfRoots()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::minorAxis()
 {
-	RotatedRect bestFittingEllipse = fitEllipse(_contour);
+	TRAITER_PROFILE_SCOPE("RootSystem::minorAxis");
 
-	return round(min(bestFittingEllipse.size.width, bestFittingEllipse.size.height));
+	return round(min(_statistics.bestFittingEllipse.size.width, _statistics.bestFittingEllipse.size.height));
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -249,7 +317,9 @@ double RootSystem::minorAxis()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkArea()
 {
-	return countNonZero(_image);
+	TRAITER_PROFILE_SCOPE("RootSystem::networkArea");
+
+	return _statistics.networkArea;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -262,33 +332,9 @@ double RootSystem::networkArea()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::perimeter()
 {
-	double perimeter = 0;
-
-	for (int row = 0; row < _image.size().height; ++row)
-	{
-		for (int col = 0; col < _image.size().width; ++col)
-		{
-			if (OcvUtilities::isPointWhite(_image, Point(col, row)))
-			{
-				vector<Point> neighbors = OcvUtilities::getNeighboringPixels(_image, Point(col, row));
-
-				bool allWhiteNeighbors = true;
-				
-				for (vector<Point>::iterator it = neighbors.begin(); it != neighbors.end(); ++it)
-				{
-					if (!OcvUtilities::isPointWhite(_image, *it))
-					{
-						allWhiteNeighbors = false;
-					}
-				}
+	TRAITER_PROFILE_SCOPE("RootSystem::perimeter");
 
-				if (!allWhiteNeighbors)
-					perimeter++;
-			}
-		}
-	}
-
-	return perimeter;
+	return _statistics.perimeter;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -300,6 +346,8 @@ double RootSystem::perimeter()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::aspectRatio()
 {
+	TRAITER_PROFILE_SCOPE("RootSystem::aspectRatio");
+
 	if (majorAxis() != 0)
 		return minorAxis() / majorAxis();
 
@@ -315,8 +363,10 @@ double RootSystem::aspectRatio()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkSolidity()
 {
-	if (convexArea() != 0)
-		return networkArea() / convexArea();	//TODO: networkArea is computed based on pixels, convexArea is computed based on the contour. This ratio might not be apples to apples...
+	TRAITER_PROFILE_SCOPE("RootSystem::networkSolidity");
+
+	if (_statistics.convexArea != 0)
+		return _statistics.networkArea / _statistics.convexArea;	//TODO: networkArea is computed based on pixels, convexArea is computed based on the contour. This ratio might not be apples to apples...
 
 	return -1;
 }
@@ -333,7 +383,14 @@ double RootSystem::networkSolidity()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::specificRootLength()
 {
-	return 0;
+	TRAITER_PROFILE_SCOPE("RootSystem::specificRootLength");
+
+	const double volume = networkVolume();
+
+	if (volume == 0)
+		return -1;
+
+	return _statistics.networkLength / volume;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -346,7 +403,9 @@ double RootSystem::specificRootLength()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkSurfaceArea()
 {
-	return 0;
+	TRAITER_PROFILE_SCOPE("RootSystem::networkSurfaceArea");
+
+	return 2 * CV_PI * _statistics.skeletonRadiusSum;	// The circumference of the root at each skeleton pixel.
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -358,7 +417,9 @@ double RootSystem::networkSurfaceArea()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkLength()
 {
-	return countNonZero(_skeleton);
+	TRAITER_PROFILE_SCOPE("RootSystem::networkLength");
+
+	return _statistics.networkLength;
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -371,7 +432,9 @@ double RootSystem::networkLength()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkVolume()
 {
-	return 0;
+	TRAITER_PROFILE_SCOPE("RootSystem::networkVolume");
+
+	return CV_PI * _statistics.skeletonSquaredRadiusSum;	// The cross-sectional area of the root at each skeleton pixel.
 }
 
 //////////////////////////////////////////////////////////////////////////////////
@@ -383,8 +446,520 @@ double RootSystem::networkVolume()
 //////////////////////////////////////////////////////////////////////////////////
 double RootSystem::networkWidthToDepthRatio()
 {
-	if (networkDepth() != 0)
-		return networkWidth() / networkDepth();
+	TRAITER_PROFILE_SCOPE("RootSystem::networkWidthToDepthRatio");
+
+	if (_statistics.networkDepth != 0)
+		return static_cast<double>(_statistics.networkWidth) / _statistics.networkDepth;
+
+	return -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// numberOfTips()
+//
+// Units: n
+//
+// The number of root tips, which are the ends of the skeleton branches that do
+// not meet another branch.
+//////////////////////////////////////////////////////////////////////////////////
+double RootSystem::numberOfTips()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::numberOfTips");
+
+	return _statistics.numberOfTips;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// numberOfBranches()
+//
+// Units: n
+//
+// The number of skeleton branches, which run between tips and junctions.
+//////////////////////////////////////////////////////////////////////////////////
+double RootSystem::numberOfBranches()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::numberOfBranches");
+
+	return _statistics.numberOfBranches;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// medianBranchLength()
+//
+// Units: cm
+//
+// The median length of the skeleton branches.
+//////////////////////////////////////////////////////////////////////////////////
+double RootSystem::medianBranchLength()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::medianBranchLength");
+
+	return _statistics.medianBranchLength;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// averageBranchLength()
+//
+// Units: cm
+//
+// The mean length of the skeleton branches.
+//////////////////////////////////////////////////////////////////////////////////
+double RootSystem::averageBranchLength()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::averageBranchLength");
+
+	return _statistics.averageBranchLength;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// weightedNetworkLength()
+//
+// Units: cm
+//
+// The total length of the skeleton branches, counting diagonal steps between
+// pixels as sqrt(2) rather than 1. Unlike networkLength(), this does not
+// undercount roots that run diagonally.
+//////////////////////////////////////////////////////////////////////////////////
+double RootSystem::weightedNetworkLength()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::weightedNetworkLength");
+
+	return _statistics.weightedNetworkLength;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeExtents()
+//
+// Computes the network depth and width from the first and last white column of
+// each row, which are -1 in rows with no white pixels.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::computeExtents(const vector<int>& firstColumns, const vector<int>& lastColumns, RootSystemStatistics& statistics)
+{
+	int minX = INT_MAX;
+	int maxX = INT_MIN;
+	int minY = -1;
+	int maxY = -1;
+
+	for (int row = 0; row < static_cast<int>(firstColumns.size()); ++row)
+	{
+		if (firstColumns[row] < 0)
+			continue;
+
+		minX = min(minX, firstColumns[row]);
+		maxX = max(maxX, lastColumns[row]);
+
+		if (minY < 0)
+			minY = row;
+		maxY = row;
+	}
+
+	if (minY < 0)
+		return;	// There is no network to measure.
+
+	statistics.networkDepth = maxY - minY;
+	statistics.networkWidth = maxX - minX;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeConvexArea()
+//
+// Computes the area of the convex hull of the network from the first and last
+// white column of each row. Every pixel of a row lies between those two, so
+// their hull is the hull of the whole network, and of its traced contour.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::computeConvexArea(const vector<int>& firstColumns, const vector<int>& lastColumns, RootSystemStatistics& statistics)
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::computeConvexArea");
+
+	const vector<Point> hull = computeRowHull(firstColumns, lastColumns);
+
+	if (!hull.empty())
+		statistics.convexArea = contourArea(hull);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeBestFittingEllipse()
+//
+// Fits an ellipse to the outer contour of the network.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::computeBestFittingEllipse(const vector<Point>& contour, RootSystemStatistics& statistics)
+{
+	if (contour.size() >= 5)	// fitEllipse requires at least five points.
+		statistics.bestFittingEllipse = fitEllipse(contour);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// require()
+//
+// Builds whichever of the specified intermediate results, and the results they
+// are built from, have not been built yet.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::require(const int dependencies)
+{
+	const int missing = expandDependencies(dependencies) & ~_builtDependencies;
+
+	if (missing == 0)
+		return;
+
+	// Each result is built after the results it is built from.
+	if (missing & ROW_PROFILE_DEPENDENCY)
+		buildRowProfile();
+
+	if (missing & BORDER_DEPENDENCY)
+		buildBorder();
+
+	if (missing & CONTOUR_DEPENDENCY)
+		buildContour();
+
+	if (missing & HULL_DEPENDENCY)
+		computeConvexArea(_firstColumnInRows, _lastColumnInRows, _statistics);
+
+	if (missing & ELLIPSE_DEPENDENCY)
+		computeBestFittingEllipse(_contour, _statistics);
+
+	if (missing & SKELETON_DEPENDENCY)
+		buildSkeleton();
+
+	if (missing & RADIUS_MAP_DEPENDENCY)
+		buildRadiusMap();
+
+	if (missing & SKELETON_GRAPH_DEPENDENCY)
+		buildSkeletonGraph();
+
+	_builtDependencies |= missing;
+
+	releaseUnneededResults();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// expandDependencies()
+//
+// Adds the results that the specified intermediate results are built from.
+//////////////////////////////////////////////////////////////////////////////////
+int RootSystem::expandDependencies(const int dependencies)
+{
+	int expanded = dependencies;
+
+	if (expanded & HULL_DEPENDENCY)
+		expanded |= ROW_PROFILE_DEPENDENCY;
+
+	if (expanded & ELLIPSE_DEPENDENCY)
+		expanded |= CONTOUR_DEPENDENCY;
+
+	if (expanded & SKELETON_GRAPH_DEPENDENCY)
+		expanded |= RADIUS_MAP_DEPENDENCY;
+
+	if (expanded & RADIUS_MAP_DEPENDENCY)
+		expanded |= SKELETON_DEPENDENCY;
+
+	return expanded;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// releaseUnneededResults()
+//
+// Releases the unpacked mask and the radius map once every selected result that
+// is built from them has been built.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::releaseUnneededResults()
+{
+	if ((_selectedDependencies & MASK_READERS & ~_builtDependencies) == 0)
+		_thresholdedImage.release();
+
+	if ((_selectedDependencies & RADIUS_MAP_READERS & ~_builtDependencies) == 0)
+		_radiusMap.release();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getThresholdedImage()
+//
+// Returns the unpacked mask, unpacking it again from the packed image if it was
+// released before a trait that was not selected asked for a result built from
+// it.
+//////////////////////////////////////////////////////////////////////////////////
+const Mat& RootSystem::getThresholdedImage()
+{
+	if (_thresholdedImage.empty())
+	{
+		TRAITER_PROFILE_COUNT("masks_unpacked_again", 1);
+		_thresholdedImage = _image.toMat();
+	}
+
+	return _thresholdedImage;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildRowProfile()
+//
+// Computes the number of roots in each row, the network area, and the first and
+// last white column of each row that the extents and hull are found from. A root
+// is "found" when we find a white pixel when the previous pixel in the row was
+// black, so the number of roots in a row is the number of rising edges in its
+// packed bits, and the area is a population count.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::buildRowProfile()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::buildRowProfile");
+
+	_statistics.numberOfRootsInRows.assign(_image.rows(), 0);
+	_statistics.networkAreaInRows.assign(_image.rows(), 0);
+	_firstColumnInRows.assign(_image.rows(), -1);
+	_lastColumnInRows.assign(_image.rows(), -1);
+
+	ParallelFor::run(_image.rows(), ParallelFor::computeBandSize(_image.cols()), [&](const int firstRow, const int endRow)
+	{
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			_statistics.numberOfRootsInRows[row] = _image.risingEdges(row);
+			_statistics.networkAreaInRows[row] = _image.rowArea(row);
+			_firstColumnInRows[row] = _image.firstColumn(row);
+			_lastColumnInRows[row] = _image.lastColumn(row);
+		}
+	});
+
+	_statistics.networkArea = static_cast<double>(_image.area());
+	TRAITER_PROFILE_COUNT("network_pixels", _image.area());
+
+	computeExtents(_firstColumnInRows, _lastColumnInRows, _statistics);
+
+	computeRowStatistics();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildBorder()
+//
+// Computes the perimeter, which is the number of white pixels whose
+// neighborhood code shows at least one non-white neighbor. Neighbors outside of
+// the image are ignored, so they are treated as white.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::buildBorder()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::buildBorder");
+
+	const Mat& thresholdedImage = getThresholdedImage();
+
+	Mat neighborhoodCodes = NeighborhoodCode::computeNeighborhoodCodes(thresholdedImage, true);
+	_statistics.perimeter = static_cast<double>(NeighborhoodCode::countBorderPixels(thresholdedImage, neighborhoodCodes));
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildContour()
+//
+// Traces the outer contour of the network, which the ellipse is fit to.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::buildContour()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::buildContour");
+
+	_contour = OcvUtilities::traceOuterContour(getThresholdedImage(), _boundingBox);
+	TRAITER_PROFILE_COUNT("contour_points", _contour.size());
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildSkeleton()
+//
+// Computes the skeleton of the network and its length. The distance transform
+// skeleton also yields the radius map, which is kept for buildRadiusMap().
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::buildSkeleton()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::buildSkeleton");
+
+	_skeleton = BitMask(Skeletonizer::skeletonize(getThresholdedImage(), _skeletonMethod, _radiusMap));
+	_statistics.networkLength = static_cast<double>(_skeleton.area());
+
+	TRAITER_PROFILE_COUNT("skeleton_pixels", _skeleton.area());
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildRadiusMap()
+//
+// Estimates the root radius at every pixel, unless the skeleton already came
+// with an estimate, and sums it over the skeleton.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::buildRadiusMap()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::buildRadiusMap");
+
+	if (_radiusMap.empty())	// Only the distance transform skeleton comes with its own radius estimate.
+		_radiusMap = Skeletonizer::computeDistanceTransform(getThresholdedImage());
+
+	computeSkeletonStatistics(_radiusMap);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildSkeletonGraph()
+//
+// Builds the graph of the skeleton, and the statistics read from it. The radius
+// map is estimated again if it was released before the graph was asked for.
+//
+// The graph is always built from the thinned skeleton of the network, whichever
+// skeleton was chosen, since the others are more than one pixel wide in places
+// and every such place would be counted as extra tips and branches.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::buildSkeletonGraph()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::buildSkeletonGraph");
+
+	if (_radiusMap.empty())
+		_radiusMap = Skeletonizer::computeDistanceTransform(getThresholdedImage());
+
+	if (_skeletonMethod == THINNED_SKELETON)
+		_skeletonGraph = SkeletonGraph(_skeleton, _radiusMap);
+	else
+		_skeletonGraph = SkeletonGraph(BitMask(Skeletonizer::computeThinnedSkeleton(getThresholdedImage())), _radiusMap);
+	computeGraphStatistics(_skeletonGraph, _statistics);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeSkeletonStatistics()
+//
+// Computes the statistics that depend on the radius along the skeleton. Each
+// skeleton pixel is visited once, by walking the set bits of the packed
+// skeleton, and its radius is sampled from the radius map. The sums of the radii
+// and of their squares are all that the width, surface area and volume traits
+// need.
+//
+// Rows are summed in parallel, and the row sums are then added up in order, so
+// the totals do not depend on the number of threads. They also match the sums
+// that TimeSeriesAnalyzer keeps per row.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::computeSkeletonStatistics(const Mat& radiusMap)
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::computeSkeletonStatistics");
+
+	vector<double> radiusSumInRows(_skeleton.rows(), 0);
+	vector<double> squaredRadiusSumInRows(_skeleton.rows(), 0);
+
+	ParallelFor::run(_skeleton.rows(), ParallelFor::computeBandSize(_skeleton.cols()), [&](const int firstRow, const int endRow)
+	{
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			const uint64_t* words = _skeleton.rowWords(row);
+			const float* radii = radiusMap.ptr<float>(row);
+
+			double rowRadiusSum = 0;
+			double rowSquaredRadiusSum = 0;
+
+			for (int word = 0; word < _skeleton.wordsPerRow(); ++word)
+			{
+				for (uint64_t bits = words[word]; bits != 0; bits &= bits - 1)
+				{
+					const double radius = radii[word * 64 + BitMask::countTrailingZeros(bits)];
+
+					rowRadiusSum += radius;
+					rowSquaredRadiusSum += radius * radius;
+				}
+			}
+
+			radiusSumInRows[row] = rowRadiusSum;
+			squaredRadiusSumInRows[row] = rowSquaredRadiusSum;
+		}
+	});
+
+	double radiusSum = 0;
+	double squaredRadiusSum = 0;
+
+	for (int row = 0; row < _skeleton.rows(); ++row)
+	{
+		radiusSum += radiusSumInRows[row];
+		squaredRadiusSum += squaredRadiusSumInRows[row];
+	}
+
+	_statistics.skeletonRadiusSum = radiusSum;
+	_statistics.skeletonSquaredRadiusSum = squaredRadiusSum;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeGraphStatistics()
+//
+// Computes the statistics that depend on the topology of the skeleton into the
+// specified statistics. They are read from the skeleton graph, so their cost
+// depends on the number of branches rather than on the size of the image.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::computeGraphStatistics(const SkeletonGraph& skeletonGraph, RootSystemStatistics& statistics)
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::computeGraphStatistics");
+
+	int numberOfTips = 0;
+
+	for (int node = 0; node < skeletonGraph.nodeCount(); ++node)
+	{
+		if (skeletonGraph.degree(node) == 1)
+			++numberOfTips;
+	}
+
+	vector<double> branchLengths(skeletonGraph.edgeCount());
+	double totalLength = 0;
+
+	for (int edge = 0; edge < skeletonGraph.edgeCount(); ++edge)
+	{
+		branchLengths[edge] = skeletonGraph.edge(edge).length;
+		totalLength += branchLengths[edge];
+	}
+
+	statistics.numberOfTips = numberOfTips;
+	statistics.numberOfBranches = skeletonGraph.edgeCount();
+	statistics.medianBranchLength = GeneralUtilities::computeMedian(branchLengths);
+	statistics.averageBranchLength = branchLengths.empty() ? -1 : totalLength / branchLengths.size();
+	statistics.weightedNetworkLength = totalLength;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeRowStatistics()
+//
+// Derives the row-based traits from the per-row counts in the statistics.
+//////////////////////////////////////////////////////////////////////////////////
+void RootSystem::computeRowStatistics()
+{
+	TRAITER_PROFILE_SCOPE("RootSystem::computeRowStatistics");
+
+	const double PERCENTILE = 0.84;
+
+	vector<int> numberOfRootsInRows = computeNumberOfRootsInRows();
+
+	_medianNumberOfRoots = GeneralUtilities::computeMedian(numberOfRootsInRows);
+
+	if (numberOfRootsInRows.empty())
+	{
+		_maximumNumberOfRoots = -1;
+	}
+	else
+	{
+		sort(numberOfRootsInRows.begin(), numberOfRootsInRows.end());
+
+		int maximumIndex = static_cast<int>(round(PERCENTILE * numberOfRootsInRows.size()));
+		maximumIndex = min(maximumIndex, static_cast<int>(numberOfRootsInRows.size()) - 1);
+
+		_maximumNumberOfRoots = numberOfRootsInRows[maximumIndex];
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeNetworkLengthDistribution()
+//
+// Returns the fraction of the network area that lies in the lower two thirds of
+// the network, from the per-row areas and the network depth.
+//////////////////////////////////////////////////////////////////////////////////
+double RootSystem::computeNetworkLengthDistribution() const
+{
+	// The lower two thirds are measured from the top of the image rather than from the top of the network.
+	int lowerTwoThirdsStart = static_cast<int>(round(0.33 * _statistics.networkDepth));	//TODO: Network depth computation makes sense here only if the top of the image is where the network starts (true in current sample image case)
+
+	double lowerTwoThirdsArea = 0;
+
+	for (int row = max(lowerTwoThirdsStart, 0); row <= _statistics.networkDepth && row < static_cast<int>(_statistics.networkAreaInRows.size()); ++row)
+		lowerTwoThirdsArea += _statistics.networkAreaInRows[row];
+
+	//TODO_ROBUST: Allow debugging image to be output.
+	//for (int col = 0; col < _image.size().width; ++col)
+	//{
+	//	_image.at<uchar>(Point(col, lowerTwoThirdsStart)) = 255;
+	//	imshow("Lower Two-Thirds Line", _image);
+	//}
+
+	if (_statistics.networkArea != 0)
+		return lowerTwoThirdsArea / _statistics.networkArea;
 
 	return -1;
 }
@@ -398,18 +973,11 @@ double RootSystem::networkWidthToDepthRatio()
 //////////////////////////////////////////////////////////////////////////////////
 vector<int> RootSystem::computeNumberOfRootsInRows(bool includeZeroes)
 {
-	vector<int> numberOfRootsInRows(_image.size().height);
+	vector<int> numberOfRootsInRows(_statistics.numberOfRootsInRows.size());
 
-	for (int row = 0; row < _image.size().height; ++row)
+	for (size_t row = 0; row < _statistics.numberOfRootsInRows.size(); ++row)
 	{
-		for (int col = 0; col < _image.size().width; ++col)
-		{
-			// If the current point is white, and the previous point was black, then we have found a new root.
-			if (OcvUtilities::isPointWhite(_image, Point(col, row)) && !OcvUtilities::isPointWhite(_image, Point(col - 1, row)))
-			{
-				numberOfRootsInRows[row]++;
-			}
-		}
+		numberOfRootsInRows[row] = _statistics.numberOfRootsInRows[row];
 
 		if (numberOfRootsInRows[row] == 0)	// It should be safe to assume that once we have hit a row with no roots, there will be no more roots below that row.
 			break;
@@ -426,3 +994,62 @@ vector<int> RootSystem::computeNumberOfRootsInRows(bool includeZeroes)
 
 	return numberOfRootsInRows;
 }
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeRowHull()
+//
+// Returns the convex hull of the first and last white pixel of each row, in
+// order around the hull. The points are already sorted by row, and within a row
+// by column, so Andrew's monotone chain builds the hull in a single linear pass
+// over each side instead of sorting them.
+//////////////////////////////////////////////////////////////////////////////////
+vector<Point> RootSystem::computeRowHull(const vector<int>& firstColumns, const vector<int>& lastColumns)
+{
+	vector<Point> points;
+
+	for (int row = 0; row < static_cast<int>(firstColumns.size()); ++row)
+	{
+		if (firstColumns[row] < 0)
+			continue;
+
+		points.push_back(Point(firstColumns[row], row));
+
+		if (lastColumns[row] != firstColumns[row])
+			points.push_back(Point(lastColumns[row], row));
+	}
+
+	if (points.size() < 3)
+		return points;
+
+	// Positive if a, b, c make a strict turn in the direction the hull is built in.
+	auto cross = [](const Point& a, const Point& b, const Point& c)
+	{
+		return static_cast<long long>(b.x - a.x) * (c.y - a.y) - static_cast<long long>(b.y - a.y) * (c.x - a.x);
+	};
+
+	vector<Point> hull(2 * points.size());
+	size_t hullSize = 0;
+
+	// One chain runs down the right side of the network, the other back up the left side.
+	for (size_t point = 0; point < points.size(); ++point)
+	{
+		while (hullSize >= 2 && cross(hull[hullSize - 2], hull[hullSize - 1], points[point]) <= 0)
+			--hullSize;
+
+		hull[hullSize++] = points[point];
+	}
+
+	const size_t firstChainSize = hullSize + 1;
+
+	for (size_t point = points.size() - 1; point-- > 0;)
+	{
+		while (hullSize >= firstChainSize && cross(hull[hullSize - 2], hull[hullSize - 1], points[point]) <= 0)
+			--hullSize;
+
+		hull[hullSize++] = points[point];
+	}
+
+	hull.resize(hullSize - 1);	// The last point is the first point again.
+
+	return hull;
+}
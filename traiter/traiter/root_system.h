@@ -1,22 +1,52 @@
 #pragma once
 
 #include <opencv2/core/core.hpp>
+#include "bit_mask.h"
+#include "root_system_statistics.h"
+#include "skeleton_graph.h"
+#include "skeleton_method.h"
+#include "thresh_method.h"
+#include "thresholder.h"
+#include "trait_dependency.h"
+#include "trait_table.h"
 
 namespace traiter
 {
 	//////////////////////////////////////////////////////////////////////////////////
 	// RootSystem
 	//
-	// Computes traits for the specified root system image.
+	// Computes traits for the specified root system image. Each trait's descriptor
+	// declares the intermediate results it depends on, and each of those is built
+	// once, the first time a trait needs it, so a caller that only asks for a few
+	// traits never pays for the rest. Traits are computed through their
+	// descriptors, so that their dependencies are always built first.
 	//////////////////////////////////////////////////////////////////////////////////
 	class RootSystem
 	{
 	public:
-		RootSystem(cv::Mat image);
+		RootSystem(cv::Mat image, const SkeletonMethod skeletonMethod = MEDIAL_AXIS_TRANSFORM, const ThreshMethod threshMethod = THRESH, const segment::ThresholdParameters& thresholdParameters = segment::ThresholdParameters(), const std::vector<TraitDescriptor>& traits = TraitTable::getTraits());
+		explicit RootSystem(const RootSystemStatistics& statistics);
 
 		cv::Mat getImage();
+		cv::Mat getSkeleton();
 
-		// Traits
+		const BitMask& getPackedImage() const;
+		const BitMask& getPackedSkeleton();
+		const SkeletonGraph& getSkeletonGraph();
+		const RootSystemStatistics& getStatistics();
+
+		double computeTrait(const TraitDescriptor& trait);
+
+		static void computeExtents(const std::vector<int>& firstColumns, const std::vector<int>& lastColumns, RootSystemStatistics& statistics);
+		static void computeConvexArea(const std::vector<int>& firstColumns, const std::vector<int>& lastColumns, RootSystemStatistics& statistics);
+		static void computeBestFittingEllipse(const std::vector<cv::Point>& contour, RootSystemStatistics& statistics);
+		static void computeGraphStatistics(const SkeletonGraph& skeletonGraph, RootSystemStatistics& statistics);
+	private:
+		friend class TraitTable;
+
+		RootSystem();
+
+		// Traits, which only read the results that computeTrait() has built for them
 		double bushiness();
 		double convexArea();
 		double networkDepth();
@@ -36,13 +66,51 @@ namespace traiter
 		double networkLength();
 		double networkVolume();
 		double networkWidthToDepthRatio();
-	private:
-		RootSystem();
+		double numberOfTips();
+		double numberOfBranches();
+		double medianBranchLength();
+		double averageBranchLength();
+		double weightedNetworkLength();
+
+		void require(const int dependencies);
+		void releaseUnneededResults();
+		const cv::Mat& getThresholdedImage();
+
+		static int expandDependencies(const int dependencies);
+
+		void buildRowProfile();
+		void buildBorder();
+		void buildContour();
+		void buildSkeleton();
+		void buildRadiusMap();
+		void buildSkeletonGraph();
+
+		void computeSkeletonStatistics(const cv::Mat& radiusMap);
+		void computeRowStatistics();
+		double computeNetworkLengthDistribution() const;
+
+		static std::vector<cv::Point> computeRowHull(const std::vector<int>& firstColumns, const std::vector<int>& lastColumns);
 
 		std::vector<int> computeNumberOfRootsInRows(bool includeZeroes = false);
 
-		cv::Mat _image;
+		SkeletonMethod _skeletonMethod;
+		int _builtDependencies;	// The TraitDependency flags of the results built so far.
+		int _selectedDependencies;	// The TraitDependency flags of the results the selected traits need.
+
+		cv::Mat _thresholdedImage;	// Kept unpacked until every selected result read from it is built.
+		cv::Rect _boundingBox;
+		BitMask _image;
+		std::vector<int> _firstColumnInRows;	// The first white column of each row, or -1.
+		std::vector<int> _lastColumnInRows;
 		std::vector<cv::Point> _contour;
-		cv::Mat _skeleton;
+		BitMask _skeleton;
+		cv::Mat _radiusMap;	// Kept until the selected radius sums and skeleton graph are built.
+		SkeletonGraph _skeletonGraph;
+
+		RootSystemStatistics _statistics;
+
+		// Row statistics
+		double _medianNumberOfRoots;
+		double _maximumNumberOfRoots;
 	};
 }
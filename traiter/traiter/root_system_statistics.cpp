@@ -0,0 +1,14 @@
+#include "root_system_statistics.h"
+
+using namespace cv;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// RootSystemStatistics::RootSystemStatistics()
+//
+// Constructs the statistics of an empty image.
+//////////////////////////////////////////////////////////////////////////////////
+RootSystemStatistics::RootSystemStatistics()
+	: networkArea(0), perimeter(0), networkLength(0), skeletonRadiusSum(0), skeletonSquaredRadiusSum(0), numberOfTips(-1), numberOfBranches(-1), medianBranchLength(-1), averageBranchLength(-1), weightedNetworkLength(-1), networkDepth(-1), networkWidth(-1), convexArea(0)
+{
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// RootSystemStatistics
+	//
+	// The raw measurements of a root system that every trait is derived from. They
+	// can be gathered from a whole image in memory, or strip by strip when the image
+	// is too large to load at once.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct RootSystemStatistics
+	{
+		RootSystemStatistics();
+
+		// Row statistics
+		std::vector<int> numberOfRootsInRows;
+		std::vector<long long> networkAreaInRows;
+
+		// Image statistics
+		double networkArea;
+		double perimeter;
+
+		// Skeleton statistics
+		double networkLength;
+		double skeletonRadiusSum;	// The sum of the root radius at every skeleton pixel.
+		double skeletonSquaredRadiusSum;
+
+		// Skeleton graph statistics, which are -1 when no graph was built
+		int numberOfTips;
+		int numberOfBranches;
+		double medianBranchLength;
+		double averageBranchLength;
+		double weightedNetworkLength;	// The total length of the branches, with diagonal steps counted as sqrt(2).
+
+		// Contour statistics
+		int networkDepth;
+		int networkWidth;
+		double convexArea;
+		cv::RotatedRect bestFittingEllipse;
+	};
+}
@@ -0,0 +1,225 @@
+#include "run_length_mask.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdint.h>
+
+using namespace cv;
+using namespace std;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// RunLengthMask::RunLengthMask()
+//
+// Constructs an empty mask.
+//////////////////////////////////////////////////////////////////////////////////
+RunLengthMask::RunLengthMask()
+	: _rows(0), _cols(0), _rowStarts(1, 0), _cumulativeArea(1, 0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RunLengthMask::RunLengthMask()
+//
+// Encodes the specified CV_8UC1 mask, in which any non-zero pixel is white.
+// Spans of eight black or eight white pixels are skipped a word at a time.
+//////////////////////////////////////////////////////////////////////////////////
+RunLengthMask::RunLengthMask(const Mat& mask)
+	: _rows(mask.rows), _cols(mask.cols)
+{
+	_rowStarts.reserve(_rows + 1);
+	_cumulativeArea.reserve(_rows + 1);
+	_rowStarts.push_back(0);
+	_cumulativeArea.push_back(0);
+
+	const uint64_t ALL_WHITE = ~static_cast<uint64_t>(0);
+
+	for (int row = 0; row < _rows; ++row)
+	{
+		const uchar* maskRow = mask.ptr<uchar>(row);
+		long long rowArea = 0;
+		int col = 0;
+
+		while (col < _cols)
+		{
+			// Skip to the start of the next run.
+			uint64_t word;
+			while (col + 8 <= _cols && (memcpy(&word, maskRow + col, sizeof(word)), word == 0))
+				col += 8;
+			while (col < _cols && maskRow[col] == 0)
+				++col;
+
+			if (col == _cols)
+				break;
+
+			Run run;
+			run.start = col;
+
+			// Skip to the end of the run. Only masks holding 255 for white take the fast path, but any non-zero value is white.
+			while (col + 8 <= _cols && (memcpy(&word, maskRow + col, sizeof(word)), word == ALL_WHITE))
+				col += 8;
+			while (col < _cols && maskRow[col] != 0)
+				++col;
+
+			run.end = col;
+			_runs.push_back(run);
+			rowArea += run.end - run.start;
+		}
+
+		_rowStarts.push_back(_runs.size());
+		_cumulativeArea.push_back(_cumulativeArea.back() + rowArea);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// RunLengthMask::RunLengthMask()
+//
+// Constructs a mask with the specified width and no rows. Rows are added with
+// appendRow(), so a mask can be built up without ever decoding the whole image.
+//////////////////////////////////////////////////////////////////////////////////
+RunLengthMask::RunLengthMask(const int cols)
+	: _rows(0), _cols(cols), _rowStarts(1, 0), _cumulativeArea(1, 0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// appendRow()
+//
+// Adds a row below the last row of the mask. The runs must be sorted, must not
+// overlap and must lie within the width of the mask.
+//////////////////////////////////////////////////////////////////////////////////
+void RunLengthMask::appendRow(const vector<Run>& runs)
+{
+	long long rowArea = 0;
+
+	for (const Run& run : runs)
+	{
+		assert(run.start >= 0 && run.start < run.end && run.end <= _cols);
+
+		_runs.push_back(run);
+		rowArea += run.end - run.start;
+	}
+
+	_rowStarts.push_back(_runs.size());
+	_cumulativeArea.push_back(_cumulativeArea.back() + rowArea);
+	++_rows;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rows()
+//
+// Returns the number of rows in the mask.
+//////////////////////////////////////////////////////////////////////////////////
+int RunLengthMask::rows() const
+{
+	return _rows;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// cols()
+//
+// Returns the number of columns in the mask.
+//////////////////////////////////////////////////////////////////////////////////
+int RunLengthMask::cols() const
+{
+	return _cols;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rowBegin()
+//
+// Returns a pointer to the first run in the specified row.
+//////////////////////////////////////////////////////////////////////////////////
+const Run* RunLengthMask::rowBegin(const int row) const
+{
+	return _runs.data() + _rowStarts[row];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rowEnd()
+//
+// Returns a pointer one past the last run in the specified row.
+//////////////////////////////////////////////////////////////////////////////////
+const Run* RunLengthMask::rowEnd(const int row) const
+{
+	return _runs.data() + _rowStarts[row + 1];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// runCount()
+//
+// Returns the number of runs in the specified row. This is the number of times
+// a white pixel follows a black pixel (or the left edge of the image).
+//////////////////////////////////////////////////////////////////////////////////
+int RunLengthMask::runCount(const int row) const
+{
+	return static_cast<int>(_rowStarts[row + 1] - _rowStarts[row]);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// area()
+//
+// Returns the number of white pixels in the mask.
+//////////////////////////////////////////////////////////////////////////////////
+long long RunLengthMask::area() const
+{
+	return _cumulativeArea.back();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// rowArea()
+//
+// Returns the number of white pixels in the specified row.
+//////////////////////////////////////////////////////////////////////////////////
+long long RunLengthMask::rowArea(const int row) const
+{
+	return _cumulativeArea[row + 1] - _cumulativeArea[row];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// areaInRows()
+//
+// Returns the number of white pixels in the rows from firstRow to lastRow
+// inclusive. Rows outside of the mask are ignored.
+//////////////////////////////////////////////////////////////////////////////////
+long long RunLengthMask::areaInRows(const int firstRow, const int lastRow) const
+{
+	const int first = max(firstRow, 0);
+	const int last = min(lastRow, _rows - 1);
+
+	if (first > last)
+		return 0;
+
+	return _cumulativeArea[last + 1] - _cumulativeArea[first];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// toMat()
+//
+// Decodes the mask into a CV_8UC1 image holding 0 and 255.
+//////////////////////////////////////////////////////////////////////////////////
+Mat RunLengthMask::toMat() const
+{
+	return toMat(0, _rows);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// toMat()
+//
+// Decodes rowCount rows starting at firstRow into a CV_8UC1 image holding 0 and
+// 255. Rows outside of the mask are black.
+//////////////////////////////////////////////////////////////////////////////////
+Mat RunLengthMask::toMat(const int firstRow, const int rowCount) const
+{
+	Mat mask = Mat(rowCount, _cols, CV_8UC1, Scalar(0));
+
+	for (int row = max(firstRow, 0); row < min(firstRow + rowCount, _rows); ++row)
+	{
+		uchar* maskRow = mask.ptr<uchar>(row - firstRow);
+
+		for (const Run* run = rowBegin(row); run != rowEnd(row); ++run)
+			memset(maskRow + run->start, 255, run->end - run->start);
+	}
+
+	return mask;
+}
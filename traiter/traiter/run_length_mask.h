@@ -0,0 +1,56 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// Run
+	//
+	// A horizontal run of consecutive white pixels, covering the columns
+	// [start, end).
+	//////////////////////////////////////////////////////////////////////////////////
+	struct Run
+	{
+		int start;
+		int end;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// RunLengthMask
+	//
+	// A binary mask stored as the runs of white pixels in each row. Root masks are
+	// sparse horizontally, so most per-row computations only need to look at a
+	// handful of runs instead of every pixel in the row.
+	//////////////////////////////////////////////////////////////////////////////////
+	class RunLengthMask final
+	{
+	public:
+		RunLengthMask();
+		explicit RunLengthMask(const cv::Mat& mask);
+		explicit RunLengthMask(const int cols);
+
+		void appendRow(const std::vector<Run>& runs);
+
+		int rows() const;
+		int cols() const;
+
+		const Run* rowBegin(const int row) const;
+		const Run* rowEnd(const int row) const;
+		int runCount(const int row) const;
+
+		long long area() const;
+		long long rowArea(const int row) const;
+		long long areaInRows(const int firstRow, const int lastRow) const;
+
+		cv::Mat toMat() const;
+		cv::Mat toMat(const int firstRow, const int rowCount) const;
+	private:
+		int _rows;
+		int _cols;
+		std::vector<Run> _runs;
+		std::vector<size_t> _rowStarts;	// Index of the first run of each row, plus one past the last run.
+		std::vector<long long> _cumulativeArea;	// Number of white pixels in all of the rows before each row.
+	};
+}
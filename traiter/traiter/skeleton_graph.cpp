@@ -0,0 +1,476 @@
+#include "skeleton_graph.h"
+#include "bit_mask.h"
+#include "component_labeler.h"
+#include "direction.h"
+#include "neighborhood_code.h"
+#include "profiler.h"
+#include <cmath>
+
+using namespace cv;
+using namespace morph;
+using namespace segment;
+using namespace std;
+using namespace traiter;
+
+namespace
+{
+	// The directions of the pixels at the column to the left, the same column and the column to the right.
+	const int ABOVE_DIRECTIONS[] = { NORTHWEST, NORTH, NORTHEAST };
+	const int BELOW_DIRECTIONS[] = { SOUTHWEST, SOUTH, SOUTHEAST };
+
+	// The order the neighbors of a pixel are listed in, which is the order its chains are traced in.
+	const int NEIGHBOR_ORDER[] = { NORTH, SOUTH, WEST, EAST, NORTHWEST, NORTHEAST, SOUTHWEST, SOUTHEAST };
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// SkeletonGraph::SkeletonGraph()
+//
+// Constructs the graph of an empty skeleton.
+//////////////////////////////////////////////////////////////////////////////////
+SkeletonGraph::SkeletonGraph()
+	: _edgeOffsets(1, 0)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// SkeletonGraph::SkeletonGraph()
+//
+// Constructor to specify the skeleton to build the graph of, and the radius of
+// the root at each of its pixels.
+//
+// The neighborhood code of every pixel is computed once, in a single pass that
+// walks the rows above and below alongside each row, and its neighbors are then
+// found from the code and the first pixel near it in those rows, without a
+// search. Every pixel whose number of neighbors is not two is a node. Each node
+// pixel then traces the chains that leave it until they reach another node
+// pixel, so every chain pixel is visited once. Any pixels left over belong to
+// loops with no tips or junctions, which get a node of their own.
+//////////////////////////////////////////////////////////////////////////////////
+SkeletonGraph::SkeletonGraph(const BitMask& skeleton, const Mat& radiusMap)
+{
+	TRAITER_PROFILE_SCOPE("SkeletonGraph::SkeletonGraph");
+
+	_rowStarts.assign(1, 0);
+
+	for (int row = 0; row < skeleton.rows(); ++row)
+	{
+		const uint64_t* words = skeleton.rowWords(row);
+
+		for (int word = 0; word < skeleton.wordsPerRow(); ++word)
+		{
+			for (uint64_t bits = words[word]; bits != 0; bits &= bits - 1)
+			{
+				_pixelRows.push_back(row);
+				_pixelCols.push_back(word * 64 + BitMask::countTrailingZeros(bits));
+			}
+		}
+
+		_rowStarts.push_back(static_cast<int>(_pixelCols.size()));
+	}
+
+	classifyPixels();
+
+	const int pixelCount = static_cast<int>(_pixelCols.size());
+	int neighbors[8];
+
+	// No two neighbors in an adjacency code are next to each other around the pixel, so its transitions equal its neighbors:
+	// a tip has one neighbor, a junction three or more, and an isolated pixel none.
+	vector<uchar> adjacencies(pixelCount);
+	vector<int> parents(pixelCount);
+
+	// Junction pixels that touch are merged into one node.
+	for (int pixel = 0; pixel < pixelCount; ++pixel)
+	{
+		adjacencies[pixel] = computeAdjacency(_codes[pixel]);
+		parents[pixel] = pixel;
+
+		if (!NeighborhoodCode::isJunction(adjacencies[pixel]))
+			continue;
+
+		const int neighborCount = findNeighbors(pixel, neighbors);
+
+		for (int neighbor = 0; neighbor < neighborCount; ++neighbor)
+		{
+			if (neighbors[neighbor] < pixel && NeighborhoodCode::isJunction(adjacencies[neighbors[neighbor]]))
+				ComponentLabeler::unite(parents, pixel, neighbors[neighbor]);
+		}
+	}
+
+	vector<int> nodeOfPixel(pixelCount, -1);
+
+	for (int pixel = 0; pixel < pixelCount; ++pixel)
+	{
+		const uchar adjacency = adjacencies[pixel];
+
+		if (adjacency != 0 && !NeighborhoodCode::isEndpoint(adjacency) && !NeighborhoodCode::isJunction(adjacency))
+			continue;	// A chain pixel.
+
+		const int root = ComponentLabeler::findRoot(parents, pixel);
+
+		if (nodeOfPixel[root] < 0)	// The root is the first pixel of its junction, so it is always seen first.
+		{
+			const SkeletonNode node = { Point(_pixelCols[root], _pixelRows[root]), 0 };
+			nodeOfPixel[root] = static_cast<int>(_nodes.size());
+			_nodes.push_back(node);
+		}
+
+		nodeOfPixel[pixel] = nodeOfPixel[root];
+		++_nodes[nodeOfPixel[pixel]].pixelCount;
+	}
+
+	vector<bool> visited(pixelCount, false);
+
+	for (int pixel = 0; pixel < pixelCount; ++pixel)
+	{
+		if (nodeOfPixel[pixel] >= 0)
+			traceEdges(radiusMap, pixel, nodeOfPixel, visited);
+	}
+
+	for (int pixel = 0; pixel < pixelCount; ++pixel)
+	{
+		if (nodeOfPixel[pixel] >= 0 || visited[pixel])
+			continue;
+
+		// A loop with no tips or junctions. Any of its pixels can stand in as its node.
+		const SkeletonNode node = { Point(_pixelCols[pixel], _pixelRows[pixel]), 1 };
+		nodeOfPixel[pixel] = static_cast<int>(_nodes.size());
+		_nodes.push_back(node);
+
+		traceEdges(radiusMap, pixel, nodeOfPixel, visited);
+	}
+
+	buildIncidence();
+
+	// Only the graph is kept.
+	vector<int>().swap(_pixelRows);
+	vector<int>().swap(_pixelCols);
+	vector<int>().swap(_rowStarts);
+	vector<uchar>().swap(_codes);
+	vector<int>().swap(_firstAbove);
+	vector<int>().swap(_firstBelow);
+
+	TRAITER_PROFILE_COUNT("pixels_visited", pixelCount);
+	TRAITER_PROFILE_COUNT("graph_nodes", _nodes.size());
+	TRAITER_PROFILE_COUNT("graph_edges", _edges.size());
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// nodeCount()
+//
+// Returns the number of tips, junctions, isolated pixels and loops.
+//////////////////////////////////////////////////////////////////////////////////
+int SkeletonGraph::nodeCount() const
+{
+	return static_cast<int>(_nodes.size());
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// edgeCount()
+//
+// Returns the number of pixel chains between nodes.
+//////////////////////////////////////////////////////////////////////////////////
+int SkeletonGraph::edgeCount() const
+{
+	return static_cast<int>(_edges.size());
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// node()
+//
+// Returns the specified node.
+//////////////////////////////////////////////////////////////////////////////////
+const SkeletonNode& SkeletonGraph::node(const int index) const
+{
+	return _nodes[index];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// edge()
+//
+// Returns the specified edge.
+//////////////////////////////////////////////////////////////////////////////////
+const SkeletonEdge& SkeletonGraph::edge(const int index) const
+{
+	return _edges[index];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// degree()
+//
+// Returns the number of edge ends at the specified node. A loop counts twice,
+// so tips are the nodes of degree one.
+//////////////////////////////////////////////////////////////////////////////////
+int SkeletonGraph::degree(const int node) const
+{
+	return _edgeOffsets[node + 1] - _edgeOffsets[node];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// incidentEdgesBegin()
+//
+// Returns a pointer to the index of the first edge that ends at the specified
+// node.
+//////////////////////////////////////////////////////////////////////////////////
+const int* SkeletonGraph::incidentEdgesBegin(const int node) const
+{
+	return _incidentEdges.data() + _edgeOffsets[node];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// incidentEdgesEnd()
+//
+// Returns a pointer one past the index of the last edge that ends at the
+// specified node.
+//////////////////////////////////////////////////////////////////////////////////
+const int* SkeletonGraph::incidentEdgesEnd(const int node) const
+{
+	return _incidentEdges.data() + _edgeOffsets[node + 1];
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// classifyPixels()
+//
+// Computes the neighborhood code of every pixel, in the bit layout of
+// NeighborhoodCode, along with the index of the first pixel of the rows above
+// and below at or after the column to its left. The pixels of each row are in
+// column order, so both indices only move forward along a row, and the whole
+// skeleton is coded in one pass over its pixels.
+//////////////////////////////////////////////////////////////////////////////////
+void SkeletonGraph::classifyPixels()
+{
+	const int pixelCount = static_cast<int>(_pixelCols.size());
+	const int rows = static_cast<int>(_rowStarts.size()) - 1;
+
+	_codes.assign(pixelCount, 0);
+	_firstAbove.assign(pixelCount, 0);
+	_firstBelow.assign(pixelCount, 0);
+
+	for (int row = 0; row < rows; ++row)
+	{
+		const int rowBegin = _rowStarts[row];
+		const int rowEnd = _rowStarts[row + 1];
+
+		int above = row > 0 ? _rowStarts[row - 1] : rowBegin;
+		const int aboveEnd = rowBegin;
+		int below = rowEnd;
+		const int belowEnd = row + 1 < rows ? _rowStarts[row + 2] : rowEnd;
+
+		for (int pixel = rowBegin; pixel < rowEnd; ++pixel)
+		{
+			const int col = _pixelCols[pixel];
+			uchar code = 0;
+
+			while (above < aboveEnd && _pixelCols[above] < col - 1)
+				++above;
+
+			while (below < belowEnd && _pixelCols[below] < col - 1)
+				++below;
+
+			for (int neighbor = above; neighbor < aboveEnd && _pixelCols[neighbor] <= col + 1; ++neighbor)
+				code |= 1 << ABOVE_DIRECTIONS[_pixelCols[neighbor] - col + 1];
+
+			for (int neighbor = below; neighbor < belowEnd && _pixelCols[neighbor] <= col + 1; ++neighbor)
+				code |= 1 << BELOW_DIRECTIONS[_pixelCols[neighbor] - col + 1];
+
+			if (pixel > rowBegin && _pixelCols[pixel - 1] == col - 1)
+				code |= 1 << WEST;
+
+			if (pixel + 1 < rowEnd && _pixelCols[pixel + 1] == col + 1)
+				code |= 1 << EAST;
+
+			_codes[pixel] = code;
+			_firstAbove[pixel] = above;
+			_firstBelow[pixel] = below;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// findNeighbors()
+//
+// Writes the indices of the pixels adjacent to the specified pixel to neighbors,
+// and returns how many there are.
+//////////////////////////////////////////////////////////////////////////////////
+int SkeletonGraph::findNeighbors(const int pixel, int* neighbors) const
+{
+	const uchar adjacency = computeAdjacency(_codes[pixel]);
+	int count = 0;
+
+	for (const int direction : NEIGHBOR_ORDER)
+	{
+		if ((adjacency >> direction) & 1)
+			neighbors[count++] = findNeighbor(pixel, direction);
+	}
+
+	return count;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// findNeighbor()
+//
+// Returns the index of the neighbor of the specified pixel in the specified
+// direction, which must be set in its code. The neighbors in the row above are
+// the pixels that follow its first pixel there, one for each bit of the code
+// that is set from the left, and likewise in the row below.
+//////////////////////////////////////////////////////////////////////////////////
+int SkeletonGraph::findNeighbor(const int pixel, const int direction) const
+{
+	const uchar code = _codes[pixel];
+
+	switch (direction)
+	{
+	case NORTHWEST:
+		return _firstAbove[pixel];
+	case NORTH:
+		return _firstAbove[pixel] + ((code >> NORTHWEST) & 1);
+	case NORTHEAST:
+		return _firstAbove[pixel] + ((code >> NORTHWEST) & 1) + ((code >> NORTH) & 1);
+	case SOUTHWEST:
+		return _firstBelow[pixel];
+	case SOUTH:
+		return _firstBelow[pixel] + ((code >> SOUTHWEST) & 1);
+	case SOUTHEAST:
+		return _firstBelow[pixel] + ((code >> SOUTHWEST) & 1) + ((code >> SOUTH) & 1);
+	case WEST:
+		return pixel - 1;
+	default:
+		return pixel + 1;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// traceEdges()
+//
+// Follows every chain that leaves the specified node pixel and has not been
+// traced yet, and adds an edge for each. Node pixels that are adjacent to a
+// node pixel of another node are joined by an edge of their own.
+//////////////////////////////////////////////////////////////////////////////////
+void SkeletonGraph::traceEdges(const Mat& radiusMap, const int nodePixel, vector<int>& nodeOfPixel, vector<bool>& visited)
+{
+	const double DIAGONAL_STEP = sqrt(2.0);
+
+	auto stepLength = [&](const int from, const int to) { return (_pixelRows[from] != _pixelRows[to] && _pixelCols[from] != _pixelCols[to]) ? DIAGONAL_STEP : 1.0; };
+
+	const int firstNode = nodeOfPixel[nodePixel];
+
+	int neighbors[8];
+	const int neighborCount = findNeighbors(nodePixel, neighbors);
+
+	for (int neighbor = 0; neighbor < neighborCount; ++neighbor)
+	{
+		const int start = neighbors[neighbor];
+
+		if (nodeOfPixel[start] >= 0)
+		{
+			// Each pair of adjacent node pixels is joined once, from the lower pixel.
+			if (nodeOfPixel[start] != firstNode && nodePixel < start)
+			{
+				const SkeletonEdge edge = { firstNode, nodeOfPixel[start], stepLength(nodePixel, start), (radiusAt(radiusMap, nodePixel) + radiusAt(radiusMap, start)) / 2 };
+				_edges.push_back(edge);
+			}
+
+			continue;
+		}
+
+		if (visited[start])
+			continue;	// Already traced from its other end.
+
+		double length = stepLength(nodePixel, start);
+		double radiusSum = radiusAt(radiusMap, nodePixel) + radiusAt(radiusMap, start);
+		int chainPixels = 2;
+
+		int previous = nodePixel;
+		int current = start;
+		visited[current] = true;
+
+		while (nodeOfPixel[current] < 0)
+		{
+			int chainNeighbors[8];
+			findNeighbors(current, chainNeighbors);	// Chain pixels have exactly two neighbors.
+
+			const int next = chainNeighbors[0] != previous ? chainNeighbors[0] : chainNeighbors[1];
+
+			if (nodeOfPixel[next] < 0 && visited[next])
+				break;	// Cannot happen on a consistent chain, but never loop forever.
+
+			length += stepLength(current, next);
+			radiusSum += radiusAt(radiusMap, next);
+			++chainPixels;
+
+			previous = current;
+			current = next;
+			visited[current] = true;
+		}
+
+		if (nodeOfPixel[current] < 0)
+			continue;
+
+		// A chain of one pixel that returns to its own junction is a notch in the junction, not a loop.
+		if (nodeOfPixel[current] == firstNode && chainPixels <= 3)
+			continue;
+
+		const SkeletonEdge edge = { firstNode, nodeOfPixel[current], length, radiusSum / chainPixels };
+		_edges.push_back(edge);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildIncidence()
+//
+// Builds the compressed sparse row lists of the edges that end at each node.
+//////////////////////////////////////////////////////////////////////////////////
+void SkeletonGraph::buildIncidence()
+{
+	_edgeOffsets.assign(_nodes.size() + 1, 0);
+
+	for (const SkeletonEdge& edge : _edges)
+	{
+		++_edgeOffsets[edge.firstNode + 1];
+		++_edgeOffsets[edge.secondNode + 1];
+	}
+
+	for (size_t node = 0; node < _nodes.size(); ++node)
+		_edgeOffsets[node + 1] += _edgeOffsets[node];
+
+	_incidentEdges.resize(_edgeOffsets.back());
+	vector<int> nextSlot(_edgeOffsets.begin(), _edgeOffsets.end() - 1);
+
+	for (int edge = 0; edge < static_cast<int>(_edges.size()); ++edge)
+	{
+		_incidentEdges[nextSlot[_edges[edge].firstNode]++] = edge;
+		_incidentEdges[nextSlot[_edges[edge].secondNode]++] = edge;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// radiusAt()
+//
+// Returns the radius of the root at the specified skeleton pixel.
+//////////////////////////////////////////////////////////////////////////////////
+double SkeletonGraph::radiusAt(const Mat& radiusMap, const int pixel) const
+{
+	return radiusMap.at<float>(_pixelRows[pixel], _pixelCols[pixel]);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeAdjacency()
+//
+// Returns the neighbors of a neighborhood code that are adjacent to its pixel.
+// Those are its 4-neighbors, and its diagonal neighbors that share no
+// 4-neighbor with it, since the path through that 4-neighbor already connects
+// them.
+//////////////////////////////////////////////////////////////////////////////////
+uchar SkeletonGraph::computeAdjacency(const uchar code)
+{
+	uchar adjacency = code & ((1 << NORTH) | (1 << EAST) | (1 << SOUTH) | (1 << WEST));
+
+	for (int diagonal = NORTHEAST; diagonal <= NORTHWEST; diagonal += 2)
+	{
+		const int sharedNeighbors = (1 << (diagonal - 1)) | (1 << ((diagonal + 1) % 8));
+
+		if (((code >> diagonal) & 1) && (code & sharedNeighbors) == 0)
+			adjacency |= 1 << diagonal;
+	}
+
+	return adjacency;
+}
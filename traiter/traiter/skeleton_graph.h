@@ -0,0 +1,91 @@
+#pragma once
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace traiter
+{
+	class BitMask;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// SkeletonNode
+	//
+	// A tip, junction or isolated pixel of a skeleton. Junction pixels that touch
+	// each other are merged into a single node, positioned at its first pixel.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct SkeletonNode
+	{
+		cv::Point position;
+		int pixelCount;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// SkeletonEdge
+	//
+	// A chain of skeleton pixels between two nodes, which are the same node if the
+	// chain is a loop. The length counts diagonal steps as sqrt(2), and the mean
+	// radius is taken over every pixel of the chain, including its ends.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct SkeletonEdge
+	{
+		int firstNode;
+		int secondNode;
+		double length;
+		double meanRadius;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// SkeletonGraph
+	//
+	// The topology of a skeleton, with its tips and junctions as nodes and the
+	// pixel chains between them as edges. The edges of each node are stored in a
+	// compressed sparse row layout: the edges of node n are entries
+	// [offset(n), offset(n + 1)) of one shared array, so walking the graph never
+	// touches the pixels again.
+	//
+	// Pixels are adjacent if they are 4-neighbors, or diagonal neighbors with no
+	// 4-neighbor in common, so that the corners of a staircase are not taken for
+	// junctions. The skeleton must be one pixel wide, such as THINNED_SKELETON;
+	// anywhere it is wider, the graph has extra tips and branches.
+	//////////////////////////////////////////////////////////////////////////////////
+	class SkeletonGraph final
+	{
+	public:
+		SkeletonGraph();
+		SkeletonGraph(const BitMask& skeleton, const cv::Mat& radiusMap);
+
+		int nodeCount() const;
+		int edgeCount() const;
+
+		const SkeletonNode& node(const int index) const;
+		const SkeletonEdge& edge(const int index) const;
+
+		int degree(const int node) const;
+		const int* incidentEdgesBegin(const int node) const;
+		const int* incidentEdgesEnd(const int node) const;
+	private:
+		void classifyPixels();
+		int findNeighbors(const int pixel, int* neighbors) const;
+		int findNeighbor(const int pixel, const int direction) const;
+		void traceEdges(const cv::Mat& radiusMap, const int nodePixel, std::vector<int>& nodeOfPixel, std::vector<bool>& visited);
+		void buildIncidence();
+
+		double radiusAt(const cv::Mat& radiusMap, const int pixel) const;
+
+		static uchar computeAdjacency(const uchar code);
+
+		// Skeleton pixels in row-major order, only kept while the graph is built.
+		std::vector<int> _pixelRows;
+		std::vector<int> _pixelCols;
+		std::vector<int> _rowStarts;	// Index of the first pixel of each row, plus one past the last pixel.
+		std::vector<uchar> _codes;	// The neighborhood code of each pixel.
+		std::vector<int> _firstAbove;	// Index of the first pixel of the row above at or after the column to the left of each pixel.
+		std::vector<int> _firstBelow;	// The same in the row below.
+
+		std::vector<SkeletonNode> _nodes;
+		std::vector<SkeletonEdge> _edges;
+
+		std::vector<int> _edgeOffsets;	// Index of the first incident edge of each node, plus one past the last.
+		std::vector<int> _incidentEdges;
+	};
+}
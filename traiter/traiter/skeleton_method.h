@@ -0,0 +1,25 @@
+#pragma once
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// SkeletonMethod
+	//
+	// Represents which method should be used to compute the skeleton of a root
+	// system.
+	//////////////////////////////////////////////////////////////////////////////////
+	enum SkeletonMethod
+	{
+		// Iterated erosion and opening (Gonzalez and Woods)
+		MORPHOLOGICAL_SKELETON,
+
+		// Medial axis found by marching rays in the four cardinal directions
+		MEDIAL_AXIS_TRANSFORM,
+
+		// Ridges of an exact Euclidean distance transform
+		DISTANCE_TRANSFORM_SKELETON,
+
+		// Zhang-Suen parallel thinning
+		THINNED_SKELETON
+	};
+}
@@ -1,13 +1,60 @@
 #include "skeletonizer.h"
 #include <opencv2/imgproc/imgproc.hpp>
+#include <limits>
 #include "direction.h"
 #include "ocv_utilities.h"
+#include "parallel_for.h"
+#include "profiler.h"
+#include "skeleton_method.h"
+#include "workspace.h"
 
+using namespace std;
 using namespace cv;
 using namespace morph;
 using namespace traiter;
 using namespace utility;
 
+namespace
+{
+	// Flags stored alongside each pixel of the thinning buffer.
+	const uchar FOREGROUND = 1 << 0;
+	const uchar QUEUED = 1 << 1;
+	const uchar TESTED_FIRST_SUBITERATION = 1 << 2;
+	const uchar TESTED_SECOND_SUBITERATION = 1 << 3;
+	const uchar TESTED_BOTH_SUBITERATIONS = TESTED_FIRST_SUBITERATION | TESTED_SECOND_SUBITERATION;
+}
+
+const vector<uchar> Skeletonizer::thinningTable = Skeletonizer::buildThinningTable();
+
+//////////////////////////////////////////////////////////////////////////////////
+// skeletonize()
+//
+// Computes the skeleton of the image according to the specified method, and
+// returns the skeleton. If the method produces a radius estimate for each pixel,
+// it is written to radiusMap; otherwise radiusMap is left empty.
+//////////////////////////////////////////////////////////////////////////////////
+Mat Skeletonizer::skeletonize(const Mat& originalImage, const SkeletonMethod skeletonMethod, Mat& radiusMap)
+{
+	TRAITER_PROFILE_SCOPE("Skeletonizer::skeletonize");
+	TRAITER_PROFILE_COUNT("bytes_allocated", originalImage.total());	// Every method returns a skeleton the size of the image.
+
+	radiusMap = Mat();
+
+	switch (skeletonMethod)
+	{
+	case MORPHOLOGICAL_SKELETON:
+		return computeMorphologicalSkeleton(originalImage);
+	case MEDIAL_AXIS_TRANSFORM:
+		return computeMedialAxisTransform(originalImage);
+	case DISTANCE_TRANSFORM_SKELETON:
+		return computeDistanceTransformSkeleton(originalImage, radiusMap);
+	case THINNED_SKELETON:
+		return computeThinnedSkeleton(originalImage);
+	}
+
+	return computeMedialAxisTransform(originalImage);
+}
+
 //////////////////////////////////////////////////////////////////////////////////
 // computeMorphologicalSkeleton()
 //
@@ -17,15 +64,21 @@ using namespace utility;
 //////////////////////////////////////////////////////////////////////////////////
 Mat Skeletonizer::computeMorphologicalSkeleton(const Mat& originalImage)
 {
-	Mat image = originalImage.clone();
+	TRAITER_PROFILE_SCOPE("Skeletonizer::computeMorphologicalSkeleton");
+
+	Mat image = Workspace::borrow("Skeletonizer::image", originalImage.size(), CV_8UC1);
 	Mat skeleton = Mat(image.size(), CV_8UC1, Scalar(0));
 	Mat element = getStructuringElement(MORPH_CROSS, Size(3, 3));
-	Mat erodedImage;
-	Mat openedImage;
-	Mat temp;
+	Mat erodedImage = Workspace::borrow("Skeletonizer::erodedImage", originalImage.size(), CV_8UC1);
+	Mat openedImage = Workspace::borrow("Skeletonizer::openedImage", originalImage.size(), CV_8UC1);
+	Mat temp = Workspace::borrow("Skeletonizer::temp", originalImage.size(), CV_8UC1);
+
+	originalImage.copyTo(image);
 
 	do
 	{
+		TRAITER_PROFILE_COUNT("pixels_visited", image.total());
+
 		erode(image, erodedImage, element);
 		dilate(erodedImage, openedImage, element);
 		subtract(image, openedImage, temp);
@@ -44,7 +97,10 @@ Mat Skeletonizer::computeMorphologicalSkeleton(const Mat& originalImage)
 //////////////////////////////////////////////////////////////////////////////////
 Mat Skeletonizer::computeMedialAxisTransform(const Mat& originalImage)
 {
-	Mat image = originalImage.clone();
+	TRAITER_PROFILE_SCOPE("Skeletonizer::computeMedialAxisTransform");
+	TRAITER_PROFILE_COUNT("pixels_visited", originalImage.total());
+
+	const Mat& image = originalImage;	// Only the skeleton is modified, so the image does not need a copy of its own.
 	//Mat skeleton = Mat(image.size(), CV_8UC1, Scalar(0));
 	Mat skeleton = image.clone();
 
@@ -54,43 +110,423 @@ Mat Skeletonizer::computeMedialAxisTransform(const Mat& originalImage)
 	//      If the minimum of this list only appears once, change the corresponding pixel in the skeleton image to black.
 	//////////
 
-	for (int col = 0; col < image.size().width; ++col)
+	// Every pixel is tested on its own, so bands of rows are tested in parallel.
+	ParallelFor::run(image.rows, ParallelFor::computeBandSize(image.cols), [&](const int firstRow, const int endRow)
+	{
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			for (int col = 0; col < image.size().width; ++col)
+			{
+				Point currentPoint = Point(col, row);
+
+				if (OcvUtilities::isPointWhite(image, currentPoint))
+				{
+					int northDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, NORTH, 0);
+					int southDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, SOUTH, 0);
+					int eastDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, EAST, 0);
+					int westDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, WEST, 0);
+
+					//int northWestDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, NORTHWEST, 0);
+					//int southEastDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, SOUTHEAST, 0);
+					//int northEastDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, NORTHEAST, 0);
+					//int southWestDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, SOUTHWEST, 0);
+
+					vector<int> distances;
+					distances.push_back(northDistance);
+					distances.push_back(southDistance);
+					distances.push_back(eastDistance);
+					distances.push_back(westDistance);
+					//distances.push_back(northWestDistance);
+					//distances.push_back(southEastDistance);
+					//distances.push_back(northEastDistance);
+					//distances.push_back(southWestDistance);
+					sort(distances.begin(), distances.end());
+					//bool tmp = abs(distances[0] - distances[1]) == 1;
+					if (distances[0] != distances[1])
+					{
+						// We have only one smallest distance to the nearest black pixel, so this isn't part of the MAT.
+						skeleton.at<uchar>(currentPoint) = 0;
+					}
+				}
+			}
+		}
+	});
+
+	return skeleton;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeDistanceTransformSkeleton()
+//
+// Computes the skeleton of the image as the ridges of its Euclidean distance
+// transform. A pixel is on a ridge if its distance to the background is a local
+// maximum either horizontally or vertically. The distance of every pixel to the
+// background is written to radiusMap.
+//
+// This produces the same kind of medial axis as computeMedialAxisTransform(), but
+// in time linear in the number of pixels rather than proportional to the
+// thickness of the roots.
+//////////////////////////////////////////////////////////////////////////////////
+Mat Skeletonizer::computeDistanceTransformSkeleton(const Mat& originalImage, Mat& radiusMap)
+{
+	TRAITER_PROFILE_SCOPE("Skeletonizer::computeDistanceTransformSkeleton");
+	TRAITER_PROFILE_COUNT("pixels_visited", originalImage.total());
+
+	radiusMap = computeDistanceTransform(originalImage);
+
+	const int width = originalImage.size().width;
+	const int height = originalImage.size().height;
+
+	Mat skeleton = Mat(originalImage.size(), CV_8UC1, Scalar(0));
+
+	ParallelFor::run(height, ParallelFor::computeBandSize(width), [&](const int firstRow, const int endRow)
 	{
-		for (int row = 0; row < image.size().height; ++row)
+		for (int row = firstRow; row < endRow; ++row)
 		{
-			Point currentPoint = Point(col, row);
+			const float* previousRow = row > 0 ? radiusMap.ptr<float>(row - 1) : nullptr;
+			const float* currentRow = radiusMap.ptr<float>(row);
+			const float* nextRow = row < height - 1 ? radiusMap.ptr<float>(row + 1) : nullptr;
+			uchar* skeletonRow = skeleton.ptr<uchar>(row);
 
-			if (OcvUtilities::isPointWhite(image, currentPoint))
+			for (int col = 0; col < width; ++col)
 			{
-				int northDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, NORTH, 0);
-				int southDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, SOUTH, 0);
-				int eastDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, EAST, 0);
-				int westDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, WEST, 0);
-
-				//int northWestDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, NORTHWEST, 0);
-				//int southEastDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, SOUTHEAST, 0);
-				//int northEastDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, NORTHEAST, 0);
-				//int southWestDistance = OcvUtilities::distanceToNearestPointWithColor(image, currentPoint, SOUTHWEST, 0);
-
-				vector<int> distances;
-				distances.push_back(northDistance);
-				distances.push_back(southDistance);
-				distances.push_back(eastDistance);
-				distances.push_back(westDistance);
-				//distances.push_back(northWestDistance);
-				//distances.push_back(southEastDistance);
-				//distances.push_back(northEastDistance);
-				//distances.push_back(southWestDistance);
-				sort(distances.begin(), distances.end());
-				//bool tmp = abs(distances[0] - distances[1]) == 1;
-				if (distances[0] != distances[1])
+				const float radius = currentRow[col];
+
+				if (radius == 0)
+					continue;
+
+				// Neighbors outside of the image are background.
+				const float west = col > 0 ? currentRow[col - 1] : 0;
+				const float east = col < width - 1 ? currentRow[col + 1] : 0;
+				const float north = previousRow != nullptr ? previousRow[col] : 0;
+				const float south = nextRow != nullptr ? nextRow[col] : 0;
+
+				// Require a strict increase on at least one side so that the flanks of a straight root are not mistaken for ridges.
+				bool horizontalRidge = radius >= west && radius >= east && (radius > west || radius > east);
+				bool verticalRidge = radius >= north && radius >= south && (radius > north || radius > south);
+
+				if (horizontalRidge || verticalRidge)
+					skeletonRow[col] = 255;
+			}
+		}
+	});
+
+	return skeleton;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeDistanceTransform()
+//
+// Computes the exact Euclidean distance from every white pixel to the nearest
+// black pixel, and returns the distances as a CV_32FC1 image. Pixels outside of
+// the image are treated as black, matching computeMedialAxisTransform(). This
+// uses the separable lower envelope algorithm described in Distance Transforms
+// of Sampled Functions by Felzenszwalb and Huttenlocher, and runs in time linear
+// in the number of pixels. The vertical pass runs on bands of columns in
+// parallel, and the horizontal pass on bands of rows.
+//////////////////////////////////////////////////////////////////////////////////
+Mat Skeletonizer::computeDistanceTransform(const Mat& originalImage)
+{
+	TRAITER_PROFILE_SCOPE("Skeletonizer::computeDistanceTransform");
+	TRAITER_PROFILE_COUNT("pixels_visited", originalImage.total());
+
+	const int width = originalImage.size().width;
+	const int height = originalImage.size().height;
+
+	Mat distances = Mat(originalImage.size(), CV_32FC1);
+
+	// Vertical pass: the distance to the nearest black pixel in the same column. Walking row by row keeps the memory access sequential within a band.
+	const int minimumBandColumns = 16;	// Narrower bands would share cache lines with their neighbors.
+
+	ParallelFor::run(width, max(ParallelFor::computeBandSize(height), minimumBandColumns), [&](const int firstCol, const int endCol)
+	{
+		for (int row = 0; row < height; ++row)
+		{
+			const uchar* imageRow = originalImage.ptr<uchar>(row);
+			const float* previousRow = row > 0 ? distances.ptr<float>(row - 1) : nullptr;
+			float* distanceRow = distances.ptr<float>(row);
+
+			for (int col = firstCol; col < endCol; ++col)
+				distanceRow[col] = imageRow[col] == 0 ? 0 : (previousRow != nullptr ? previousRow[col] + 1 : 1);
+		}
+
+		for (int row = height - 1; row >= 0; --row)
+		{
+			const float* nextRow = row < height - 1 ? distances.ptr<float>(row + 1) : nullptr;
+			float* distanceRow = distances.ptr<float>(row);
+
+			for (int col = firstCol; col < endCol; ++col)
+				distanceRow[col] = min(distanceRow[col], nextRow != nullptr ? nextRow[col] + 1 : 1.0f);
+		}
+	});
+
+	// Horizontal pass: the lower envelope of the parabolas rooted at each column's squared vertical distance.
+	ParallelFor::run(height, ParallelFor::computeBandSize(width), [&](const int firstRow, const int endRow)
+	{
+		vector<double> squaredColumnDistances(width);
+		vector<double> squaredDistances(width);
+		vector<int> parabolaSites(width + 2);
+		vector<double> parabolaBoundaries(width + 3);
+
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			float* distanceRow = distances.ptr<float>(row);
+
+			for (int col = 0; col < width; ++col)
+				squaredColumnDistances[col] = static_cast<double>(distanceRow[col]) * distanceRow[col];
+
+			computeSquaredDistanceEnvelope(squaredColumnDistances.data(), width, squaredDistances.data(), parabolaSites, parabolaBoundaries);
+
+			for (int col = 0; col < width; ++col)
+				distanceRow[col] = static_cast<float>(sqrt(squaredDistances[col]));
+		}
+	});
+
+	return distances;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeSquaredDistanceEnvelope()
+//
+// Computes the one dimensional squared distance transform of a row, given the
+// squared vertical distances of each of its columns. Positions -1 and length lie
+// just outside of the image and are treated as black pixels.
+//////////////////////////////////////////////////////////////////////////////////
+void Skeletonizer::computeSquaredDistanceEnvelope(const double* squaredColumnDistances, const int length, double* squaredDistances, vector<int>& parabolaSites, vector<double>& parabolaBoundaries)
+{
+	const double INFINITE_BOUNDARY = numeric_limits<double>::infinity();
+
+	auto siteValue = [&](const int site) { return (site < 0 || site >= length) ? 0.0 : squaredColumnDistances[site]; };
+
+	int rightmostParabola = 0;
+	parabolaSites[0] = -1;
+	parabolaBoundaries[0] = -INFINITE_BOUNDARY;
+	parabolaBoundaries[1] = INFINITE_BOUNDARY;
+
+	for (int site = 0; site <= length; ++site)
+	{
+		const double value = siteValue(site);
+		double intersection;
+
+		while (true)
+		{
+			const int previousSite = parabolaSites[rightmostParabola];
+			intersection = ((value + static_cast<double>(site) * site) - (siteValue(previousSite) + static_cast<double>(previousSite) * previousSite)) / (2.0 * (site - previousSite));
+
+			if (intersection > parabolaBoundaries[rightmostParabola])
+				break;
+
+			--rightmostParabola;	// The new parabola hides the previous one entirely.
+		}
+
+		++rightmostParabola;
+		parabolaSites[rightmostParabola] = site;
+		parabolaBoundaries[rightmostParabola] = intersection;
+		parabolaBoundaries[rightmostParabola + 1] = INFINITE_BOUNDARY;
+	}
+
+	int parabola = 0;
+
+	for (int col = 0; col < length; ++col)
+	{
+		while (parabolaBoundaries[parabola + 1] < col)
+			++parabola;
+
+		const int site = parabolaSites[parabola];
+		squaredDistances[col] = static_cast<double>(col - site) * (col - site) + siteValue(site);
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeThinnedSkeleton()
+//
+// Computes a connected, one pixel wide skeleton of the image using the parallel
+// thinning algorithm described in A Fast Parallel Algorithm for Thinning
+// Digital Patterns by Zhang and Suen.
+//
+// Whether a pixel may be deleted is looked up in a precomputed table indexed by
+// its 8-neighborhood. Only pixels on the border of the shape are examined: a
+// pixel is tested again only after one of its neighbors has been deleted, and
+// it is dropped once both subiterations have left it in place. All of the
+// thinning happens in place in a single padded buffer, which is borrowed from
+// the workspace.
+//////////////////////////////////////////////////////////////////////////////////
+Mat Skeletonizer::computeThinnedSkeleton(const Mat& originalImage)
+{
+	TRAITER_PROFILE_SCOPE("Skeletonizer::computeThinnedSkeleton");
+	TRAITER_PROFILE_COUNT("pixels_visited", originalImage.total());
+
+	const int width = originalImage.size().width;
+	const int height = originalImage.size().height;
+
+	// The padding keeps every neighborhood lookup inside the buffer, and treats the area outside of the image as background.
+	Mat buffer = Workspace::borrow("Skeletonizer::thinningBuffer", Size(width + 2, height + 2), CV_8UC1);
+	buffer.setTo(Scalar(0));
+	const size_t step = buffer.step;
+
+	for (int row = 0; row < height; ++row)
+	{
+		const uchar* imageRow = originalImage.ptr<uchar>(row);
+		uchar* bufferRow = buffer.ptr<uchar>(row + 1) + 1;
+
+		for (int col = 0; col < width; ++col)
+			bufferRow[col] = imageRow[col] != 0 ? FOREGROUND : 0;
+	}
+
+	uchar* data = buffer.data;
+	vector<size_t> candidates;
+	vector<size_t> nextCandidates;
+	vector<size_t> deletions;
+
+	// Initially only the border pixels of the shape can be deleted.
+	for (int row = 1; row <= height; ++row)
+	{
+		for (int col = 1; col <= width; ++col)
+		{
+			const size_t index = row * step + col;
+
+			if ((data[index] & FOREGROUND) && computeNeighborhoodCode(data + index, step) != 0xFF)
+			{
+				data[index] |= QUEUED;
+				candidates.push_back(index);
+			}
+		}
+	}
+
+	const ptrdiff_t neighborOffsets[] =
+	{
+		-static_cast<ptrdiff_t>(step) - 1, -static_cast<ptrdiff_t>(step), -static_cast<ptrdiff_t>(step) + 1,
+		-1, 1,
+		static_cast<ptrdiff_t>(step) - 1, static_cast<ptrdiff_t>(step), static_cast<ptrdiff_t>(step) + 1
+	};
+
+	int subiteration = 0;
+
+	while (!candidates.empty())
+	{
+		const uchar deletableFlag = static_cast<uchar>(1 << subiteration);
+		const uchar testedFlag = subiteration == 0 ? TESTED_FIRST_SUBITERATION : TESTED_SECOND_SUBITERATION;
+
+		// Decide every deletion before applying any of them, so that the subiteration is parallel.
+		deletions.clear();
+
+		for (const size_t index : candidates)
+		{
+			if (thinningTable[computeNeighborhoodCode(data + index, step)] & deletableFlag)
+				deletions.push_back(index);
+		}
+
+		for (const size_t index : deletions)
+			data[index] = 0;
+
+		nextCandidates.clear();
+
+		for (const size_t index : candidates)
+		{
+			if (data[index] == 0)
+				continue;	// Deleted during this subiteration.
+
+			data[index] |= testedFlag;
+
+			if ((data[index] & TESTED_BOTH_SUBITERATIONS) == TESTED_BOTH_SUBITERATIONS)
+				data[index] &= ~QUEUED;	// Neither subiteration can delete this pixel until its neighborhood changes.
+			else
+				nextCandidates.push_back(index);
+		}
+
+		for (const size_t index : deletions)
+		{
+			for (const ptrdiff_t offset : neighborOffsets)
+			{
+				uchar& neighbor = data[index + offset];
+
+				if (!(neighbor & FOREGROUND))
+					continue;
+
+				neighbor &= ~TESTED_BOTH_SUBITERATIONS;
+
+				if (!(neighbor & QUEUED))
 				{
-					// We have only one smallest distance to the nearest black pixel, so this isn't part of the MAT.
-					skeleton.at<uchar>(currentPoint) = 0;
+					neighbor |= QUEUED;
+					nextCandidates.push_back(index + offset);
 				}
 			}
 		}
+
+		candidates.swap(nextCandidates);
+		subiteration = 1 - subiteration;
+	}
+
+	Mat skeleton = Mat(height, width, CV_8UC1);
+
+	for (int row = 0; row < height; ++row)
+	{
+		const uchar* bufferRow = buffer.ptr<uchar>(row + 1) + 1;
+		uchar* skeletonRow = skeleton.ptr<uchar>(row);
+
+		for (int col = 0; col < width; ++col)
+			skeletonRow[col] = (bufferRow[col] & FOREGROUND) ? 255 : 0;
 	}
 
 	return skeleton;
-}
\ No newline at end of file
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeNeighborhoodCode()
+//
+// Returns the 8-bit code describing which neighbors of the specified pixel are in
+// the foreground. Bit i is set when the neighbor in Direction i is foreground.
+//////////////////////////////////////////////////////////////////////////////////
+int Skeletonizer::computeNeighborhoodCode(const uchar* pixel, const size_t step)
+{
+	const uchar* above = pixel - step;
+	const uchar* below = pixel + step;
+
+	return (above[0] & FOREGROUND) << NORTH |
+		(above[1] & FOREGROUND) << NORTHEAST |
+		(pixel[1] & FOREGROUND) << EAST |
+		(below[1] & FOREGROUND) << SOUTHEAST |
+		(below[0] & FOREGROUND) << SOUTH |
+		(below[-1] & FOREGROUND) << SOUTHWEST |
+		(pixel[-1] & FOREGROUND) << WEST |
+		(above[-1] & FOREGROUND) << NORTHWEST;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildThinningTable()
+//
+// Builds the lookup table used by computeThinnedSkeleton(). For each of the 256
+// neighborhood codes, bit 0 is set if the center pixel may be deleted during the
+// first subiteration and bit 1 if it may be deleted during the second.
+//////////////////////////////////////////////////////////////////////////////////
+vector<uchar> Skeletonizer::buildThinningTable()
+{
+	vector<uchar> table(256, 0);
+
+	for (int code = 0; code < 256; ++code)
+	{
+		auto isSet = [code](const Direction direction) { return (code >> direction) & 1; };
+
+		int foregroundNeighbors = 0;
+		int transitions = 0;	// Number of background to foreground transitions when walking clockwise around the neighborhood.
+
+		for (int direction = NORTH; direction <= NORTHWEST; ++direction)
+		{
+			foregroundNeighbors += (code >> direction) & 1;
+
+			if (!((code >> direction) & 1) && ((code >> ((direction + 1) % 8)) & 1))
+				transitions++;
+		}
+
+		if (foregroundNeighbors < 2 || foregroundNeighbors > 6 || transitions != 1)
+			continue;
+
+		if (!(isSet(NORTH) && isSet(EAST) && isSet(SOUTH)) && !(isSet(EAST) && isSet(SOUTH) && isSet(WEST)))
+			table[code] |= 1;
+
+		if (!(isSet(NORTH) && isSet(EAST) && isSet(WEST)) && !(isSet(NORTH) && isSet(SOUTH) && isSet(WEST)))
+			table[code] |= 2;
+	}
+
+	return table;
+}
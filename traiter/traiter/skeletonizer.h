@@ -2,6 +2,11 @@
 
 #include <opencv2/core/core.hpp>
 
+namespace traiter
+{
+	enum SkeletonMethod;
+}
+
 namespace morph
 {
 	//////////////////////////////////////////////////////////////////////////////////
@@ -12,7 +17,20 @@ namespace morph
 	class Skeletonizer final
 	{
 	public:
+		static cv::Mat skeletonize(const cv::Mat& originalImage, const traiter::SkeletonMethod skeletonMethod, cv::Mat& radiusMap);
+
 		static cv::Mat computeMorphologicalSkeleton(const cv::Mat& originalImage);
 		static cv::Mat computeMedialAxisTransform(const cv::Mat& originalImage);
+		static cv::Mat computeDistanceTransformSkeleton(const cv::Mat& originalImage, cv::Mat& radiusMap);
+		static cv::Mat computeThinnedSkeleton(const cv::Mat& originalImage);
+
+		static cv::Mat computeDistanceTransform(const cv::Mat& originalImage);
+	private:
+		static std::vector<uchar> buildThinningTable();
+		static int computeNeighborhoodCode(const uchar* pixel, const size_t step);
+
+		static const std::vector<uchar> thinningTable;
+
+		static void computeSquaredDistanceEnvelope(const double* squaredColumnDistances, const int length, double* squaredDistances, std::vector<int>& parabolaSites, std::vector<double>& parabolaBoundaries);
 	};
 }
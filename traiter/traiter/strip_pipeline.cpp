@@ -0,0 +1,601 @@
+#include "strip_pipeline.h"
+#include "component_labeler.h"
+#include "image_strip_source.h"
+#include "profiler.h"
+#include "root_system.h"
+#include "skeletonizer.h"
+#include "thresh_method.h"
+#include "thresholder.h"
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <functional>
+
+using namespace cv;
+using namespace std;
+using namespace morph;
+using namespace segment;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeStatistics()
+//
+// Reads the image in strips of stripRows rows, thresholds them with the
+// specified method and gathers every statistic the traits need. Returns false
+// and sets error if the image could not be read.
+//////////////////////////////////////////////////////////////////////////////////
+bool StripPipeline::computeStatistics(ImageStripSource& source, const int stripRows, const ThreshMethod threshMethod, const ThresholdParameters& thresholdParameters, RootSystemStatistics& statistics, string& error)
+{
+	TRAITER_PROFILE_SCOPE("StripPipeline::computeStatistics");
+
+	if (stripRows <= 0)
+	{
+		error = "strips must have at least one row";
+		return false;
+	}
+
+	ThresholdParameters resolvedParameters = thresholdParameters;
+
+	if (threshMethod != ADAPTIVE_THRESH && !resolveThresholdValue(source, stripRows, resolvedParameters, error))
+		return false;
+
+	RunLengthMask network;
+
+	if (!extractLargestComponent(source, stripRows, threshMethod, resolvedParameters, network, error))
+		return false;
+
+	statistics = RootSystemStatistics();
+
+	computeImageStatistics(network, statistics);
+	computeContourStatistics(network, statistics);
+	computeSkeletonStatistics(network, stripRows, statistics);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// resolveThresholdValue()
+//
+// Replaces an automatic threshold value with the value chosen from the histogram
+// of the whole image, which is built by reading it one strip at a time. The
+// strips are thresholded at that value afterward, exactly as the whole image
+// would be. Fixed parameters are left unchanged without reading the image.
+// Returns false and sets error if the image could not be read.
+//////////////////////////////////////////////////////////////////////////////////
+bool StripPipeline::resolveThresholdValue(ImageStripSource& source, const int stripRows, ThresholdParameters& thresholdParameters, string& error)
+{
+	if (thresholdParameters.thresholdSelection == FIXED_THRESHOLD)
+		return true;
+
+	TRAITER_PROFILE_SCOPE("StripPipeline::resolveThresholdValue");
+
+	vector<long long> histogram(256, 0);	// One bin per gray level.
+	Mat strip;
+
+	for (int firstRow = 0; firstRow < source.rows(); firstRow += stripRows)
+	{
+		if (!source.readRows(firstRow, min(stripRows, source.rows() - firstRow), strip))
+		{
+			error = "image ended before its last row";
+			return false;
+		}
+
+		const vector<long long> stripHistogram = Thresholder::computeHistogram(strip);
+		transform(histogram.begin(), histogram.end(), stripHistogram.begin(), histogram.begin(), plus<long long>());
+	}
+
+	thresholdParameters.thresholdValue = Thresholder::selectThresholdValue(histogram, thresholdParameters.thresholdSelection, thresholdParameters.thresholdValue);
+	thresholdParameters.thresholdSelection = FIXED_THRESHOLD;
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// extractLargestComponent()
+//
+// Thresholds each strip, labels its runs and keeps only the runs of the largest
+// 8-connected component, which is the part of the image that
+// keepOnlyLargestContour() keeps. Runs are joined to the runs they touch in the
+// row above with a union-find, so components that span many strips are still
+// recognized as one. Holes in the component are left black.
+//
+// A component that has no run in the last row read can no longer grow, so
+// between strips such components are settled: the largest of them so far keeps
+// its runs and the others are dropped. Apart from the largest component, only
+// the runs of components that are still growing are kept. Settling is repeated
+// each time the kept runs have doubled, so its cost stays linear in the runs.
+//
+// Local thresholds depend on the rows around each pixel, so each strip is read
+// with a halo of half a window above and below it, and the halo is dropped once
+// the strip has been thresholded.
+//////////////////////////////////////////////////////////////////////////////////
+bool StripPipeline::extractLargestComponent(ImageStripSource& source, const int stripRows, const ThreshMethod threshMethod, const ThresholdParameters& thresholdParameters, RunLengthMask& network, string& error)
+{
+	TRAITER_PROFILE_SCOPE("StripPipeline::extractLargestComponent");
+
+	const int rows = source.rows();
+	const int cols = source.cols();
+	const int halo = threshMethod == THRESH ? 0 : thresholdParameters.maximumHalfBlockSize();
+
+	// The runs of the components that may still grow, in row order.
+	vector<Run> runs;
+	vector<int> runRows;
+	vector<int> runLabels;
+	size_t previousRowStart = 0;	// The runs of the row above the current one.
+	size_t previousRowEnd = 0;
+	size_t settledRuns = 0;	// The number of runs kept by the last settling.
+
+	vector<int> parents;
+	vector<long long> labelAreas;
+
+	// The largest component that can no longer grow.
+	vector<Run> largestRuns;
+	vector<int> largestRows;
+	long long largestArea = 0;
+
+	auto settleComponents = [&](const int lastRow)
+	{
+		TRAITER_PROFILE_SCOPE("StripPipeline::settleComponents");
+
+		const int labelCount = static_cast<int>(parents.size());
+
+		vector<long long> componentAreas(labelCount, 0);
+		vector<bool> isGrowing(labelCount, false);
+
+		for (int label = 0; label < labelCount; ++label)
+			componentAreas[ComponentLabeler::findRoot(parents, label)] += labelAreas[label];
+
+		for (size_t run = 0; run < runs.size(); ++run)
+		{
+			runLabels[run] = ComponentLabeler::findRoot(parents, runLabels[run]);
+
+			if (runRows[run] == lastRow)
+				isGrowing[runLabels[run]] = true;
+		}
+
+		// Runs are in row order, so the first of equally large components is the one that starts first, as in ComponentLabeler.
+		int largestSettled = -1;
+		size_t largestSettledStart = 0;
+
+		for (size_t run = 0; run < runs.size(); ++run)
+		{
+			const int root = runLabels[run];
+
+			if (!isGrowing[root] && (largestSettled < 0 || componentAreas[root] > componentAreas[largestSettled]))
+			{
+				largestSettled = root;
+				largestSettledStart = run;
+			}
+		}
+
+		const bool startsFirst = largestSettled >= 0 && !largestRuns.empty()
+			&& (runRows[largestSettledStart] < largestRows[0] || (runRows[largestSettledStart] == largestRows[0] && runs[largestSettledStart].start < largestRuns[0].start));
+
+		if (largestSettled >= 0 && (largestRuns.empty() || componentAreas[largestSettled] > largestArea || (componentAreas[largestSettled] == largestArea && startsFirst)))
+		{
+			largestRuns.clear();
+			largestRows.clear();
+			largestArea = componentAreas[largestSettled];
+
+			for (size_t run = largestSettledStart; run < runs.size(); ++run)
+			{
+				if (runLabels[run] == largestSettled)
+				{
+					largestRuns.push_back(runs[run]);
+					largestRows.push_back(runRows[run]);
+				}
+			}
+		}
+
+		// The growing components are relabeled in the order they start, so that lower labels still start first.
+		vector<int> newLabels(labelCount, -1);
+		size_t kept = 0;
+
+		parents.clear();
+		labelAreas.clear();
+
+		for (size_t run = 0; run < runs.size(); ++run)
+		{
+			const int root = runLabels[run];
+
+			if (!isGrowing[root])
+				continue;
+
+			if (newLabels[root] < 0)
+			{
+				newLabels[root] = static_cast<int>(parents.size());
+				parents.push_back(newLabels[root]);
+				labelAreas.push_back(componentAreas[root]);
+			}
+
+			runs[kept] = runs[run];
+			runRows[kept] = runRows[run];
+			runLabels[kept] = newLabels[root];
+			++kept;
+		}
+
+		TRAITER_PROFILE_COUNT("runs_dropped", runs.size() - kept);
+
+		runs.resize(kept);
+		runRows.resize(kept);
+		runLabels.resize(kept);
+
+		// Every run of the last row belongs to a growing component, so they are still the last runs kept.
+		previousRowEnd = kept;
+		previousRowStart = kept;
+
+		while (previousRowStart > 0 && runRows[previousRowStart - 1] == lastRow)
+			--previousRowStart;
+
+		settledRuns = kept;
+	};
+
+	Mat strip;
+
+	for (int firstRow = 0; firstRow < rows; firstRow += stripRows)
+	{
+		const int rowCount = min(stripRows, rows - firstRow);
+		const int haloFirstRow = max(firstRow - halo, 0);
+		const int haloLastRow = min(firstRow + rowCount + halo, rows);	// One past the last row read.
+
+		if (!source.readRows(haloFirstRow, haloLastRow - haloFirstRow, strip))
+		{
+			error = "image ended before its last row";
+			return false;
+		}
+
+		TRAITER_PROFILE_COUNT("strips_read", 1);
+
+		const Mat thresholdedStrip = Thresholder::threshold(strip, threshMethod, thresholdParameters);
+		RunLengthMask stripRuns = RunLengthMask(thresholdedStrip.rowRange(firstRow - haloFirstRow, firstRow - haloFirstRow + rowCount));
+
+		for (int row = 0; row < rowCount; ++row)
+		{
+			const size_t rowStart = runs.size();
+			size_t previous = previousRowStart;
+
+			for (const Run* run = stripRuns.rowBegin(row); run != stripRuns.rowEnd(row); ++run)
+			{
+				// A run in the row above touches this run if they overlap or meet diagonally.
+				while (previous < previousRowEnd && runs[previous].end < run->start)
+					++previous;
+
+				int label = -1;
+
+				for (size_t touching = previous; touching < previousRowEnd && runs[touching].start <= run->end; ++touching)
+				{
+					if (label < 0)
+						label = runLabels[touching];
+					else
+						ComponentLabeler::unite(parents, label, runLabels[touching]);
+				}
+
+				if (label < 0)
+				{
+					label = static_cast<int>(parents.size());
+					parents.push_back(label);
+					labelAreas.push_back(0);
+				}
+
+				runs.push_back(*run);
+				runRows.push_back(firstRow + row);
+				runLabels.push_back(label);
+				labelAreas[label] += run->end - run->start;
+			}
+
+			previousRowStart = rowStart;
+			previousRowEnd = runs.size();
+		}
+
+		if (runs.size() >= 2 * settledRuns)
+			settleComponents(firstRow + rowCount - 1);
+	}
+
+	settleComponents(rows);	// No component grows past the last row.
+
+	network = RunLengthMask(cols);
+	vector<Run> networkRuns;
+	size_t run = 0;
+
+	for (int row = 0; row < rows; ++row)
+	{
+		networkRuns.clear();
+
+		for (; run < largestRuns.size() && largestRows[run] == row; ++run)
+			networkRuns.push_back(largestRuns[run]);
+
+		network.appendRow(networkRuns);
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeImageStatistics()
+//
+// Computes the number of roots and the area of each row, the network area and
+// the perimeter. A pixel is inside the network, rather than on its perimeter, if
+// it lies in the eroded runs of its own row and of the rows above and below.
+// Neighbors outside of the image are treated as white, as in RootSystem.
+//////////////////////////////////////////////////////////////////////////////////
+void StripPipeline::computeImageStatistics(const RunLengthMask& network, RootSystemStatistics& statistics)
+{
+	TRAITER_PROFILE_SCOPE("StripPipeline::computeImageStatistics");
+
+	const int rows = network.rows();
+
+	statistics.numberOfRootsInRows.assign(rows, 0);
+	statistics.networkAreaInRows.assign(rows, 0);
+
+	for (int row = 0; row < rows; ++row)
+	{
+		statistics.numberOfRootsInRows[row] = network.runCount(row);
+		statistics.networkAreaInRows[row] = network.rowArea(row);
+	}
+
+	statistics.networkArea = static_cast<double>(network.area());
+
+	long long perimeter = 0;
+	vector<Run> above;
+	vector<Run> current = rows > 0 ? erodeRuns(network.rowBegin(0), network.rowEnd(0), network.cols()) : vector<Run>();
+
+	for (int row = 0; row < rows; ++row)
+	{
+		vector<Run> below = row + 1 < rows ? erodeRuns(network.rowBegin(row + 1), network.rowEnd(row + 1), network.cols()) : vector<Run>();
+
+		vector<Run> interior = current;
+
+		if (row > 0)
+			interior = intersectRuns(interior, above);
+		if (row + 1 < rows)
+			interior = intersectRuns(interior, below);
+
+		long long interiorArea = 0;
+
+		for (const Run& run : interior)
+			interiorArea += run.end - run.start;
+
+		perimeter += network.rowArea(row) - interiorArea;
+
+		above.swap(current);
+		current.swap(below);
+	}
+
+	statistics.perimeter = static_cast<double>(perimeter);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeContourStatistics()
+//
+// Computes the extents, convex hull area and best fitting ellipse of the network.
+// The extents and hull are found from the first and last pixel of each row, and
+// the ellipse is fit to the traced outer contour, the same way RootSystem finds
+// them.
+//////////////////////////////////////////////////////////////////////////////////
+void StripPipeline::computeContourStatistics(const RunLengthMask& network, RootSystemStatistics& statistics)
+{
+	TRAITER_PROFILE_SCOPE("StripPipeline::computeContourStatistics");
+
+	vector<int> firstColumns(network.rows(), -1);
+	vector<int> lastColumns(network.rows(), -1);
+
+	for (int row = 0; row < network.rows(); ++row)
+	{
+		if (network.runCount(row) == 0)
+			continue;
+
+		firstColumns[row] = network.rowBegin(row)->start;
+		lastColumns[row] = (network.rowEnd(row) - 1)->end - 1;
+	}
+
+	RootSystem::computeExtents(firstColumns, lastColumns, statistics);
+	RootSystem::computeConvexArea(firstColumns, lastColumns, statistics);
+
+	RootSystem::computeBestFittingEllipse(traceOuterContour(network), statistics);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeSkeletonStatistics()
+//
+// Computes the network length, and the radius sums of the skeleton pixels, by
+// skeletonizing the network one strip at a time.
+// A distance value is exact as long as the nearest black pixel is inside the
+// window it is computed in, and no pixel is further from black than half of the
+// longest run in its row. Each strip is therefore padded with that many rows,
+// plus the row above and below that the ridge test looks at.
+//////////////////////////////////////////////////////////////////////////////////
+void StripPipeline::computeSkeletonStatistics(const RunLengthMask& network, const int stripRows, RootSystemStatistics& statistics)
+{
+	TRAITER_PROFILE_SCOPE("StripPipeline::computeSkeletonStatistics");
+
+	const int rows = network.rows();
+
+	vector<int> rowRadii(rows, 0);
+
+	for (int row = 0; row < rows; ++row)
+	{
+		for (const Run* run = network.rowBegin(row); run != network.rowEnd(row); ++run)
+			rowRadii[row] = max(rowRadii[row], (run->end - run->start + 1) / 2);
+	}
+
+	long long networkLength = 0;
+	double radiusSum = 0;
+	double squaredRadiusSum = 0;
+	Mat radiusMap;
+
+	for (int firstRow = 0; firstRow < rows; firstRow += stripRows)
+	{
+		const int lastRow = min(firstRow + stripRows, rows);	// One past the last row of the strip.
+
+		int radius = 0;
+
+		for (int row = max(firstRow - 1, 0); row < min(lastRow + 1, rows); ++row)
+			radius = max(radius, rowRadii[row]);
+
+		if (radius == 0)
+			continue;	// The strip and its neighboring rows are empty.
+
+		const int windowFirstRow = max(firstRow - 1 - radius, 0);
+		const int windowLastRow = min(lastRow + 1 + radius, rows);
+
+		Mat window = network.toMat(windowFirstRow, windowLastRow - windowFirstRow);
+		Mat skeleton = Skeletonizer::computeDistanceTransformSkeleton(window, radiusMap);
+
+		for (int row = firstRow - windowFirstRow; row < lastRow - windowFirstRow; ++row)
+		{
+			const uchar* skeletonRow = skeleton.ptr<uchar>(row);
+			const float* radii = radiusMap.ptr<float>(row);
+
+			for (int col = 0; col < skeleton.cols; ++col)
+			{
+				if (skeletonRow[col] == 0)
+					continue;
+
+				const double radius = radii[col];
+
+				radiusSum += radius;
+				squaredRadiusSum += radius * radius;
+				++networkLength;
+			}
+		}
+	}
+
+	statistics.networkLength = static_cast<double>(networkLength);
+	statistics.skeletonRadiusSum = radiusSum;
+	statistics.skeletonSquaredRadiusSum = squaredRadiusSum;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// traceOuterContour()
+//
+// Returns the outer contour of the network, traced the same way findContours()
+// traces it for RootSystem: it starts at the first pixel of the first row, and
+// follows the border with the background on its right, writing every pixel it
+// passes through, so pixels of one pixel wide spurs appear twice. Pixels are
+// looked up in the runs, so the network is never unpacked.
+//////////////////////////////////////////////////////////////////////////////////
+vector<Point> StripPipeline::traceOuterContour(const RunLengthMask& network)
+{
+	TRAITER_PROFILE_SCOPE("StripPipeline::traceOuterContour");
+
+	// The eight directions in the order findContours() turns through them, starting east and turning counterclockwise.
+	const Point STEPS[8] = { Point(1, 0), Point(1, -1), Point(0, -1), Point(-1, -1), Point(-1, 0), Point(-1, 1), Point(0, 1), Point(1, 1) };
+	const int WEST = 4;
+
+	vector<Point> contour;
+	int firstRow = 0;
+
+	while (firstRow < network.rows() && network.runCount(firstRow) == 0)
+		++firstRow;
+
+	if (firstRow == network.rows())
+		return contour;
+
+	const Point start(network.rowBegin(firstRow)->start, firstRow);
+
+	// The neighbor that the trace ends on, the first white one turning clockwise from the west.
+	int direction = WEST;
+	Point second;
+
+	do
+	{
+		direction = (direction + 7) % 8;
+		second = start + STEPS[direction];
+	} while (direction != WEST && !isWhite(network, second));
+
+	if (direction == WEST)
+	{
+		contour.push_back(start);	// A single pixel.
+		return contour;
+	}
+
+	Point current = start;
+
+	while (true)
+	{
+		Point next;
+
+		do
+		{
+			direction = (direction + 1) % 8;
+			next = current + STEPS[direction];
+		} while (!isWhite(network, next));
+
+		contour.push_back(current);
+
+		if (next == start && current == second)
+			break;
+
+		current = next;
+		direction = (direction + 4) % 8;
+	}
+
+	TRAITER_PROFILE_COUNT("contour_points", contour.size());
+
+	return contour;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// isWhite()
+//
+// Returns true if the pixel lies in one of the runs of its row. Pixels outside
+// of the image are black.
+//////////////////////////////////////////////////////////////////////////////////
+bool StripPipeline::isWhite(const RunLengthMask& network, const Point& pixel)
+{
+	if (pixel.y < 0 || pixel.y >= network.rows())
+		return false;
+
+	// The last run that starts at or before the pixel is the only one that can hold it.
+	const Run* run = upper_bound(network.rowBegin(pixel.y), network.rowEnd(pixel.y), pixel.x, [](const int col, const Run& run) { return col < run.start; });
+
+	return run != network.rowBegin(pixel.y) && pixel.x < (run - 1)->end;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// erodeRuns()
+//
+// Returns the pixels of the runs whose left and right neighbors are both white.
+// Neighbors outside of the image are treated as white.
+//////////////////////////////////////////////////////////////////////////////////
+vector<Run> StripPipeline::erodeRuns(const Run* begin, const Run* end, const int cols)
+{
+	vector<Run> eroded;
+
+	for (const Run* run = begin; run != end; ++run)
+	{
+		const Run interior = { run->start == 0 ? 0 : run->start + 1, run->end == cols ? cols : run->end - 1 };
+
+		if (interior.start < interior.end)
+			eroded.push_back(interior);
+	}
+
+	return eroded;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// intersectRuns()
+//
+// Returns the pixels covered by both lists of runs. Both lists must be sorted,
+// but the runs within the second list may overlap each other.
+//////////////////////////////////////////////////////////////////////////////////
+vector<Run> StripPipeline::intersectRuns(const vector<Run>& first, const vector<Run>& second)
+{
+	vector<Run> intersection;
+	size_t i = 0;
+	size_t j = 0;
+
+	while (i < first.size() && j < second.size())
+	{
+		const Run overlap = { max(first[i].start, second[j].start), min(first[i].end, second[j].end) };
+
+		if (overlap.start < overlap.end)
+			intersection.push_back(overlap);
+
+		if (first[i].end < second[j].end)
+			++i;
+		else
+			++j;
+	}
+
+	return intersection;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "root_system_statistics.h"
+#include "run_length_mask.h"
+#include "thresholder.h"
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	class ImageStripSource;
+	enum ThreshMethod;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// StripPipeline
+	//
+	// Gathers the statistics of a root system from an image that is read one strip
+	// at a time. Each strip is thresholded and reduced to runs as soon as it is
+	// read, and components that can no longer grow are dropped unless they are the
+	// largest so far, so memory is bounded by the strip size plus the runs of the
+	// components that are kept, rather than by the pixel count of the image.
+	// Adaptive thresholds read enough rows around each strip to cover their
+	// windows, so strips are thresholded exactly as the whole image would be. An
+	// automatic threshold value is chosen from a first pass that only builds the
+	// histogram of the image.
+	//
+	// The results match a RootSystem built with DISTANCE_TRANSFORM_SKELETON, which
+	// is the only skeleton whose pixels depend on a bounded neighborhood.
+	//////////////////////////////////////////////////////////////////////////////////
+	class StripPipeline final
+	{
+	public:
+		static bool computeStatistics(ImageStripSource& source, const int stripRows, const ThreshMethod threshMethod, const segment::ThresholdParameters& thresholdParameters, RootSystemStatistics& statistics, std::string& error);
+	private:
+		StripPipeline();
+
+		static bool resolveThresholdValue(ImageStripSource& source, const int stripRows, segment::ThresholdParameters& thresholdParameters, std::string& error);
+		static bool extractLargestComponent(ImageStripSource& source, const int stripRows, const ThreshMethod threshMethod, const segment::ThresholdParameters& thresholdParameters, RunLengthMask& network, std::string& error);
+
+		static void computeImageStatistics(const RunLengthMask& network, RootSystemStatistics& statistics);
+		static void computeContourStatistics(const RunLengthMask& network, RootSystemStatistics& statistics);
+		static void computeSkeletonStatistics(const RunLengthMask& network, const int stripRows, RootSystemStatistics& statistics);
+
+		static std::vector<cv::Point> traceOuterContour(const RunLengthMask& network);
+		static bool isWhite(const RunLengthMask& network, const cv::Point& pixel);
+
+		static std::vector<Run> erodeRuns(const Run* begin, const Run* end, const int cols);
+		static std::vector<Run> intersectRuns(const std::vector<Run>& first, const std::vector<Run>& second);
+	};
+}
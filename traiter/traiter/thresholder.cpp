@@ -1,35 +1,370 @@
 #include "thresholder.h"
+#include "parallel_for.h"
+#include "profiler.h"
 #include "thresh_method.h"
+#include "workspace.h"
 #include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
 
 using namespace cv;
 using namespace segment;
+using namespace std;
 using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// ThresholdParameters::ThresholdParameters()
+//
+// Constructor that sets every parameter to its default.
+//////////////////////////////////////////////////////////////////////////////////
+ThresholdParameters::ThresholdParameters()
+	: thresholdValue(183), thresholdSelection(FIXED_THRESHOLD), blockSize(19), offset(0), contrastBlockSize(61), minimumContrast(15)
+{
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// maximumHalfBlockSize()
+//
+// Returns how far a window can reach from its center pixel. A thresholded row
+// depends on this many rows above and below it.
+//////////////////////////////////////////////////////////////////////////////////
+int ThresholdParameters::maximumHalfBlockSize() const
+{
+	return max(blockSize, contrastBlockSize) / 2;
+}
 
 //////////////////////////////////////////////////////////////////////////////////
 // threshold()
 //
 // Thresholds the image according to the specified method, and returns the
-// thresholded image.
+// thresholded image. An automatic threshold value is chosen from the histogram
+// of the image first, unless the method does not use one.
 //////////////////////////////////////////////////////////////////////////////////
-Mat Thresholder::threshold(const Mat& originalImage, const traiter::ThreshMethod thresholdingMethod)
+Mat Thresholder::threshold(const Mat& originalImage, const traiter::ThreshMethod thresholdingMethod, const ThresholdParameters& parameters)
 {
-	Mat image = originalImage.clone();
+	TRAITER_PROFILE_SCOPE("Thresholder::threshold");
+	TRAITER_PROFILE_COUNT("pixels_visited", originalImage.total());
+	TRAITER_PROFILE_COUNT("bytes_allocated", originalImage.total());	// The thresholded image.
 
 	Mat thresholdImage;
 
 	switch (thresholdingMethod)
 	{
 	case THRESH:
-		cv::threshold(image, thresholdImage, thresholdValue, maximumThresholdValue, thresholdType);
+		cv::threshold(originalImage, thresholdImage, resolveThresholdValue(originalImage, parameters).thresholdValue, maximumThresholdValue, thresholdType);
 		break;
 	case ADAPTIVE_THRESH:
-		cv::adaptiveThreshold(image, thresholdImage, maximumThresholdValue, ADAPTIVE_THRESH_MEAN_C, thresholdType, defaultBlockSize, 0);
+		cv::adaptiveThreshold(originalImage, thresholdImage, maximumThresholdValue, ADAPTIVE_THRESH_MEAN_C, thresholdType, parameters.blockSize, parameters.offset);
 		break;
 	case DOUBLE_ADAPTIVE_THRESH:
-		cv::threshold(image, thresholdImage, thresholdValue, maximumThresholdValue, thresholdType);	//TODO: Implement doubly adaptive thresholding.
+		thresholdImage = computeDoublyAdaptiveThreshold(originalImage, resolveThresholdValue(originalImage, parameters));
 		break;
 	}
 
 	return thresholdImage;
 }
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeDoublyAdaptiveThreshold()
+//
+// Thresholds each pixel against the mean of the blockSize window around it, but
+// only where the contrastBlockSize window around it has a standard deviation of
+// at least minimumContrast. In flat windows the local mean follows the noise of
+// the background, so those pixels fall back to the global threshold value.
+//
+// The means and variances come from integral images, so the cost per pixel is
+// the same whatever the window sizes. Windows are clipped to the image, and
+// averaged over the pixels that they cover. Bands of rows are thresholded in
+// parallel once the integral images are built.
+//////////////////////////////////////////////////////////////////////////////////
+Mat Thresholder::computeDoublyAdaptiveThreshold(const Mat& originalImage, const ThresholdParameters& parameters)
+{
+	TRAITER_PROFILE_SCOPE("Thresholder::computeDoublyAdaptiveThreshold");
+
+	const int rows = originalImage.rows;
+	const int cols = originalImage.cols;
+	const int meanRadius = parameters.blockSize / 2;
+	const int contrastRadius = parameters.contrastBlockSize / 2;
+	const double minimumVariance = parameters.minimumContrast * parameters.minimumContrast;
+
+	const Size integralSize = Size(cols + 1, rows + 1);
+	Mat sums = Workspace::borrow("Thresholder::sums", integralSize, CV_64FC1);
+	Mat squaredSums = Workspace::borrow("Thresholder::squaredSums", integralSize, CV_64FC1);
+	integral(originalImage, sums, squaredSums, CV_64F);
+
+	Mat thresholdImage = Mat(originalImage.size(), CV_8UC1);
+
+	ParallelFor::run(rows, ParallelFor::computeBandSize(cols), [&](const int firstRow, const int endRow)
+	{
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			const uchar* imageRow = originalImage.ptr<uchar>(row);
+			uchar* thresholdRow = thresholdImage.ptr<uchar>(row);
+
+			const int meanTop = max(row - meanRadius, 0);
+			const int meanBottom = min(row + meanRadius + 1, rows);
+			const double* meanTopSums = sums.ptr<double>(meanTop);
+			const double* meanBottomSums = sums.ptr<double>(meanBottom);
+
+			const int contrastTop = max(row - contrastRadius, 0);
+			const int contrastBottom = min(row + contrastRadius + 1, rows);
+			const double* contrastTopSums = sums.ptr<double>(contrastTop);
+			const double* contrastBottomSums = sums.ptr<double>(contrastBottom);
+			const double* contrastTopSquaredSums = squaredSums.ptr<double>(contrastTop);
+			const double* contrastBottomSquaredSums = squaredSums.ptr<double>(contrastBottom);
+
+			for (int col = 0; col < cols; ++col)
+			{
+				const int contrastLeft = max(col - contrastRadius, 0);
+				const int contrastRight = min(col + contrastRadius + 1, cols);
+				const double contrastArea = static_cast<double>(contrastBottom - contrastTop) * (contrastRight - contrastLeft);
+
+				const double contrastSum = contrastBottomSums[contrastRight] - contrastTopSums[contrastRight] - contrastBottomSums[contrastLeft] + contrastTopSums[contrastLeft];
+				const double contrastSquaredSum = contrastBottomSquaredSums[contrastRight] - contrastTopSquaredSums[contrastRight] - contrastBottomSquaredSums[contrastLeft] + contrastTopSquaredSums[contrastLeft];
+				const double contrastMean = contrastSum / contrastArea;
+				const double variance = contrastSquaredSum / contrastArea - contrastMean * contrastMean;
+
+				bool isWhite;
+
+				if (variance < minimumVariance)
+				{
+					isWhite = imageRow[col] > parameters.thresholdValue;
+				}
+				else
+				{
+					const int meanLeft = max(col - meanRadius, 0);
+					const int meanRight = min(col + meanRadius + 1, cols);
+					const double meanArea = static_cast<double>(meanBottom - meanTop) * (meanRight - meanLeft);
+					const double mean = (meanBottomSums[meanRight] - meanTopSums[meanRight] - meanBottomSums[meanLeft] + meanTopSums[meanLeft]) / meanArea;
+
+					isWhite = imageRow[col] > mean - parameters.offset;
+				}
+
+				thresholdRow[col] = isWhite ? maximumThresholdValue : 0;
+			}
+		}
+	});
+
+	return thresholdImage;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// resolveThresholdValue()
+//
+// Returns the parameters with an automatic threshold value replaced by the value
+// chosen from the histogram of the specified image. Fixed parameters are
+// returned unchanged, without reading the image. Callers that threshold part of
+// an image at a time resolve the value from the whole image first, so every
+// part is thresholded at the same level.
+//////////////////////////////////////////////////////////////////////////////////
+ThresholdParameters Thresholder::resolveThresholdValue(const Mat& originalImage, const ThresholdParameters& parameters)
+{
+	if (parameters.thresholdSelection == FIXED_THRESHOLD)
+		return parameters;
+
+	ThresholdParameters resolved = parameters;
+	resolved.thresholdValue = selectThresholdValue(computeHistogram(originalImage), parameters.thresholdSelection, parameters.thresholdValue);
+	resolved.thresholdSelection = FIXED_THRESHOLD;
+
+	return resolved;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeHistogram()
+//
+// Returns how many pixels of the image have each of the 256 gray levels, in one
+// pass over the pixels. Bands of rows are counted in parallel, each into its own
+// histogram, and added up once the loop is done.
+//
+// Consecutive pixels of the same level would each have to wait for the previous
+// increment of their bin, so every band counts into several histograms in turn
+// and adds them up at the end.
+//////////////////////////////////////////////////////////////////////////////////
+vector<long long> Thresholder::computeHistogram(const Mat& originalImage)
+{
+	TRAITER_PROFILE_SCOPE("Thresholder::computeHistogram");
+	TRAITER_PROFILE_COUNT("pixels_visited", originalImage.total());
+
+	const int INTERLEAVED_HISTOGRAMS = 4;
+
+	const int rows = originalImage.rows;
+	const int cols = originalImage.cols;
+	const int bandSize = ParallelFor::computeBandSize(cols);
+	const int bandCount = (rows + bandSize - 1) / bandSize;
+
+	vector<long long> bandHistograms(static_cast<size_t>(bandCount) * levelCount, 0);
+
+	ParallelFor::run(rows, bandSize, [&](const int firstRow, const int endRow)
+	{
+		long long counts[INTERLEAVED_HISTOGRAMS][levelCount] = {};
+
+		for (int row = firstRow; row < endRow; ++row)
+		{
+			const uchar* imageRow = originalImage.ptr<uchar>(row);
+			int col = 0;
+
+			for (; col + INTERLEAVED_HISTOGRAMS <= cols; col += INTERLEAVED_HISTOGRAMS)
+			{
+				++counts[0][imageRow[col]];
+				++counts[1][imageRow[col + 1]];
+				++counts[2][imageRow[col + 2]];
+				++counts[3][imageRow[col + 3]];
+			}
+
+			for (; col < cols; ++col)
+				++counts[0][imageRow[col]];
+		}
+
+		long long* bandHistogram = &bandHistograms[static_cast<size_t>(firstRow / bandSize) * levelCount];
+
+		for (int level = 0; level < levelCount; ++level)
+			bandHistogram[level] = counts[0][level] + counts[1][level] + counts[2][level] + counts[3][level];
+	});
+
+	vector<long long> histogram(levelCount, 0);
+
+	for (int band = 0; band < bandCount; ++band)
+	{
+		for (int level = 0; level < levelCount; ++level)
+			histogram[level] += bandHistograms[static_cast<size_t>(band) * levelCount + level];
+	}
+
+	return histogram;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeMaskAreas()
+//
+// Returns, for each of the 256 threshold values, how many pixels of the image
+// the histogram was computed from would be white when thresholded at that
+// value, that is, how many are brighter than it.
+//////////////////////////////////////////////////////////////////////////////////
+vector<long long> Thresholder::computeMaskAreas(const vector<long long>& histogram)
+{
+	vector<long long> maskAreas(levelCount, 0);
+
+	for (int level = levelCount - 2; level >= 0; --level)
+		maskAreas[level] = maskAreas[level + 1] + histogram[level + 1];
+
+	return maskAreas;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// selectThresholdValue()
+//
+// Returns the threshold value the specified selection picks from the histogram,
+// or the fixed value if the selection is fixed.
+//////////////////////////////////////////////////////////////////////////////////
+int Thresholder::selectThresholdValue(const vector<long long>& histogram, const ThresholdSelection selection, const int fixedValue)
+{
+	switch (selection)
+	{
+	case OTSU_THRESHOLD:
+		return computeOtsuThreshold(histogram);
+	case TRIANGLE_THRESHOLD:
+		return computeTriangleThreshold(histogram);
+	default:
+		return fixedValue;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeOtsuThreshold()
+//
+// Returns the threshold value that maximizes the variance between the levels at
+// or below it and the levels above it (Otsu's method). Returns 0 if the
+// histogram has fewer than two distinct levels.
+//////////////////////////////////////////////////////////////////////////////////
+int Thresholder::computeOtsuThreshold(const vector<long long>& histogram)
+{
+	double total = 0;
+	double levelSum = 0;
+
+	for (int level = 0; level < levelCount; ++level)
+	{
+		total += static_cast<double>(histogram[level]);
+		levelSum += static_cast<double>(level) * histogram[level];
+	}
+
+	double backgroundCount = 0;
+	double backgroundSum = 0;
+	double maximumVariance = 0;
+	int thresholdValue = 0;
+
+	for (int level = 0; level < levelCount; ++level)
+	{
+		backgroundCount += static_cast<double>(histogram[level]);
+		backgroundSum += static_cast<double>(level) * histogram[level];
+
+		const double foregroundCount = total - backgroundCount;
+
+		if (backgroundCount == 0)
+			continue;
+
+		if (foregroundCount == 0)
+			break;
+
+		const double meanDifference = backgroundSum / backgroundCount - (levelSum - backgroundSum) / foregroundCount;
+		const double variance = backgroundCount * foregroundCount * meanDifference * meanDifference;
+
+		if (variance > maximumVariance)
+		{
+			maximumVariance = variance;
+			thresholdValue = level;
+		}
+	}
+
+	return thresholdValue;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeTriangleThreshold()
+//
+// Returns the level whose bin lies farthest below the line joining the peak of
+// the histogram to the empty bin just past the end of its longer tail (the
+// triangle method). Suited to a small, bright network on a large background,
+// whose levels form a long, low tail rather than a second peak. Returns 0 for an
+// empty histogram.
+//////////////////////////////////////////////////////////////////////////////////
+int Thresholder::computeTriangleThreshold(const vector<long long>& histogram)
+{
+	int firstLevel = 0;
+	int lastLevel = levelCount - 1;
+
+	while (firstLevel < levelCount && histogram[firstLevel] == 0)
+		++firstLevel;
+
+	if (firstLevel == levelCount)
+		return 0;
+
+	while (histogram[lastLevel] == 0)
+		--lastLevel;
+
+	const int peakLevel = static_cast<int>(max_element(histogram.begin(), histogram.end()) - histogram.begin());
+	const bool tailIsBright = lastLevel - peakLevel >= peakLevel - firstLevel;
+	const int endLevel = tailIsBright ? min(lastLevel + 1, levelCount - 1) : max(firstLevel - 1, 0);
+
+	if (endLevel == peakLevel)
+		return peakLevel;	// Every pixel has the same level, at one end of the range.
+
+	// The distance of a bin from the line is proportional to how far the line passes above it.
+	const double peakCount = static_cast<double>(histogram[peakLevel]);
+	const double tailDrop = (peakCount - histogram[endLevel]) / abs(endLevel - peakLevel);
+
+	double maximumDistance = 0;
+	int thresholdValue = peakLevel;
+
+	for (int level = min(peakLevel, endLevel); level <= max(peakLevel, endLevel); ++level)
+	{
+		const double distance = peakCount - tailDrop * abs(level - peakLevel) - histogram[level];
+
+		if (distance > maximumDistance)
+		{
+			maximumDistance = distance;
+			thresholdValue = level;
+		}
+	}
+
+	return thresholdValue;
+}
@@ -2,6 +2,7 @@
 
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include <vector>
 
 namespace traiter
 {
@@ -10,6 +11,48 @@ namespace traiter
 
 namespace segment
 {
+	//////////////////////////////////////////////////////////////////////////////////
+	// ThresholdSelection
+	//
+	// Represents how the global threshold value is chosen.
+	//////////////////////////////////////////////////////////////////////////////////
+	enum ThresholdSelection
+	{
+		// The threshold value given
+		FIXED_THRESHOLD,
+
+		// Maximizes the variance between the background and the network
+		OTSU_THRESHOLD,
+
+		// The knee of the histogram below its peak's tail
+		TRIANGLE_THRESHOLD
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// ThresholdParameters
+	//
+	// The settings of the thresholding methods. Block sizes are the odd width of
+	// the square window around each pixel.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct ThresholdParameters
+	{
+		ThresholdParameters();
+
+		// Basic thresholding, and flat regions when doubly adaptive
+		int thresholdValue;
+		ThresholdSelection thresholdSelection;	// Unless fixed, thresholdValue is chosen from each image's histogram.
+
+		// Adaptive thresholding
+		int blockSize;
+		double offset;	// A pixel is white if it is brighter than its local mean minus the offset.
+
+		// Doubly adaptive thresholding
+		int contrastBlockSize;
+		double minimumContrast;	// The local standard deviation below which a window is considered flat.
+
+		int maximumHalfBlockSize() const;
+	};
+
 	//////////////////////////////////////////////////////////////////////////////////
 	// Thresholder
 	//
@@ -18,11 +61,19 @@ namespace segment
 	class Thresholder final
 	{
 	public:
-		static cv::Mat threshold(const cv::Mat& originalImage, const traiter::ThreshMethod thresholdingMethod);
+		static cv::Mat threshold(const cv::Mat& originalImage, const traiter::ThreshMethod thresholdingMethod, const ThresholdParameters& parameters = ThresholdParameters());
+
+		static cv::Mat computeDoublyAdaptiveThreshold(const cv::Mat& originalImage, const ThresholdParameters& parameters);
+
+		static ThresholdParameters resolveThresholdValue(const cv::Mat& originalImage, const ThresholdParameters& parameters);
+		static std::vector<long long> computeHistogram(const cv::Mat& originalImage);
+		static std::vector<long long> computeMaskAreas(const std::vector<long long>& histogram);
+		static int selectThresholdValue(const std::vector<long long>& histogram, const ThresholdSelection selection, const int fixedValue);
+		static int computeOtsuThreshold(const std::vector<long long>& histogram);
+		static int computeTriangleThreshold(const std::vector<long long>& histogram);
 	private:
-		static const int thresholdValue = 183;	//TODO_ROBUST: Allow user to alter this value.
 		static const int thresholdType = cv::THRESH_BINARY;
 		static const int maximumThresholdValue = 255;	//TODO_DESIGN: Perhaps this value should be set elsewhere and used here.
-		static const int defaultBlockSize = 19;
+		static const int levelCount = 256;
 	};
-}
\ No newline at end of file
+}
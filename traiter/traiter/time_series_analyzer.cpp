@@ -0,0 +1,384 @@
+#include "time_series_analyzer.h"
+#include "general_utilities.h"
+#include "mapped_image.h"
+#include "neighborhood_code.h"
+#include "ocv_utilities.h"
+#include "profiler.h"
+#include "root_system.h"
+#include "skeleton_graph.h"
+#include "skeletonizer.h"
+#include "thresholder.h"
+#include "trait_table.h"
+#include "workspace.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace cv;
+using namespace std;
+using namespace morph;
+using namespace segment;
+using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// TimeSeriesAnalyzer::TimeSeriesAnalyzer()
+//
+// Constructor to specify how the frames are thresholded. The skeleton method of
+// the options is ignored, since only the distance transform skeleton can be
+// updated a band at a time.
+//////////////////////////////////////////////////////////////////////////////////
+TimeSeriesAnalyzer::TimeSeriesAnalyzer(const AnalysisOptions& analysisOptions)
+	: _analysisOptions(analysisOptions), _graphIsCurrent(false), _previousHalo(0), _recomputedRowCount(0)
+{
+	_buildsGraph = (TraitTable::collectDependencies(analysisOptions.traits) & SKELETON_GRAPH_DEPENDENCY) != 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// addFrame()
+//
+// Computes the root system of the next frame, reusing everything the previous
+// frame left unchanged. A frame of a different size than the previous one is
+// processed from scratch. The statistics of the skeleton graph are left at -1
+// unless a selected trait reads them. Returns null and sets error if the frame
+// is not an 8-bit grayscale image.
+//////////////////////////////////////////////////////////////////////////////////
+unique_ptr<RootSystem> TimeSeriesAnalyzer::addFrame(const Mat& image, string& error)
+{
+	TRAITER_PROFILE_SCOPE("TimeSeriesAnalyzer::addFrame");
+
+	if (image.empty() || image.type() != CV_8UC1)
+	{
+		error = "frames must be 8-bit grayscale images";
+		return nullptr;
+	}
+
+	Mat network = Thresholder::threshold(image, _analysisOptions.threshMethod, _analysisOptions.thresholdParameters);
+	const vector<Point> contour = OcvUtilities::keepOnlyLargestContour(network);
+
+	if (network.size() != _network.size())
+		reset(network.size());	// Every row of the new frame then differs from the empty previous one.
+
+	vector<int> changedRows;
+
+	for (int row = 0; row < network.rows; ++row)
+	{
+		if (memcmp(network.ptr<uchar>(row), _network.ptr<uchar>(row), network.cols) == 0)
+			continue;
+
+		changedRows.push_back(row);
+		updateRow(network, row);
+	}
+
+	// Distances may change as far from a changed row as the largest radius before or after the change.
+	const int currentHalo = computeHalo();
+	const int halo = max(currentHalo, _previousHalo);
+	const int bandSeparation = 4 * halo + 6;	// Bands closer than this would recompute overlapping rows.
+
+	_recomputedRowCount = 0;
+
+	for (size_t first = 0; first < changedRows.size();)
+	{
+		size_t last = first;
+
+		while (last + 1 < changedRows.size() && changedRows[last + 1] - changedRows[last] <= bandSeparation)
+			++last;
+
+		updateBand(network, changedRows[first], changedRows[last], halo);
+		first = last + 1;
+	}
+
+	TRAITER_PROFILE_COUNT("rows_recomputed", _recomputedRowCount);
+
+	_network = network;
+	_previousHalo = currentHalo;
+
+	updateTotals(contour);
+
+	return unique_ptr<RootSystem>(new RootSystem(_statistics));
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// process()
+//
+// Computes the traits of every frame, in order. Frames that cannot be read are
+// reported with an error, and the next frame is compared with the last frame
+// that could be read. If profile is true, the timers and counters of each frame
+// are recorded in its result.
+//////////////////////////////////////////////////////////////////////////////////
+vector<TraitResult> TimeSeriesAnalyzer::process(const vector<string>& imagePaths, const bool profile)
+{
+	vector<TraitResult> results(imagePaths.size());
+
+	Workspace workspace;
+	WorkspaceScope workspaceScope(&workspace);
+
+	for (size_t frame = 0; frame < imagePaths.size(); ++frame)
+	{
+		TraitResult& result = results[frame];
+		result.imagePath = imagePaths[frame];
+		result.succeeded = false;
+
+		ProfileScope profileScope(profile ? &result.profile : nullptr);
+
+		try
+		{
+			if (!GeneralUtilities::fileExists(result.imagePath))
+			{
+				result.error = "file does not exist";
+				continue;
+			}
+
+			MappedImage mapping;
+			const Mat image = MappedImage::load(result.imagePath, mapping, result.error);
+
+			if (image.empty())
+				continue;
+
+			unique_ptr<RootSystem> rootSystem = addFrame(image, result.error);
+
+			if (!rootSystem)
+				continue;
+
+			for (const TraitDescriptor& trait : _analysisOptions.traits)
+				result.values.push_back(rootSystem->computeTrait(trait));
+
+			result.succeeded = true;
+		}
+		catch (const exception& e)
+		{
+			result.values.clear();
+			result.error = e.what();
+		}
+	}
+
+	return results;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// recomputedRowCount()
+//
+// Returns how many rows the last frame had to reskeletonize.
+//////////////////////////////////////////////////////////////////////////////////
+int TimeSeriesAnalyzer::recomputedRowCount() const
+{
+	return _recomputedRowCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// reset()
+//
+// Forgets the previous frame, and starts over from an empty frame of the
+// specified size.
+//////////////////////////////////////////////////////////////////////////////////
+void TimeSeriesAnalyzer::reset(const Size size)
+{
+	_network = Mat::zeros(size, CV_8UC1);
+	_radiusMap = Mat::zeros(size, CV_32FC1);
+	_skeleton = BitMask(size.height, size.width);
+
+	_statistics = RootSystemStatistics();
+	_statistics.numberOfRootsInRows.assign(size.height, 0);
+	_statistics.networkAreaInRows.assign(size.height, 0);
+
+	_perimeterInRows.assign(size.height, 0);
+	_skeletonPixelsInRows.assign(size.height, 0);
+	_radiusSumInRows.assign(size.height, 0);
+	_squaredRadiusSumInRows.assign(size.height, 0);
+	_longestRunInRows.assign(size.height, 0);
+	_firstColumnInRows.assign(size.height, -1);
+	_lastColumnInRows.assign(size.height, -1);
+
+	_graphIsCurrent = false;
+	_previousHalo = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// updateRow()
+//
+// Recounts the roots, area, longest run and first and last network column of a
+// row that changed.
+//////////////////////////////////////////////////////////////////////////////////
+void TimeSeriesAnalyzer::updateRow(const Mat& network, const int row)
+{
+	const uchar* networkRow = network.ptr<uchar>(row);
+
+	int numberOfRoots = 0;
+	long long area = 0;
+	int longestRun = 0;
+	int currentRun = 0;
+	int firstColumn = -1;
+	int lastColumn = -1;
+
+	for (int col = 0; col < network.cols; ++col)
+	{
+		if (networkRow[col] == 0)
+		{
+			currentRun = 0;
+			continue;
+		}
+
+		if (currentRun == 0)
+			++numberOfRoots;
+
+		if (firstColumn < 0)
+			firstColumn = col;
+		lastColumn = col;
+
+		++area;
+		longestRun = max(longestRun, ++currentRun);
+	}
+
+	_statistics.numberOfRootsInRows[row] = numberOfRoots;
+	_statistics.networkAreaInRows[row] = area;
+	_longestRunInRows[row] = longestRun;
+	_firstColumnInRows[row] = firstColumn;
+	_lastColumnInRows[row] = lastColumn;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// updateBand()
+//
+// Recomputes the perimeter and skeleton of the rows that a change to rows
+// [firstRow, lastRow] can affect.
+//
+// A border pixel depends on the rows beside it, so one row more is recounted on
+// each side. The distance of a pixel to the background can only change if the
+// change is within its radius, which is at most halo, and whether it is on the
+// skeleton also depends on the radii of the rows beside it. The distance
+// transform is computed over a band wide enough that the rows whose skeleton is
+// replaced are not affected by the band being cut off from the rest of the
+// image.
+//////////////////////////////////////////////////////////////////////////////////
+void TimeSeriesAnalyzer::updateBand(const Mat& network, const int firstRow, const int lastRow, const int halo)
+{
+	TRAITER_PROFILE_SCOPE("TimeSeriesAnalyzer::updateBand");
+
+	const int rows = network.rows;
+
+	const int codesFirstRow = max(firstRow - 2, 0);
+	const int codesLastRow = min(lastRow + 2, rows - 1);
+	const Mat codes = NeighborhoodCode::computeNeighborhoodCodes(network.rowRange(codesFirstRow, codesLastRow + 1), true);
+
+	for (int row = max(firstRow - 1, 0); row <= min(lastRow + 1, rows - 1); ++row)
+		_perimeterInRows[row] = NeighborhoodCode::countBorderPixels(network.row(row), codes.row(row - codesFirstRow));
+
+	const int skeletonFirstRow = max(firstRow - halo - 1, 0);
+	const int skeletonLastRow = min(lastRow + halo + 1, rows - 1);
+	const int bandFirstRow = max(firstRow - 2 * halo - 3, 0);
+	const int bandLastRow = min(lastRow + 2 * halo + 3, rows - 1);
+
+	Mat bandRadiusMap;
+	const Mat bandSkeleton = Skeletonizer::computeDistanceTransformSkeleton(network.rowRange(bandFirstRow, bandLastRow + 1), bandRadiusMap);
+
+	for (int row = skeletonFirstRow; row <= skeletonLastRow; ++row)
+	{
+		const float* radii = bandRadiusMap.ptr<float>(row - bandFirstRow);
+		const uchar* skeletonRow = bandSkeleton.ptr<uchar>(row - bandFirstRow);
+		uint64_t* words = _skeleton.rowWords(row);
+
+		copy(radii, radii + network.cols, _radiusMap.ptr<float>(row));
+		fill(words, words + _skeleton.wordsPerRow(), static_cast<uint64_t>(0));
+
+		long long skeletonPixels = 0;
+		double radiusSum = 0;
+		double squaredRadiusSum = 0;
+
+		for (int col = 0; col < network.cols; ++col)
+		{
+			if (skeletonRow[col] == 0)
+				continue;
+
+			words[col / 64] |= static_cast<uint64_t>(1) << (col % 64);
+
+			++skeletonPixels;
+			radiusSum += radii[col];
+			squaredRadiusSum += static_cast<double>(radii[col]) * radii[col];
+		}
+
+		_skeletonPixelsInRows[row] = skeletonPixels;
+		_radiusSumInRows[row] = radiusSum;
+		_squaredRadiusSumInRows[row] = squaredRadiusSum;
+	}
+
+	_recomputedRowCount += bandLastRow - bandFirstRow + 1;
+	_graphIsCurrent = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// updateTotals()
+//
+// Sums the per-row statistics into the totals, and recomputes the statistics of
+// the outline and of the skeleton graph. Summing the rows again, rather than
+// adjusting the totals by what changed, keeps rounding errors from building up
+// over a long series.
+//
+// The graph is rebuilt from the whole skeleton rather than from the bands that
+// changed, so its cost grows with the size of the skeleton, not of the change.
+// It is timed and counted on its own in the profile, and skipped when no
+// selected trait reads it or the skeleton did not change.
+//////////////////////////////////////////////////////////////////////////////////
+void TimeSeriesAnalyzer::updateTotals(const vector<Point>& contour)
+{
+	TRAITER_PROFILE_SCOPE("TimeSeriesAnalyzer::updateTotals");
+
+	long long networkArea = 0;
+	long long perimeter = 0;
+	long long skeletonPixels = 0;
+	double radiusSum = 0;
+	double squaredRadiusSum = 0;
+
+	for (size_t row = 0; row < _perimeterInRows.size(); ++row)
+	{
+		networkArea += _statistics.networkAreaInRows[row];
+		perimeter += _perimeterInRows[row];
+		skeletonPixels += _skeletonPixelsInRows[row];
+		radiusSum += _radiusSumInRows[row];
+		squaredRadiusSum += _squaredRadiusSumInRows[row];
+	}
+
+	_statistics.networkArea = static_cast<double>(networkArea);
+	_statistics.perimeter = static_cast<double>(perimeter);
+	_statistics.networkLength = static_cast<double>(skeletonPixels);
+	_statistics.skeletonRadiusSum = radiusSum;
+	_statistics.skeletonSquaredRadiusSum = squaredRadiusSum;
+
+	const RootSystemStatistics defaults;	// An empty frame has no outline to measure.
+	_statistics.networkDepth = defaults.networkDepth;
+	_statistics.networkWidth = defaults.networkWidth;
+	_statistics.convexArea = defaults.convexArea;
+	_statistics.bestFittingEllipse = defaults.bestFittingEllipse;
+
+	RootSystem::computeExtents(_firstColumnInRows, _lastColumnInRows, _statistics);
+	RootSystem::computeConvexArea(_firstColumnInRows, _lastColumnInRows, _statistics);
+	RootSystem::computeBestFittingEllipse(contour, _statistics);
+
+	if (_buildsGraph && !_graphIsCurrent)
+	{
+		TRAITER_PROFILE_SCOPE("TimeSeriesAnalyzer::rebuildSkeletonGraph");
+
+		// The graph needs a one pixel wide skeleton, which the distance transform
+		// skeleton is not, so it is built from the thinned network, as RootSystem does.
+		const BitMask thinnedSkeleton(Skeletonizer::computeThinnedSkeleton(_network));
+		TRAITER_PROFILE_COUNT("graph_skeleton_pixels", thinnedSkeleton.area());
+
+		RootSystem::computeGraphStatistics(SkeletonGraph(thinnedSkeleton, _radiusMap), _statistics);
+		_graphIsCurrent = true;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeHalo()
+//
+// Returns a bound on the distance from any network pixel of the current frame
+// to the background. A pixel is no further from the background than from the
+// nearer end of its run, so half of the longest run bounds it.
+//////////////////////////////////////////////////////////////////////////////////
+int TimeSeriesAnalyzer::computeHalo() const
+{
+	int longestRun = 0;
+
+	for (const int run : _longestRunInRows)
+		longestRun = max(longestRun, run);
+
+	return (longestRun + 1) / 2 + 1;
+}
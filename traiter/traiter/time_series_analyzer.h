@@ -0,0 +1,77 @@
+#pragma once
+
+#include "bit_mask.h"
+#include "image_analyzer.h"
+#include "root_system_statistics.h"
+#include "trait_writer.h"
+#include <opencv2/core/core.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	class RootSystem;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// TimeSeriesAnalyzer
+	//
+	// Computes the traits of successive frames of the same plant. The network,
+	// skeleton, radius map and per-row statistics of the previous frame are kept,
+	// and each new frame is compared with them row by row. Only the bands of rows
+	// around the rows that changed are reskeletonized and recounted, so the cost of
+	// a frame beyond thresholding it and finding its outline grows with how much of
+	// it changed.
+	//
+	// The skeleton graph is the exception: a branch can run far beyond the rows
+	// that changed, so whenever the network changed, the whole network is thinned
+	// again and the graph rebuilt from that skeleton. That is only done if a
+	// selected trait reads the graph.
+	//
+	// Like streaming, this uses DISTANCE_TRANSFORM_SKELETON, which is the only
+	// skeleton whose pixels depend on a bounded neighborhood. The traits match a
+	// RootSystem built from each frame on its own with that skeleton.
+	//////////////////////////////////////////////////////////////////////////////////
+	class TimeSeriesAnalyzer final
+	{
+	public:
+		explicit TimeSeriesAnalyzer(const AnalysisOptions& analysisOptions);
+
+		std::unique_ptr<RootSystem> addFrame(const cv::Mat& image, std::string& error);
+		std::vector<TraitResult> process(const std::vector<std::string>& imagePaths, const bool profile = false);
+
+		int recomputedRowCount() const;
+	private:
+		TimeSeriesAnalyzer();
+
+		void reset(const cv::Size size);
+		void updateRow(const cv::Mat& network, const int row);
+		void updateBand(const cv::Mat& network, const int firstRow, const int lastRow, const int halo);
+		void updateTotals(const std::vector<cv::Point>& contour);
+
+		int computeHalo() const;
+
+		AnalysisOptions _analysisOptions;
+
+		cv::Mat _network;	// The largest component of the previous frame.
+		cv::Mat _radiusMap;
+		BitMask _skeleton;
+
+		RootSystemStatistics _statistics;
+
+		// Per-row statistics that the totals are summed from
+		std::vector<long long> _perimeterInRows;
+		std::vector<long long> _skeletonPixelsInRows;
+		std::vector<double> _radiusSumInRows;
+		std::vector<double> _squaredRadiusSumInRows;
+		std::vector<int> _longestRunInRows;
+		std::vector<int> _firstColumnInRows;	// The first network column of each row, or -1.
+		std::vector<int> _lastColumnInRows;
+
+		bool _buildsGraph;	// True if a selected trait reads the skeleton graph.
+		bool _graphIsCurrent;	// False once the skeleton changed after the graph was last built.
+
+		int _previousHalo;
+		int _recomputedRowCount;
+	};
+}
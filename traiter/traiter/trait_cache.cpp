@@ -0,0 +1,360 @@
+#include "trait_cache.h"
+#include "general_utilities.h"
+#include "profiler.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <process.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace traiter;
+using namespace utility;
+
+namespace
+{
+	// Bump whenever a change to the analysis alters any trait value, so that
+	// entries written by earlier versions are no longer used.
+	const int TRAIT_CACHE_VERSION = 1;
+
+	const char* const ENTRY_EXTENSION = ".traits";
+	const char* const LOCK_EXTENSION = ".lock";
+
+	// Numbers the temporary files of this process, so that workers never write to the same one.
+	atomic<unsigned int> nextTemporaryFile(0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// TraitCache::TraitCache()
+//
+// Constructor to specify the directory the entries are kept in, and the options
+// every image is analyzed with. An empty directory disables the cache.
+//////////////////////////////////////////////////////////////////////////////////
+TraitCache::TraitCache(const string& directory, const AnalysisOptions& options)
+	: _directory(directory), _options(describeOptions(options))
+{
+	_optionsHash = hashBytes(_options.data(), _options.size(), mix(TRAIT_CACHE_VERSION));	// Entries of another version are never even opened.
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// isEnabled()
+//
+// Returns true if a cache directory was given.
+//////////////////////////////////////////////////////////////////////////////////
+bool TraitCache::isEnabled() const
+{
+	return !_directory.empty();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// computeKey()
+//
+// Computes the key of the entry for the specified image, from every byte of the
+// file and the analysis options. The file is read rather than decoded, since its
+// bytes determine its pixels. Returns false if the file could not be read.
+//////////////////////////////////////////////////////////////////////////////////
+bool TraitCache::computeKey(const string& imagePath, string& key) const
+{
+	TRAITER_PROFILE_SCOPE("TraitCache::computeKey");
+
+	ifstream file(imagePath.c_str(), ios::binary);
+
+	if (!file)
+		return false;
+
+	const size_t BUFFER_SIZE = 1 << 20;
+	vector<char> buffer(BUFFER_SIZE);
+	uint64_t contentHash = 0;
+	uint64_t length = 0;
+
+	while (file)
+	{
+		file.read(buffer.data(), buffer.size());
+		const size_t bytesRead = static_cast<size_t>(file.gcount());
+
+		contentHash = hashBytes(buffer.data(), bytesRead, contentHash);
+		length += bytesRead;
+	}
+
+	if (file.bad())
+		return false;
+
+	contentHash = mix(contentHash ^ length);
+
+	ostringstream stream;
+	stream << hex << setfill('0') << setw(16) << contentHash << setw(16) << _optionsHash;
+	key = stream.str();
+
+	TRAITER_PROFILE_COUNT("bytes_hashed", length);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// load()
+//
+// Reads every trait value stored under the specified key, by trait name. Returns
+// false if there is no entry, or if it was written with other options or
+// another cache version.
+//////////////////////////////////////////////////////////////////////////////////
+bool TraitCache::load(const string& key, map<string, double>& values) const
+{
+	return loadEntry(getEntryPath(key), values);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// loadEntry()
+//
+// Reads every trait value stored in the entry at the specified path, by trait
+// name. Returns false if it does not exist or cannot be used.
+//////////////////////////////////////////////////////////////////////////////////
+bool TraitCache::loadEntry(const string& entryPath, map<string, double>& values) const
+{
+	ifstream entry(entryPath.c_str());
+	int version = 0;
+	string options;
+
+	if (!(entry >> version) || version != TRAIT_CACHE_VERSION || !entry.ignore(1) || !getline(entry, options) || options != _options)
+		return false;
+
+	map<string, double> storedValues;
+	string name;
+	uint64_t bits = 0;
+
+	while (entry >> name >> hex >> bits)
+	{
+		double value = 0;
+		memcpy(&value, &bits, sizeof(value));	// Values are stored as their bits, so they round trip exactly.
+		storedValues[name] = value;
+	}
+
+	if (!entry.eof())
+		return false;	// The entry is damaged.
+
+	values.swap(storedValues);
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// store()
+//
+// Adds the trait values to the entry under the specified key, keeping the values
+// of other traits that it already holds. Failures are ignored, since the values
+// can always be computed again.
+//
+// The entry is read, merged and replaced while holding a lock on a file next to
+// it, so that two workers that add different traits to the same entry, even from
+// separate processes, do not lose each other's values. The operating system
+// releases the lock if a process dies holding it.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitCache::store(const string& key, const map<string, double>& values) const
+{
+#if defined(_WIN32)
+	const int processId = _getpid();
+#else
+	const int processId = static_cast<int>(getpid());
+#endif
+
+	const string entryPath = getEntryPath(key);
+	const string lockPath = entryPath + LOCK_EXTENSION;
+
+#if defined(_WIN32)
+	const HANDLE lock = CreateFileA(lockPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	OVERLAPPED lockRange = {};
+
+	if (lock == INVALID_HANDLE_VALUE)
+		return;
+
+	if (!LockFileEx(lock, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &lockRange))
+	{
+		CloseHandle(lock);
+		return;
+	}
+#else
+	const int lock = ::open(lockPath.c_str(), O_RDWR | O_CREAT, 0666);
+
+	if (lock < 0)
+		return;
+
+	if (flock(lock, LOCK_EX) != 0)
+	{
+		::close(lock);
+		return;
+	}
+#endif
+
+	writeEntry(entryPath, values, processId);
+
+#if defined(_WIN32)
+	UnlockFileEx(lock, 0, 1, 0, &lockRange);
+	CloseHandle(lock);
+#else
+	::close(lock);
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeEntry()
+//
+// Merges the trait values into the entry at the specified path and replaces it.
+// Called with the lock of the entry held.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitCache::writeEntry(const string& entryPath, const map<string, double>& values, const int processId) const
+{
+	map<string, double> mergedValues;
+	loadEntry(entryPath, mergedValues);
+
+	for (const pair<const string, double>& value : values)
+		mergedValues[value.first] = value.second;
+
+	ostringstream temporaryPath;
+	temporaryPath << entryPath << "." << processId << "." << nextTemporaryFile++ << ".tmp";
+
+	{
+		ofstream entry(temporaryPath.str().c_str());
+		entry << TRAIT_CACHE_VERSION << "\n" << _options << "\n";
+
+		for (const pair<const string, double>& value : mergedValues)
+		{
+			uint64_t bits = 0;
+			memcpy(&bits, &value.second, sizeof(bits));
+
+			entry << value.first << " " << hex << setfill('0') << setw(16) << bits << "\n";
+		}
+
+		if (!entry.flush())
+		{
+			entry.close();
+			remove(temporaryPath.str().c_str());
+			return;
+		}
+	}
+
+	// Renaming is atomic, so readers see either the old entry or the new one. The
+	// C runtime's rename() will not replace an existing file on Windows, so the
+	// entry is moved over the old one there instead.
+#if defined(_WIN32)
+	const bool renamed = MoveFileExA(temporaryPath.str().c_str(), entryPath.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	const bool renamed = rename(temporaryPath.str().c_str(), entryPath.c_str()) == 0;
+#endif
+
+	if (!renamed)
+		remove(temporaryPath.str().c_str());
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// prepareDirectory()
+//
+// Creates the cache directory if it does not exist yet. Returns false and sets
+// error if it could not be created.
+//////////////////////////////////////////////////////////////////////////////////
+bool TraitCache::prepareDirectory(const string& directory, string& error)
+{
+	if (!GeneralUtilities::createDirectory(directory))
+	{
+		error = "Could not create the cache directory " + directory;
+		return false;
+	}
+
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getEntryPath()
+//
+// Returns the path of the entry with the specified key.
+//////////////////////////////////////////////////////////////////////////////////
+string TraitCache::getEntryPath(const string& key) const
+{
+	return _directory + "/" + key + ENTRY_EXTENSION;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// describeOptions()
+//
+// Returns a line describing every option that affects the trait values. The
+// selected traits are not part of it, since each value is stored by name. It is
+// stored in each entry, so that two sets of options whose hashes collide are
+// still told apart.
+//////////////////////////////////////////////////////////////////////////////////
+string TraitCache::describeOptions(const AnalysisOptions& options)
+{
+	const segment::ThresholdParameters& parameters = options.thresholdParameters;
+
+	ostringstream stream;
+	stream << setprecision(17)
+		<< "threshold=" << options.threshMethod
+		<< " threshold_value=" << parameters.thresholdValue
+		<< " threshold_selection=" << parameters.thresholdSelection
+		<< " block_size=" << parameters.blockSize
+		<< " offset=" << parameters.offset
+		<< " contrast_block_size=" << parameters.contrastBlockSize
+		<< " minimum_contrast=" << parameters.minimumContrast
+		<< " skeleton=" << options.skeletonMethod
+		<< " streamed=" << (options.stripRows > 0 ? 1 : 0);	// The strip height itself does not change the traits.
+
+	return stream.str();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// hashBytes()
+//
+// Folds the specified bytes into a running 64-bit hash, eight bytes at a time.
+// Chunks are hashed independently of where they were split, as long as every
+// chunk but the last is a multiple of eight bytes long.
+//////////////////////////////////////////////////////////////////////////////////
+uint64_t TraitCache::hashBytes(const void* data, const size_t length, uint64_t hash)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	size_t position = 0;
+
+	for (; position + 8 <= length; position += 8)
+	{
+		uint64_t word = 0;
+		memcpy(&word, bytes + position, sizeof(word));
+
+		hash = (hash ^ (word * 0x9E3779B97F4A7C15ull)) * 0xBF58476D1CE4E5B9ull;
+		hash ^= hash >> 31;
+	}
+
+	if (position < length)
+	{
+		uint64_t word = 0;
+		memcpy(&word, bytes + position, length - position);
+
+		hash = mix(hash ^ word);
+	}
+
+	return hash;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// mix()
+//
+// Scrambles every bit of the hash into every other bit (the SplitMix64
+// finalizer).
+//////////////////////////////////////////////////////////////////////////////////
+uint64_t TraitCache::mix(uint64_t hash)
+{
+	hash ^= hash >> 30;
+	hash *= 0xBF58476D1CE4E5B9ull;
+	hash ^= hash >> 27;
+	hash *= 0x94D049BB133111EBull;
+	hash ^= hash >> 31;
+
+	return hash;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "image_analyzer.h"
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// TraitCache
+	//
+	// An on-disk cache of the traits of images that were already analyzed. Each
+	// entry is named after a hash of the bytes of the image file and of the options
+	// it was analyzed with, so a rerun only analyzes images that changed, and any
+	// change to the options or the cache version misses. An entry holds the value
+	// of each trait by name, so a run that selects other traits reuses the ones
+	// already stored and adds the rest to the entry.
+	//
+	// Entries are written to a temporary file and then renamed into place, so
+	// workers that share a cache, even from separate processes, only ever see
+	// complete entries. Workers that update the same entry take turns, so no
+	// update is lost.
+	//////////////////////////////////////////////////////////////////////////////////
+	class TraitCache final
+	{
+	public:
+		TraitCache(const std::string& directory, const AnalysisOptions& options);
+
+		bool isEnabled() const;
+
+		bool computeKey(const std::string& imagePath, std::string& key) const;
+		bool load(const std::string& key, std::map<std::string, double>& values) const;
+		void store(const std::string& key, const std::map<std::string, double>& values) const;
+
+		static bool prepareDirectory(const std::string& directory, std::string& error);
+	private:
+		TraitCache();
+
+		std::string getEntryPath(const std::string& key) const;
+		bool loadEntry(const std::string& entryPath, std::map<std::string, double>& values) const;
+		void writeEntry(const std::string& entryPath, const std::map<std::string, double>& values, const int processId) const;
+
+		static std::string describeOptions(const AnalysisOptions& options);
+		static uint64_t hashBytes(const void* data, const size_t length, uint64_t hash);
+		static uint64_t mix(uint64_t hash);
+
+		std::string _directory;	// Empty if the cache is disabled.
+		std::string _options;
+		uint64_t _optionsHash;
+	};
+}
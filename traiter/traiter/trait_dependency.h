@@ -0,0 +1,36 @@
+#pragma once
+
+namespace traiter
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// TraitDependency
+	//
+	// The intermediate results a trait is computed from. They are flags, so that a
+	// trait can depend on several, and each is only built by RootSystem the first
+	// time a trait that depends on it is computed.
+	//////////////////////////////////////////////////////////////////////////////////
+	enum TraitDependency
+	{
+		// The thresholded largest component, which is always built
+		MASK_DEPENDENCY = 1 << 0,
+		// The number of roots, the network area and the first and last pixel of
+		// each row, and the extents found from them
+		ROW_PROFILE_DEPENDENCY = 1 << 1,
+		// The number of network pixels that touch the background
+		BORDER_DEPENDENCY = 1 << 2,
+		// The outer contour of the network
+		CONTOUR_DEPENDENCY = 1 << 3,
+		// The convex hull of the first and last pixel of each row
+		HULL_DEPENDENCY = 1 << 4,
+		// The ellipse that best fits the contour
+		ELLIPSE_DEPENDENCY = 1 << 5,
+		// The skeleton of the network
+		SKELETON_DEPENDENCY = 1 << 6,
+		// The root radius at every skeleton pixel
+		RADIUS_MAP_DEPENDENCY = 1 << 7,
+		// The tips, junctions and branches of the skeleton
+		SKELETON_GRAPH_DEPENDENCY = 1 << 8,
+
+		ALL_DEPENDENCIES = (1 << 9) - 1
+	};
+}
@@ -0,0 +1,99 @@
+#include "trait_table.h"
+#include "root_system.h"
+
+using namespace std;
+using namespace traiter;
+
+namespace
+{
+	// Builds the table while the program starts, on a single thread, since Visual
+	// C++ 2013 does not make the initialization of a local static thread-safe.
+	const vector<TraitDescriptor>& startupTraits = TraitTable::getTraits();
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// getTraits()
+//
+// Returns the descriptors of every trait, in output order. The table is built
+// the first time it is asked for, so it can be used to initialize other static
+// objects, such as default arguments, in any translation unit.
+//////////////////////////////////////////////////////////////////////////////////
+const vector<TraitDescriptor>& TraitTable::getTraits()
+{
+	static const vector<TraitDescriptor> traits = buildTraits();
+
+	return traits;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// findTrait()
+//
+// Returns the descriptor of the trait with the specified machine-readable name,
+// or null if there is no such trait.
+//////////////////////////////////////////////////////////////////////////////////
+const TraitDescriptor* TraitTable::findTrait(const string& name)
+{
+	for (const TraitDescriptor& trait : getTraits())
+	{
+		if (trait.name == name)
+			return &trait;
+	}
+
+	return nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// collectDependencies()
+//
+// Returns the TraitDependency flags of every intermediate result that the
+// specified traits read.
+//////////////////////////////////////////////////////////////////////////////////
+int TraitTable::collectDependencies(const vector<TraitDescriptor>& traits)
+{
+	int dependencies = 0;
+
+	for (const TraitDescriptor& trait : traits)
+		dependencies |= trait.dependencies;
+
+	return dependencies;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// buildTraits()
+//
+// Builds the list of trait descriptors. Traits are reported in the order they
+// are listed here. A trait only lists the results it reads itself; the results
+// those are built from are added by RootSystem.
+//////////////////////////////////////////////////////////////////////////////////
+vector<TraitDescriptor> TraitTable::buildTraits()
+{
+	TraitDescriptor descriptors[] =
+	{
+		{ "network_area", "Network area", "pixels", &RootSystem::networkArea, ROW_PROFILE_DEPENDENCY },
+		{ "perimeter", "Perimeter", "pixels", &RootSystem::perimeter, BORDER_DEPENDENCY },
+		{ "convex_area", "Convex area", "pixels", &RootSystem::convexArea, HULL_DEPENDENCY },
+		{ "network_depth", "Network depth", "pixels", &RootSystem::networkDepth, ROW_PROFILE_DEPENDENCY },
+		{ "network_width", "Network width", "pixels", &RootSystem::networkWidth, ROW_PROFILE_DEPENDENCY },
+		{ "major_axis", "Major axis", "pixels", &RootSystem::majorAxis, ELLIPSE_DEPENDENCY },
+		{ "minor_axis", "Minor axis", "pixels", &RootSystem::minorAxis, ELLIPSE_DEPENDENCY },
+		{ "aspect_ratio", "Aspect ratio", "", &RootSystem::aspectRatio, ELLIPSE_DEPENDENCY },
+		{ "network_solidity", "Network solidity", "", &RootSystem::networkSolidity, ROW_PROFILE_DEPENDENCY | HULL_DEPENDENCY },
+		{ "network_width_to_depth_ratio", "Network width to depth ratio", "", &RootSystem::networkWidthToDepthRatio, ROW_PROFILE_DEPENDENCY },
+		{ "median_number_of_roots", "Median number of roots", "", &RootSystem::medianNumberOfRoots, ROW_PROFILE_DEPENDENCY },
+		{ "maximum_number_of_roots", "Maximum number of roots", "", &RootSystem::maximumNumberOfRoots, ROW_PROFILE_DEPENDENCY },
+		{ "bushiness", "Bushiness", "", &RootSystem::bushiness, ROW_PROFILE_DEPENDENCY },
+		{ "network_length_distribution", "Network length distribution", "", &RootSystem::networkLengthDistribution, ROW_PROFILE_DEPENDENCY },
+		{ "network_length", "Network length", "pixels", &RootSystem::networkLength, SKELETON_DEPENDENCY },
+		{ "average_root_width", "Average root width", "pixels", &RootSystem::averageRootWidth, RADIUS_MAP_DEPENDENCY },
+		{ "network_surface_area", "Network surface area", "pixels^2", &RootSystem::networkSurfaceArea, RADIUS_MAP_DEPENDENCY },
+		{ "network_volume", "Network volume", "pixels^3", &RootSystem::networkVolume, RADIUS_MAP_DEPENDENCY },
+		{ "specific_root_length", "Specific root length", "pixels^-2", &RootSystem::specificRootLength, RADIUS_MAP_DEPENDENCY },
+		{ "number_of_tips", "Number of tips", "", &RootSystem::numberOfTips, SKELETON_GRAPH_DEPENDENCY },
+		{ "number_of_branches", "Number of branches", "", &RootSystem::numberOfBranches, SKELETON_GRAPH_DEPENDENCY },
+		{ "median_branch_length", "Median branch length", "pixels", &RootSystem::medianBranchLength, SKELETON_GRAPH_DEPENDENCY },
+		{ "average_branch_length", "Average branch length", "pixels", &RootSystem::averageBranchLength, SKELETON_GRAPH_DEPENDENCY },
+		{ "weighted_network_length", "Weighted network length", "pixels", &RootSystem::weightedNetworkLength, SKELETON_GRAPH_DEPENDENCY }
+	};
+
+	return vector<TraitDescriptor>(begin(descriptors), end(descriptors));
+}
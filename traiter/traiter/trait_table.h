@@ -0,0 +1,43 @@
+#pragma once
+
+#include "trait_dependency.h"
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	class RootSystem;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// TraitDescriptor
+	//
+	// Describes a single trait: the name used in machine-readable output, the name
+	// shown to the user, its units, the RootSystem method that computes it and the
+	// intermediate results that method reads.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct TraitDescriptor
+	{
+		std::string name;
+		std::string displayName;
+		std::string units;
+		double (RootSystem::*compute)();
+		int dependencies;	// The TraitDependency flags that RootSystem builds before computing the trait.
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// TraitTable
+	//
+	// The list of every trait that traiter reports, in output order.
+	//////////////////////////////////////////////////////////////////////////////////
+	class TraitTable final
+	{
+	public:
+		static const std::vector<TraitDescriptor>& getTraits();
+		static const TraitDescriptor* findTrait(const std::string& name);
+		static int collectDependencies(const std::vector<TraitDescriptor>& traits);
+	private:
+		static std::vector<TraitDescriptor> buildTraits();
+
+		TraitTable();
+	};
+}
@@ -0,0 +1,236 @@
+#include "trait_writer.h"
+#include "output_format.h"
+#include "trait_table.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+using namespace traiter;
+
+//////////////////////////////////////////////////////////////////////////////////
+// write()
+//
+// Writes the results to the stream in the specified format. Results are
+// written in the order they are given, and each has a value for each of the
+// specified traits.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitWriter::write(ostream& stream, const vector<TraitResult>& results, const vector<TraitDescriptor>& traits, const OutputFormat format)
+{
+	const streamsize originalPrecision = stream.precision(10);	// Areas of large scans need more than the default six significant digits.
+
+	switch (format)
+	{
+	case CSV_OUTPUT:
+		writeCsv(stream, results, traits);
+		break;
+	case JSON_OUTPUT:
+		writeJson(stream, results, traits);
+		break;
+	}
+
+	stream.precision(originalPrecision);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeProfiles()
+//
+// Writes a JSON array with the timers and counters recorded for each image.
+// Timer values are the total seconds spent in each scope and how many times it
+// was entered.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitWriter::writeProfiles(ostream& stream, const vector<TraitResult>& results)
+{
+	const streamsize originalPrecision = stream.precision(10);
+
+	stream << "[";
+
+	for (size_t resultIndex = 0; resultIndex < results.size(); ++resultIndex)
+	{
+		const TraitResult& result = results[resultIndex];
+
+		stream << (resultIndex == 0 ? "\n" : ",\n");
+		stream << "  { \"image\": \"" << escapeJson(result.imagePath) << "\", \"timers\": {";
+
+		bool first = true;
+
+		for (const auto& timer : result.profile.timers())
+		{
+			stream << (first ? " " : ", ") << "\"" << escapeJson(timer.first) << "\": { \"seconds\": " << timer.second.seconds << ", \"calls\": " << timer.second.calls << " }";
+			first = false;
+		}
+
+		stream << " }, \"counters\": {";
+
+		first = true;
+
+		for (const auto& counter : result.profile.counters())
+		{
+			stream << (first ? " " : ", ") << "\"" << escapeJson(counter.first) << "\": " << counter.second;
+			first = false;
+		}
+
+		stream << " } }";
+	}
+
+	stream << "\n]\n";
+
+	stream.precision(originalPrecision);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeCsv()
+//
+// Writes a header row followed by one row per image. The trait columns of an
+// image that could not be processed are left empty.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitWriter::writeCsv(ostream& stream, const vector<TraitResult>& results, const vector<TraitDescriptor>& traits)
+{
+	stream << "image,error";
+	for (const TraitDescriptor& trait : traits)
+		stream << "," << trait.name;
+	stream << "\n";
+
+	for (const TraitResult& result : results)
+	{
+		stream << escapeCsv(result.imagePath) << "," << escapeCsv(result.error);
+
+		for (size_t i = 0; i < traits.size(); ++i)
+		{
+			stream << ",";
+
+			if (result.succeeded && i < result.values.size() && !std::isnan(result.values[i]))
+				stream << result.values[i];
+		}
+
+		stream << "\n";
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeJson()
+//
+// Writes an array with one object per image. Each object holds the image path
+// and either its traits or the reason it could not be processed.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitWriter::writeJson(ostream& stream, const vector<TraitResult>& results, const vector<TraitDescriptor>& traits)
+{
+	stream << "[";
+
+	for (size_t resultIndex = 0; resultIndex < results.size(); ++resultIndex)
+	{
+		stream << (resultIndex == 0 ? "\n  " : ",\n  ");
+		writeJsonObject(stream, results[resultIndex], traits);
+	}
+
+	stream << "\n]\n";
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeJsonLine()
+//
+// Writes the object of a single image, in the same form as the elements of the
+// JSON output, on one line of its own.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitWriter::writeJsonLine(ostream& stream, const TraitResult& result, const vector<TraitDescriptor>& traits)
+{
+	const streamsize originalPrecision = stream.precision(10);
+
+	writeJsonObject(stream, result, traits);
+	stream << "\n";
+
+	stream.precision(originalPrecision);
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeJsonObject()
+//
+// Writes the object of a single image, which holds the image path and either
+// its traits or the reason it could not be processed.
+//////////////////////////////////////////////////////////////////////////////////
+void TraitWriter::writeJsonObject(ostream& stream, const TraitResult& result, const vector<TraitDescriptor>& traits)
+{
+	stream << "{ \"image\": \"" << escapeJson(result.imagePath) << "\"";
+
+	if (!result.succeeded)
+	{
+		stream << ", \"error\": \"" << escapeJson(result.error) << "\" }";
+		return;
+	}
+
+	stream << ", \"traits\": {";
+
+	for (size_t i = 0; i < traits.size() && i < result.values.size(); ++i)
+	{
+		stream << (i == 0 ? " " : ", ") << "\"" << traits[i].name << "\": ";
+
+		if (std::isfinite(result.values[i]))
+			stream << result.values[i];
+		else
+			stream << "null";	// JSON has no representation for NaN or infinity.
+	}
+
+	stream << " } }";
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// escapeCsv()
+//
+// Quotes the field if it contains a character that has a meaning in CSV.
+//////////////////////////////////////////////////////////////////////////////////
+string TraitWriter::escapeCsv(const string& field)
+{
+	if (field.find_first_of(",\"\r\n") == string::npos)
+		return field;
+
+	string escaped = "\"";
+
+	for (const char character : field)
+	{
+		if (character == '"')
+			escaped += '"';
+		escaped += character;
+	}
+
+	return escaped + "\"";
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// escapeJson()
+//
+// Escapes the characters that may not appear unescaped in a JSON string, such
+// as the backslashes in Windows paths.
+//////////////////////////////////////////////////////////////////////////////////
+string TraitWriter::escapeJson(const string& value)
+{
+	ostringstream escaped;
+
+	for (const char character : value)
+	{
+		switch (character)
+		{
+		case '"':
+			escaped << "\\\"";
+			break;
+		case '\\':
+			escaped << "\\\\";
+			break;
+		case '\n':
+			escaped << "\\n";
+			break;
+		case '\r':
+			escaped << "\\r";
+			break;
+		case '\t':
+			escaped << "\\t";
+			break;
+		default:
+			if (static_cast<unsigned char>(character) < 0x20)
+				escaped << "\\u" << hex << setw(4) << setfill('0') << static_cast<int>(character) << dec;
+			else
+				escaped << character;
+		}
+	}
+
+	return escaped.str();
+}
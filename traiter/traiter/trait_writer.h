@@ -0,0 +1,51 @@
+#pragma once
+
+#include "profiler.h"
+#include "trait_table.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace traiter
+{
+	enum OutputFormat;
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// TraitResult
+	//
+	// The trait values computed for a single image, in the order given by
+	// TraitTable. If the image could not be processed, succeeded is false and
+	// error describes why. The profile is only filled in when profiling was
+	// requested.
+	//////////////////////////////////////////////////////////////////////////////////
+	struct TraitResult
+	{
+		std::string imagePath;
+		bool succeeded;
+		std::string error;
+		std::vector<double> values;
+		utility::Profile profile;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// TraitWriter
+	//
+	// Writes trait results in a machine-readable format.
+	//////////////////////////////////////////////////////////////////////////////////
+	class TraitWriter final
+	{
+	public:
+		static void write(std::ostream& stream, const std::vector<TraitResult>& results, const std::vector<TraitDescriptor>& traits, const OutputFormat format);
+		static void writeJsonLine(std::ostream& stream, const TraitResult& result, const std::vector<TraitDescriptor>& traits);
+		static void writeProfiles(std::ostream& stream, const std::vector<TraitResult>& results);
+	private:
+		static void writeCsv(std::ostream& stream, const std::vector<TraitResult>& results, const std::vector<TraitDescriptor>& traits);
+		static void writeJson(std::ostream& stream, const std::vector<TraitResult>& results, const std::vector<TraitDescriptor>& traits);
+		static void writeJsonObject(std::ostream& stream, const TraitResult& result, const std::vector<TraitDescriptor>& traits);
+
+		static std::string escapeCsv(const std::string& field);
+		static std::string escapeJson(const std::string& value);
+
+		TraitWriter();
+	};
+}
@@ -1,46 +1,356 @@
+#include "analysis_server.h"
+#include "batch_processor.h"
+#include "command_line.h"
 #include "general_utilities.h"
+#include "image_analyzer.h"
+#include "mapped_image.h"
+#include "output_format.h"
+#include "parallel_for.h"
+#include "quick_look.h"
 #include "root_system.h"
+#include "thresholder.h"
+#include "time_series_analyzer.h"
+#include "trait_cache.h"
+#include "trait_table.h"
+#include "trait_writer.h"
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
+#include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <memory>
 
 using namespace std;
 using namespace cv;
 using namespace traiter;
+using namespace utility;
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeProfiles()
+//
+// Writes the profiles of the results to the specified JSON file. Returns false
+// if the file could not be written.
+//////////////////////////////////////////////////////////////////////////////////
+static bool writeProfiles(const string& profilePath, const vector<TraitResult>& results)
+{
+	ofstream output(profilePath.c_str());
+
+	if (!output)
+	{
+		cerr << "Could not open " << profilePath << " for writing." << endl;
+		return false;
+	}
+
+	TraitWriter::writeProfiles(output, results);
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// printTraits()
+//
+// Prints the specified traits of the root system with their units, and with
+// their estimated errors if error bounds are given.
+//////////////////////////////////////////////////////////////////////////////////
+static void printTraits(RootSystem& rootSystem, const vector<TraitDescriptor>& traits, const vector<double>& errorBounds = vector<double>())
+{
+	for (size_t trait = 0; trait < traits.size(); ++trait)
+	{
+		cout << traits[trait].displayName << ": " << rootSystem.computeTrait(traits[trait]);
+
+		if (trait < errorBounds.size())
+			cout << " +/- " << errorBounds[trait];
+
+		if (!traits[trait].units.empty())
+			cout << " " << traits[trait].units << ".";
+
+		cout << endl;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// runQuickLook()
+//
+// Prints the approximate traits of the image with their estimated errors, and
+// then its exact traits if a refinement was asked for. No windows are opened.
+//////////////////////////////////////////////////////////////////////////////////
+static int runQuickLook(const CommandLineOptions& options)
+{
+	TraitResult result;
+	result.imagePath = options.imagePath;
+
+	if (!GeneralUtilities::fileExists(options.imagePath))
+	{
+		cerr << options.imagePath << ": file does not exist" << endl;
+		return EXIT_FAILURE;
+	}
+
+	MappedImage mapping;
+	string error;
+	const Mat image = MappedImage::load(options.imagePath, mapping, error);
+
+	if (image.empty())
+	{
+		cerr << options.imagePath << ": " << error << endl;
+		return EXIT_FAILURE;
+	}
+
+	{
+		ProfileScope profileScope(options.profilePath.empty() ? nullptr : &result.profile);
+
+		const QuickLook quickLook = QuickLook(image, options.analysis, options.quickLookLevel);
+		printTraits(*quickLook.getRootSystem(), options.analysis.traits, quickLook.getErrorBounds());
+
+		if (options.refine)
+		{
+			cout << endl << "Refined:" << endl;
+			printTraits(*quickLook.refine(), options.analysis.traits);
+		}
+	}
+
+	if (!options.profilePath.empty() && !writeProfiles(options.profilePath, vector<TraitResult>(1, result)))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// writeThresholdSweep()
+//
+// Writes the number of pixels brighter than each threshold value in the
+// specified format.
+//////////////////////////////////////////////////////////////////////////////////
+static void writeThresholdSweep(ostream& stream, const vector<long long>& maskAreas, const OutputFormat format)
+{
+	if (format == JSON_OUTPUT)
+	{
+		stream << "{\"mask_areas\": [";
+
+		for (size_t thresholdValue = 0; thresholdValue < maskAreas.size(); ++thresholdValue)
+			stream << (thresholdValue == 0 ? "" : ", ") << maskAreas[thresholdValue];
+
+		stream << "]}" << endl;
+	}
+	else
+	{
+		stream << "threshold_value,mask_area" << endl;
+
+		for (size_t thresholdValue = 0; thresholdValue < maskAreas.size(); ++thresholdValue)
+			stream << thresholdValue << "," << maskAreas[thresholdValue] << endl;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// runThresholdSweep()
+//
+// Builds one histogram over the image, or every image in the batch, and writes
+// how many pixels each threshold value would keep to the output file, or to
+// standard output if no file was given. The values chosen by each automatic
+// selection are printed to standard error. No traits are computed.
+//////////////////////////////////////////////////////////////////////////////////
+static int runThresholdSweep(const CommandLineOptions& options)
+{
+	const vector<string> imagePaths = options.batchInput.empty() ? vector<string>(1, options.imagePath) : BatchProcessor::collectImagePaths(options.batchInput);
+
+	if (imagePaths.empty())
+	{
+		cerr << "No images found in " << options.batchInput << endl;
+		return EXIT_FAILURE;
+	}
+
+	vector<long long> histogram;
+
+	for (size_t image = 0; image < imagePaths.size(); ++image)
+	{
+		MappedImage mapping;
+		string error;
+		const Mat originalImage = MappedImage::load(imagePaths[image], mapping, error);
+
+		if (originalImage.empty())
+		{
+			cerr << imagePaths[image] << ": " << error << endl;
+			return EXIT_FAILURE;
+		}
+
+		const vector<long long> imageHistogram = segment::Thresholder::computeHistogram(originalImage);
+
+		if (histogram.empty())
+			histogram = imageHistogram;
+		else
+			transform(histogram.begin(), histogram.end(), imageHistogram.begin(), histogram.begin(), plus<long long>());
+	}
+
+	cerr << "Otsu threshold value: " << segment::Thresholder::computeOtsuThreshold(histogram) << endl
+		<< "Triangle threshold value: " << segment::Thresholder::computeTriangleThreshold(histogram) << endl;
+
+	const vector<long long> maskAreas = segment::Thresholder::computeMaskAreas(histogram);
+
+	if (options.outputPath.empty())
+	{
+		writeThresholdSweep(cout, maskAreas, options.outputFormat);
+	}
+	else
+	{
+		ofstream output(options.outputPath.c_str());
+
+		if (!output)
+		{
+			cerr << "Could not open " << options.outputPath << " for writing." << endl;
+			return EXIT_FAILURE;
+		}
+
+		writeThresholdSweep(output, maskAreas, options.outputFormat);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// runBatch()
+//
+// Computes the traits of every image in the batch and writes them to the output
+// file, or to standard output if no file was given. No windows are opened. A
+// series is processed in order on one thread, since each frame is computed from
+// the one before it.
+//////////////////////////////////////////////////////////////////////////////////
+static int runBatch(const CommandLineOptions& options)
+{
+	vector<string> imagePaths = BatchProcessor::collectImagePaths(options.batchInput);
+
+	if (imagePaths.empty())
+	{
+		cerr << "No images found in " << options.batchInput << endl;
+		return EXIT_FAILURE;
+	}
+
+	vector<TraitResult> results;
+
+	if (options.series)
+	{
+		TimeSeriesAnalyzer timeSeriesAnalyzer = TimeSeriesAnalyzer(options.analysis);
+		results = timeSeriesAnalyzer.process(imagePaths, !options.profilePath.empty());
+	}
+	else
+	{
+		string error;
+
+		if (!options.cachePath.empty() && !TraitCache::prepareDirectory(options.cachePath, error))
+		{
+			cerr << error << endl;
+			return EXIT_FAILURE;
+		}
+
+		BatchProcessor batchProcessor = BatchProcessor(options.analysis, options.threadCount, !options.profilePath.empty(), options.cachePath);
+		results = batchProcessor.process(imagePaths);
+	}
+
+	if (options.outputPath.empty())
+	{
+		TraitWriter::write(cout, results, options.analysis.traits, options.outputFormat);
+	}
+	else
+	{
+		ofstream output(options.outputPath.c_str());
+
+		if (!output)
+		{
+			cerr << "Could not open " << options.outputPath << " for writing." << endl;
+			return EXIT_FAILURE;
+		}
+
+		TraitWriter::write(output, results, options.analysis.traits, options.outputFormat);
+	}
+
+	if (!options.profilePath.empty() && !writeProfiles(options.profilePath, results))
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// runServer()
+//
+// Answers requests for traits on standard input and output, or on the socket
+// that was given, until the input ends or the socket fails.
+//////////////////////////////////////////////////////////////////////////////////
+static int runServer(const CommandLineOptions& options)
+{
+	AnalysisServer server(options.threadCount);
+
+	if (options.socketPath.empty())
+	{
+		server.serve(cin, cout);
+		return EXIT_SUCCESS;
+	}
+
+	string error;
+
+	if (!server.serve(options.socketPath, error))
+	{
+		cerr << error << endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
 
 int main(int argc, char** argv)
 {
-	if (argc < 2 || !utility::GeneralUtilities::fileExists(argv[1]))
-		return EXIT_FAILURE;
-
-	Mat originalImage = imread(argv[1], CV_LOAD_IMAGE_GRAYSCALE);
-
-	RootSystem rootSystem = RootSystem(originalImage);
-
-	cout << "Network area: " << rootSystem.networkArea() << " pixels.\n";
-	cout << "Perimeter: " << rootSystem.perimeter() << " pixels.\n";
-	cout << "Convex Area: " << rootSystem.convexArea() << " pixels.\n";
-	cout << "Network Depth: " << rootSystem.networkDepth() << " pixels.\n";
-	cout << "Netowrk Width: " << rootSystem.networkWidth() << " pixels.\n";
-	cout << "Major Axis: " << rootSystem.majorAxis() << " pixels.\n";
-	cout << "Minor Axis: " << rootSystem.minorAxis() << " pixels.\n";
-	cout << "Aspect ratio: " <<  rootSystem.aspectRatio() << endl;
-	cout << "Network solidity: " << rootSystem.networkSolidity() << endl;
-	cout << "Network width to depth ratio: " << rootSystem.networkWidthToDepthRatio() << endl;
-	cout << "Median number of roots: " << rootSystem.medianNumberOfRoots() << endl;
-	cout << "Maximum number of roots: " << rootSystem.maximumNumberOfRoots() << endl;
-	cout << "Bushiness: " << rootSystem.bushiness() << endl;
-	cout << "Network length distribution: " << rootSystem.networkLengthDistribution() << endl;
-
-	//TODO: Not done with these:
-	cout << "Network length " << rootSystem.networkLength() << " pixels.\n";
-	cout << "Average root width: " << rootSystem.averageRootWidth() << " pixels.\n";
-	cout << "Network surface area: " << rootSystem.networkSurfaceArea() << " pixels.\n";
-	cout << "Network volume: " << rootSystem.networkVolume() << " pixels.\n";
-	cout << "Specific root length: " << rootSystem.specificRootLength() << " pixels.\n";
-
-	imwrite("tmp.jpg", rootSystem.getImage());
-	imshow("Root System Image", rootSystem.getImage());
+	CommandLineOptions options;
+	string error;
+
+	if (!CommandLine::parse(argc, argv, options, error))
+	{
+		cerr << error << endl;
+		CommandLine::printUsage(cerr);
+		return EXIT_FAILURE;
+	}
+
+	ParallelScope parallelScope(options.threadCount);	// A single image, or a series, is spread over the threads row band by row band.
+
+	if (options.serve)
+		return runServer(options);
+
+	if (options.thresholdSweep)
+		return runThresholdSweep(options);
+
+	if (!options.batchInput.empty())
+		return runBatch(options);
+
+	if (options.quickLookLevel >= 0)
+		return runQuickLook(options);
+
+	TraitResult result;
+	result.imagePath = options.imagePath;
+	unique_ptr<RootSystem> rootSystem;
+
+	{
+		ProfileScope profileScope(options.profilePath.empty() ? nullptr : &result.profile);
+
+		rootSystem = ImageAnalyzer::analyze(options.imagePath, options.analysis, result.error);
+
+		if (!rootSystem)
+		{
+			cerr << options.imagePath << ": " << result.error << endl;
+			return EXIT_FAILURE;
+		}
+
+		printTraits(*rootSystem, options.analysis.traits);
+	}
+
+	if (!options.profilePath.empty() && !writeProfiles(options.profilePath, vector<TraitResult>(1, result)))
+		return EXIT_FAILURE;
+
+	if (options.analysis.stripRows > 0)
+		return EXIT_SUCCESS;	// Streamed images are too large to show, and only their statistics were kept.
+
+	const Mat image = rootSystem->getImage();
+	const Mat skeleton = rootSystem->getSkeleton();
+
+	imwrite("tmp.jpg", image);
+	imwrite("skeleton.png", skeleton);
+	imshow("Root System Image", image);
+	imshow("Skeleton", skeleton);
 
 	waitKey();
 	
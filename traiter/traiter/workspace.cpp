@@ -0,0 +1,67 @@
+#include "workspace.h"
+
+using namespace cv;
+using namespace std;
+using namespace utility;
+
+TRAITER_THREAD_LOCAL Workspace* Workspace::_current = nullptr;
+
+//////////////////////////////////////////////////////////////////////////////////
+// borrow()
+//
+// Returns the named buffer of the current workspace, with the specified size and
+// type. The buffer is only reallocated if the last image needed a different size
+// or type. Its contents are whatever the last borrower left in it. Without a
+// workspace installed, a new buffer is allocated every time.
+//////////////////////////////////////////////////////////////////////////////////
+Mat Workspace::borrow(const char* name, const Size size, const int type)
+{
+	Mat buffer;
+
+	if (_current)
+		buffer = _current->_buffers[name];
+
+	if (buffer.size() != size || buffer.type() != type)
+	{
+		buffer.create(size, type);
+		TRAITER_PROFILE_COUNT("bytes_allocated", buffer.total() * buffer.elemSize());
+
+		if (_current)
+			_current->_buffers[name] = buffer;
+	}
+
+	return buffer;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// current()
+//
+// Returns the workspace installed on the current thread, or null if there is
+// none.
+//////////////////////////////////////////////////////////////////////////////////
+Workspace* Workspace::current()
+{
+	return _current;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// WorkspaceScope::WorkspaceScope()
+//
+// Constructor to specify the workspace to install on the current thread. A null
+// workspace makes every borrow allocate for the scope.
+//////////////////////////////////////////////////////////////////////////////////
+WorkspaceScope::WorkspaceScope(Workspace* workspace)
+	: _previous(Workspace::_current)
+{
+	Workspace::_current = workspace;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// WorkspaceScope::~WorkspaceScope()
+//
+// Restores the workspace that was installed before this scope.
+//////////////////////////////////////////////////////////////////////////////////
+WorkspaceScope::~WorkspaceScope()
+{
+	Workspace::_current = _previous;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "profiler.h"
+#include <opencv2/core/core.hpp>
+#include <map>
+#include <string>
+
+namespace utility
+{
+	//////////////////////////////////////////////////////////////////////////////////
+	// Workspace
+	//
+	// Scratch buffers that are kept from one image to the next, so that a thread
+	// processing many images of the same size only allocates them once. A
+	// workspace is used by every stage that runs on the thread it is installed on
+	// with a WorkspaceScope.
+	//
+	// A borrowed buffer is only valid until the next time the same name is
+	// borrowed, so it must never be returned from the function that borrowed it.
+	//////////////////////////////////////////////////////////////////////////////////
+	class Workspace final
+	{
+	public:
+		static cv::Mat borrow(const char* name, const cv::Size size, const int type);
+
+		static Workspace* current();
+	private:
+		friend class WorkspaceScope;
+
+		std::map<std::string, cv::Mat> _buffers;
+
+		static TRAITER_THREAD_LOCAL Workspace* _current;
+	};
+
+	//////////////////////////////////////////////////////////////////////////////////
+	// WorkspaceScope
+	//
+	// Installs a workspace on the current thread for the lifetime of the scope, and
+	// restores the previous one afterward.
+	//////////////////////////////////////////////////////////////////////////////////
+	class WorkspaceScope final
+	{
+	public:
+		explicit WorkspaceScope(Workspace* workspace);
+		~WorkspaceScope();
+	private:
+		WorkspaceScope();
+		WorkspaceScope(const WorkspaceScope&);
+		WorkspaceScope& operator=(const WorkspaceScope&);
+
+		Workspace* _previous;
+	};
+}